@@ -0,0 +1,955 @@
+
+// tsearch(), tdestroy() and syscall()
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <search.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "ull.h"
+#include "ullshard.h"
+
+// same key type, once searched by the generated binary search, once by the SIMD kernels
+ULL_DEFINE( ulli64scalar, int64_t, ( a < b ? -1 : ( a > b ? 1 : 0 ) ) )
+ULL_DEFINE_I64( ulli64simd )
+
+static double now( void )
+{
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static uint64_t rnd_state = 88172645463325252ULL;
+
+static int64_t rnd( void )
+{
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 7;
+  rnd_state ^= rnd_state << 17;
+  return (int64_t)( rnd_state >> 1 );
+}
+
+// ns per search of one node's keys
+static void bench_kernel( size_t lines )
+{
+  size_t n = lines * ULL_CACHE_LINE / sizeof(int64_t), i = 0, reps = 2000000;
+  int64_t * keys = malloc( n * sizeof(int64_t) );
+  int64_t * queries = malloc( 1024 * sizeof(int64_t) );
+  size_t sum = 0;
+  double t0 = 0.0, scalar = 0.0, simd = 0.0;
+  // both searches are called through their key operations, like the list does
+  const ullkeyops * sops = ulli64scalar_keyops();
+  const ullkeyops * ops = ull_keyops_i64();
+  for( i = 0; i < n; i++ ) {
+    keys[ i ] = (int64_t)( i * 10 );
+  }
+  for( i = 0; i < 1024; i++ ) {
+    queries[ i ] = rnd() % (int64_t)( n * 10 );
+  }
+  t0 = now();
+  for( i = 0; i < reps; i++ ) {
+    sum += (sops->search)( 0, keys, n, &(queries[ i & 1023 ]), (int)( i & 1 ) );
+  }
+  scalar = ( now() - t0 ) / (double)reps;
+  t0 = now();
+  for( i = 0; i < reps; i++ ) {
+    sum += (ops->search)( 0, keys, n, &(queries[ i & 1023 ]), (int)( i & 1 ) );
+  }
+  simd = ( now() - t0 ) / (double)reps;
+  printf("node search  %2ld lines %4ld keys  scalar %7.2f ns  %-6s %7.2f ns  speedup %.2fx  (%ld)\n",
+    lines, n, scalar, ull_keyops_kernel(), simd, scalar / simd, sum % 2 );
+  free( keys );
+  free( queries );
+}
+
+// ns per insert and per lookup of a whole list
+static void bench_list( size_t num, size_t lines )
+{
+  ulli64scalar ls;
+  ulli64simd lv;
+  dynmem ds, dv;
+  size_t cap = lines * ULL_CACHE_LINE / sizeof(int64_t), i = 0;
+  int64_t * keys = malloc( num * sizeof(int64_t) );
+  int64_t k = 0, sum = 0;
+  double t0 = 0.0, ins_s = 0.0, ins_v = 0.0, get_s = 0.0, get_v = 0.0;
+  for( i = 0; i < num; i++ ) {
+    keys[ i ] = rnd();
+  }
+  dynmem_init( &ds, sizeof(void*) );
+  ulli64scalar_init( &ls, &ds );
+  dynmem_init( &dv, sizeof(void*) );
+  ulli64simd_init( &lv, &dv );
+  ull_set_node_capacity( &(ls.u), cap );
+  ull_set_node_capacity( &(lv.u), cap );
+
+  t0 = now();
+  for( i = 0; i < num; i++ ) {
+    ulli64scalar_insert( &ls, keys[ i ] );
+  }
+  ins_s = ( now() - t0 ) / (double)num;
+  t0 = now();
+  for( i = 0; i < num; i++ ) {
+    ulli64simd_insert( &lv, keys[ i ] );
+  }
+  ins_v = ( now() - t0 ) / (double)num;
+
+  t0 = now();
+  for( i = 0; i < num; i++ ) {
+    ulli64scalar_get_nearest( &ls, keys[ ( i * 7919 ) % num ], 0, &k );
+    sum += k;
+  }
+  get_s = ( now() - t0 ) / (double)num;
+  t0 = now();
+  for( i = 0; i < num; i++ ) {
+    ulli64simd_get_nearest( &lv, keys[ ( i * 7919 ) % num ], 0, &k );
+    sum += k;
+  }
+  get_v = ( now() - t0 ) / (double)num;
+
+  printf("list %9ld  %2ld lines  insert scalar %7.1f ns  simd %7.1f ns  lookup scalar %7.1f ns  simd %7.1f ns  (%ld)\n",
+    num, lines, ins_s, ins_v, get_s, get_v, (long)( sum & 1 ) );
+  ulli64scalar_remove_all( &ls );
+  ulli64simd_remove_all( &lv );
+  free( keys );
+}
+
+// ms per million elements of a bulk load from sorted keys
+static void bench_build( size_t num )
+{
+  ulli64simd l;
+  dynmem d;
+  size_t i = 0;
+  int64_t * keys = malloc( num * sizeof(int64_t) );
+  double t0 = 0.0;
+  for( i = 0; i < num; i++ ) {
+    keys[ i ] = (int64_t)i * 3;
+  }
+  dynmem_init( &d, sizeof(void*) );
+  ulli64simd_init( &l, &d );
+  t0 = now();
+  ulli64simd_build_from_sorted( &l, keys, num, 0.9 );
+  printf("build %9ld  %.2f ms per million elements\n", num, ( now() - t0 ) / 1e6 / ( (double)num / 1e6 ) );
+  ulli64simd_remove_all( &l );
+  free( keys );
+}
+
+// ns per element of inserting bursts of keys one by one vs. as batches
+// (clustered: the keys of a burst come from a narrow, moving key range)
+static void bench_batch( size_t num, size_t burst, int clustered )
+{
+  ulli64simd l1, l2;
+  dynmem d1, d2;
+  size_t i = 0;
+  int64_t * keys = malloc( num * sizeof(int64_t) );
+  double t0 = 0.0, single = 0.0, batch = 0.0;
+  for( i = 0; i < num; i++ ) {
+    keys[ i ] = ( clustered ? (int64_t)( i - i % burst ) * 2 + rnd() % (int64_t)( burst * 4 ) : rnd() );
+  }
+  dynmem_init( &d1, sizeof(void*) );
+  ulli64simd_init( &l1, &d1 );
+  dynmem_init( &d2, sizeof(void*) );
+  ulli64simd_init( &l2, &d2 );
+  t0 = now();
+  for( i = 0; i < num; i++ ) {
+    ulli64simd_insert( &l1, keys[ i ] );
+  }
+  single = ( now() - t0 ) / (double)num;
+  t0 = now();
+  for( i = 0; i < num; i += burst ) {
+    ulli64simd_insert_batch( &l2, keys + i, ( i + burst > num ? num - i : burst ) );
+  }
+  batch = ( now() - t0 ) / (double)num;
+  printf("burst %9ld  %6ld keys  %-9s  single %7.1f ns  batch %7.1f ns\n",
+    num, burst, ( clustered ? "clustered" : "random" ), single, batch );
+  ulli64simd_remove_all( &l1 );
+  ulli64simd_remove_all( &l2 );
+  free( keys );
+}
+
+typedef struct {
+  ulli64simd * l;
+  int64_t max;
+  int stop;
+  size_t lookups;
+  unsigned char pad[ ULL_CACHE_LINE ];
+}
+bench_reader_arg;
+
+static void * bench_reader( void * arg )
+{
+  bench_reader_arg * a = (bench_reader_arg*)arg;
+  ullreader r;
+  uint64_t x = 88172645463325252ULL + (uint64_t)(uintptr_t)arg;
+  int64_t k = 0;
+  size_t n = 0;
+  ull_reader_init( &r, &(a->l->u) );
+  while( ! __atomic_load_n( &(a->stop), __ATOMIC_ACQUIRE ) ) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    ulli64simd_read_nearest( &r, (int64_t)( x % (uint64_t)(a->max) ), 0, &k );
+    n ++;
+  }
+  ull_reader_release( &r );
+  a->lookups = n;
+  return 0;
+}
+
+// lookups per second of reader threads while one writer inserts and removes keys
+static void bench_concurrent( size_t num, size_t readers )
+{
+  ulli64simd l;
+  dynmem d;
+  size_t i = 0, writes = 0;
+  bench_reader_arg * args = calloc( readers, sizeof(bench_reader_arg) );
+  pthread_t * threads = malloc( readers * sizeof(pthread_t) );
+  size_t lookups = 0;
+  double t0 = 0.0, t = 0.0;
+  dynmem_init( &d, sizeof(void*) );
+  ulli64simd_init( &l, &d );
+  ull_set_concurrent( &(l.u), 1 );
+  for( i = 0; i < num; i++ ) {
+    ulli64simd_insert( &l, (int64_t)i * 4 );
+  }
+  t0 = now();
+  for( i = 0; i < readers; i++ ) {
+    args[ i ].l = &l;
+    args[ i ].max = (int64_t)num * 4;
+    pthread_create( &(threads[ i ]), 0, bench_reader, &(args[ i ]) );
+  }
+  while( now() - t0 < 5e8 ) {
+    int64_t k = ( rnd() % (int64_t)num ) * 4 + 1;
+    ulli64simd_insert( &l, k );
+    ulli64simd_remove( &l, k );
+    writes += 2;
+  }
+  for( i = 0; i < readers; i++ ) {
+    __atomic_store_n( &(args[ i ].stop), 1, __ATOMIC_RELEASE );
+  }
+  for( i = 0; i < readers; i++ ) {
+    pthread_join( threads[ i ], 0 );
+    lookups += args[ i ].lookups;
+  }
+  t = ( now() - t0 ) / 1e9;
+  printf("concurrent %9ld  %2ld readers  %8.2f M lookups/s  (%.2f M per reader)  writer %6.2f M ops/s\n",
+    num, readers, (double)lookups / t / 1e6, (double)lookups / t / 1e6 / (double)readers, (double)writes / t / 1e6 );
+  ull_set_concurrent( &(l.u), 0 );
+  ulli64simd_remove_all( &l );
+  free( args );
+  free( threads );
+}
+
+typedef struct {
+  ullshards * s;
+  int64_t * keys;
+  size_t num;
+  unsigned char pad[ ULL_CACHE_LINE ];
+}
+bench_shards_arg;
+
+static void * bench_shards_writer( void * arg )
+{
+  bench_shards_arg * a = (bench_shards_arg*)arg;
+  size_t i = 0;
+  for( i = 0; i < a->num; i++ ) {
+    ull_shards_insert( a->s, &(a->keys[ i ]) );
+  }
+  return 0;
+}
+
+// inserts per second of writer threads into a container of 64 shards
+static void bench_shards( size_t num, size_t writers )
+{
+  ullshards s;
+  int64_t splitters[ ULL_SHARDS_MAX - 1 ];
+  int64_t * keys = malloc( num * sizeof(int64_t) );
+  bench_shards_arg * args = calloc( writers, sizeof(bench_shards_arg) );
+  pthread_t * threads = malloc( writers * sizeof(pthread_t) );
+  size_t i = 0;
+  double t0 = 0.0, t = 0.0;
+  for( i = 0; i < ULL_SHARDS_MAX - 1; i++ ) {
+    splitters[ i ] = INT64_MAX / ULL_SHARDS_MAX * (int64_t)( i + 1 );
+  }
+  for( i = 0; i < num; i++ ) {
+    keys[ i ] = rnd();
+  }
+  ull_shards_init_keys( &s, ull_keyops_i64(), ULL_SHARDS_MAX, splitters );
+  t0 = now();
+  for( i = 0; i < writers; i++ ) {
+    args[ i ].s = &s;
+    args[ i ].keys = keys + i * ( num / writers );
+    args[ i ].num = num / writers;
+    pthread_create( &(threads[ i ]), 0, bench_shards_writer, &(args[ i ]) );
+  }
+  for( i = 0; i < writers; i++ ) {
+    pthread_join( threads[ i ], 0 );
+  }
+  t = ( now() - t0 ) / 1e9;
+  printf("shards %9ld  %2ld writers  %8.2f M inserts/s\n",
+    num, writers, (double)ull_shards_size( &s ) / t / 1e6 );
+  ull_shards_free( &s );
+  free( keys );
+  free( args );
+  free( threads );
+}
+
+// ascending lookups (a sorted join) with and without a finger
+static void bench_finger( size_t num )
+{
+  ulli64simd l;
+  dynmem d;
+  ullfinger f;
+  size_t i = 0;
+  int64_t k = 0, sum = 0;
+  double t0 = 0.0, plain = 0.0, hint = 0.0;
+  dynmem_init( &d, sizeof(void*) );
+  ulli64simd_init( &l, &d );
+  ull_finger_init( &f );
+  for( i = 0; i < num; i++ ) {
+    ulli64simd_insert_hint( &l, (int64_t)i * 4, &f );
+  }
+  t0 = now();
+  for( i = 0; i < num; i++ ) {
+    ulli64simd_get_nearest( &l, (int64_t)i * 4 + 1, 0, &k );
+    sum += k;
+  }
+  plain = ( now() - t0 ) / (double)num;
+  t0 = now();
+  for( i = 0; i < num; i++ ) {
+    ulli64simd_get_nearest_hint( &l, (int64_t)i * 4 + 1, 0, &k, &f );
+    sum += k;
+  }
+  hint = ( now() - t0 ) / (double)num;
+  printf("finger %9ld  ascending lookups  plain %7.1f ns  hint %7.1f ns  (%ld)\n",
+    num, plain, hint, (long)( sum % 2 ) );
+  ulli64simd_remove_all( &l );
+}
+
+// monotonic inserts (timestamps) with and without the append split
+static void bench_append( size_t num, int append )
+{
+  ulli64simd l;
+  dynmem d;
+  size_t i = 0;
+  double t0 = 0.0, t = 0.0;
+  dynmem_init( &d, sizeof(void*) );
+  ulli64simd_init( &l, &d );
+  ull_set_split_policy( &(l.u), ULL_SPLIT_FILL, ULL_SPLIT_RATIO, append );
+  t0 = now();
+  for( i = 0; i < num; i++ ) {
+    ulli64simd_insert( &l, (int64_t)i );
+  }
+  t = ( now() - t0 ) / (double)num;
+  printf("append %9ld  append split %d  insert %7.1f ns  node occupancy %5.1f%%\n",
+    num, append, t, 100.0 * (double)num / (double)( l.u.num_nodes * l.u.capacity ) );
+  ulli64simd_remove_all( &l );
+}
+
+// warm start: opening a saved list vs building it again
+static void bench_save( size_t num )
+{
+  ulli64simd l, m;
+  dynmem d, dm;
+  size_t i = 0;
+  int64_t * keys = malloc( num * sizeof(int64_t) );
+  int64_t k = 0, sum = 0;
+  double t0 = 0.0, save = 0.0, open = 0.0, build = 0.0, first = 0.0;
+  const char * path = "bench_save.ull";
+  for( i = 0; i < num; i++ ) {
+    keys[ i ] = rnd();
+  }
+  dynmem_init( &d, sizeof(void*) );
+  ulli64simd_init( &l, &d );
+  t0 = now();
+  ulli64simd_insert_batch( &l, keys, num );
+  build = ( now() - t0 ) / 1e6;
+  t0 = now();
+  ull_save( &(l.u), path );
+  save = ( now() - t0 ) / 1e6;
+  t0 = now();
+  dynmem_init( &dm, sizeof(void*) );
+  ull_open_mmap( &(m.u), &dm, path, ull_keyops_i64(), 0 );
+  open = ( now() - t0 ) / 1e6;
+  t0 = now();
+  for( i = 0; i < 1000; i++ ) {
+    ulli64simd_get_nearest( &m, keys[ i ], 1, &k );
+    sum += k;
+  }
+  first = ( now() - t0 ) / 1000.0;
+  printf("mmap   %9ld  build %8.2f ms  save %8.2f ms  open %6.3f ms  first lookups %7.1f ns  (%ld)\n",
+    num, build, save, open, first, (long)( sum % 2 ) );
+  ulli64simd_remove_all( &m );
+  ulli64simd_remove_all( &l );
+  remove( path );
+  free( keys );
+}
+
+// packed nodes vs plain nodes of the same capacity: memory per key and ns per lookup
+// (timestamps with small gaps, so most nodes pack to a few bits per key)
+static void bench_packed( size_t num )
+{
+  ulli64simd l, pl;
+  dynmem d, dp;
+  size_t i = 0, lookups = 1000000;
+  int64_t * keys = malloc( num * sizeof(int64_t) );
+  int64_t k = 0, sum = 0;
+  double t0 = 0.0, tl = 0.0, tp = 0.0;
+  ullstats st, stp;
+  keys[ 0 ] = 1500000000000LL;
+  for( i = 1; i < num; i++ ) {
+    keys[ i ] = keys[ i - 1 ] + 1 + rnd() % 100;
+  }
+  dynmem_init( &d, sizeof(void*) );
+  ulli64simd_init( &l, &d );
+  dynmem_init( &dp, sizeof(void*) );
+  ulli64simd_init( &pl, &dp );
+  ull_set_node_capacity( &(l.u), 256 );
+  ull_set_node_capacity( &(pl.u), 256 );
+  ull_set_packed( &(pl.u), 1 );
+  ulli64simd_build_from_sorted( &l, keys, num, 0.8 );
+  ulli64simd_build_from_sorted( &pl, keys, num, 0.8 );
+  ull_stats_get( &(l.u), &st );
+  ull_stats_get( &(pl.u), &stp );
+  t0 = now();
+  for( i = 0; i < lookups; i++ ) {
+    ulli64simd_get_nearest( &l, keys[ rnd() % num ], 0, &k );
+    sum += k;
+  }
+  tl = ( now() - t0 ) / (double)lookups;
+  t0 = now();
+  for( i = 0; i < lookups; i++ ) {
+    ulli64simd_get_nearest( &pl, keys[ rnd() % num ], 0, &k );
+    sum += k;
+  }
+  tp = ( now() - t0 ) / (double)lookups;
+  printf("packed %9ld  list %6.2f B/key %7.1f ns  packed list %6.2f B/key %7.1f ns  (%ld)\n",
+    num, (double)st.memory / (double)num, tl, (double)stp.memory / (double)num, tp, (long)( sum % 2 ) );
+  ulli64simd_remove_all( &l );
+  ulli64simd_remove_all( &pl );
+  free( keys );
+}
+
+// checkpoint size and time for a number of random inserts into a big list
+static void bench_checkpoint( size_t num, size_t writes )
+{
+  ulli64simd l;
+  dynmem d;
+  size_t i = 0;
+  int64_t * keys = malloc( num * sizeof(int64_t) );
+  const char * log = "bench_checkpoint.log";
+  int fd = open( log, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644 );
+  double t0 = 0.0, t = 0.0;
+  off_t size = 0;
+  for( i = 0; i < num; i++ ) {
+    keys[ i ] = rnd();
+  }
+  dynmem_init( &d, sizeof(void*) );
+  ulli64simd_init( &l, &d );
+  ulli64simd_insert_batch( &l, keys, num );
+  ull_set_checkpointing( &(l.u), 1 );
+  ull_checkpoint( &(l.u), fd );
+  size = lseek( fd, 0, SEEK_END );
+  for( i = 0; i < writes; i++ ) {
+    ulli64simd_insert( &l, rnd() );
+  }
+  t0 = now();
+  ull_checkpoint( &(l.u), fd );
+  t = ( now() - t0 ) / 1e6;
+  printf("ckpt   %9ld  %7ld inserts  checkpoint %9.1f KB  %7.2f ms  (full %9.1f KB)\n",
+    num, writes, (double)( lseek( fd, 0, SEEK_END ) - size ) / 1024.0, t, (double)size / 1024.0 );
+  close( fd );
+  remove( log );
+  ull_set_checkpointing( &(l.u), 0 );
+  ulli64simd_remove_all( &l );
+  free( keys );
+}
+
+// --- workload suite (./bench suite [max size] [csv file]) ---
+// runs every workload against ull and the baselines (a sorted array searched by binary
+// search and the tsearch() tree of <search.h>) for sizes from 10^3 up to max size and
+// writes one CSV row per structure, workload, size and phase
+
+// hardware counters of the calling thread (-1 where perf_event_open() is not available)
+typedef struct {
+  int fd[ 2 ];
+}
+suite_counters;
+
+// opens counter i (0: cache misses, 1: branch misses)
+static int suite_counter_open( int i )
+{
+#ifdef __linux__
+  struct perf_event_attr a;
+  memset( &a, 0, sizeof(a) );
+  a.type = PERF_TYPE_HARDWARE;
+  a.size = sizeof(a);
+  a.config = ( i ? PERF_COUNT_HW_BRANCH_MISSES : PERF_COUNT_HW_CACHE_MISSES );
+  a.disabled = 1;
+  a.exclude_kernel = 1;
+  a.exclude_hv = 1;
+  return (int)syscall( __NR_perf_event_open, &a, 0, -1, -1, 0 );
+#else
+  return -1;
+#endif
+}
+
+static void suite_counters_start( suite_counters * c )
+{
+  int i = 0;
+  for( i = 0; i < 2; i++ ) {
+#ifdef __linux__
+    if( c->fd[ i ] >= 0 ) {
+      ioctl( c->fd[ i ], PERF_EVENT_IOC_RESET, 0 );
+      ioctl( c->fd[ i ], PERF_EVENT_IOC_ENABLE, 0 );
+    }
+#endif
+  }
+}
+
+// cache misses and branch misses since suite_counters_start()
+static void suite_counters_stop( suite_counters * c, double * values )
+{
+  int i = 0;
+  for( i = 0; i < 2; i++ ) {
+    uint64_t v = 0;
+    values[ i ] = -1.0;
+#ifdef __linux__
+    if( c->fd[ i ] >= 0 ) {
+      ioctl( c->fd[ i ], PERF_EVENT_IOC_DISABLE, 0 );
+      if( read( c->fd[ i ], &v, sizeof(v) ) == (ssize_t)sizeof(v) ) {
+        values[ i ] = (double)v;
+      }
+    }
+#endif
+  }
+}
+
+// Zipfian ranks 0..n-1 (theta 0.99, the generator of YCSB)
+typedef struct {
+  double n, theta, alpha, zetan, eta;
+}
+suite_zipf;
+
+static void suite_zipf_init( suite_zipf * z, size_t n )
+{
+  size_t i = 0;
+  z->n = (double)n;
+  z->theta = 0.99;
+  z->zetan = 0.0;
+  for( i = 1; i <= n; i++ ) {
+    z->zetan += 1.0 / pow( (double)i, z->theta );
+  }
+  z->alpha = 1.0 / ( 1.0 - z->theta );
+  z->eta = ( 1.0 - pow( 2.0 / z->n, 1.0 - z->theta ) ) / ( 1.0 - ( 1.0 + pow( 0.5, z->theta ) ) / z->zetan );
+}
+
+static size_t suite_zipf_next( suite_zipf * z )
+{
+  double u = (double)( rnd() % 1000000007 ) / 1000000007.0;
+  double uz = u * z->zetan;
+  size_t r = 0;
+  if( uz < 1.0 ) {
+    return 0;
+  }
+  if( uz < 1.0 + pow( 0.5, z->theta ) ) {
+    return 1;
+  }
+  r = (size_t)( z->n * pow( z->eta * u - z->eta + 1.0, z->alpha ) );
+  return ( r >= (size_t)(z->n) ? (size_t)(z->n) - 1 : r );
+}
+
+// a structure under test
+typedef struct {
+  const char * name;
+  void * (*create)( void );
+  // inserts n keys (the sorted array sorts them at once)
+  void (*load)( void * s, const int64_t * keys, size_t n );
+  int (*insert)( void * s, int64_t k );
+  int (*find)( void * s, int64_t k );
+  int (*remove)( void * s, int64_t k );
+  size_t (*memory)( void * s );
+  void (*destroy)( void * s );
+  // largest size for the mixed workload (0: no limit)
+  size_t max_mixed;
+}
+suite_structure;
+
+// ull
+typedef struct {
+  ulli64simd l;
+  dynmem d;
+}
+suite_ull;
+
+static void * suite_ull_create( void )
+{
+  suite_ull * s = malloc( sizeof(suite_ull) );
+  dynmem_init( &(s->d), sizeof(void*) );
+  ulli64simd_init( &(s->l), &(s->d) );
+  return s;
+}
+
+static int suite_ull_insert( void * s, int64_t k )
+{
+  return ulli64simd_insert( &(((suite_ull*)s)->l), k );
+}
+
+static void suite_ull_load( void * s, const int64_t * keys, size_t n )
+{
+  size_t i = 0;
+  for( i = 0; i < n; i++ ) {
+    suite_ull_insert( s, keys[ i ] );
+  }
+}
+
+static int suite_ull_find( void * s, int64_t k )
+{
+  int64_t e = 0;
+  return ulli64simd_get_nearest( &(((suite_ull*)s)->l), k, 1, &e );
+}
+
+static int suite_ull_remove( void * s, int64_t k )
+{
+  return ulli64simd_remove( &(((suite_ull*)s)->l), k );
+}
+
+// the slabs of the node and index node pools and their slab tables
+static size_t suite_ull_memory( void * s )
+{
+  ullstats st;
+  ull_stats_get( &(((suite_ull*)s)->l.u), &st );
+  return (size_t)(st.memory);
+}
+
+static void suite_ull_destroy( void * s )
+{
+  ulli64simd_remove_all( &(((suite_ull*)s)->l) );
+  free( s );
+}
+
+// sorted array
+typedef struct {
+  int64_t * keys;
+  size_t num, max;
+}
+suite_array;
+
+static int suite_cmp_i64( const void * a, const void * b )
+{
+  int64_t x = *((const int64_t*)a), y = *((const int64_t*)b);
+  return ( x < y ? -1 : ( x > y ? 1 : 0 ) );
+}
+
+static void * suite_array_create( void )
+{
+  return calloc( 1, sizeof(suite_array) );
+}
+
+static size_t suite_array_lower( suite_array * a, int64_t k )
+{
+  size_t lo = 0, hi = a->num;
+  while( lo < hi ) {
+    size_t mid = lo + ( hi - lo ) / 2;
+    if( a->keys[ mid ] < k ) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+static void suite_array_load( void * s, const int64_t * keys, size_t n )
+{
+  suite_array * a = s;
+  a->max = n + n / 8 + 16;
+  a->keys = malloc( a->max * sizeof(int64_t) );
+  memcpy( a->keys, keys, n * sizeof(int64_t) );
+  a->num = n;
+  qsort( a->keys, n, sizeof(int64_t), suite_cmp_i64 );
+}
+
+static int suite_array_insert( void * s, int64_t k )
+{
+  suite_array * a = s;
+  size_t i = suite_array_lower( a, k );
+  if( a->num == a->max ) {
+    a->max = 2 * a->max + 16;
+    a->keys = realloc( a->keys, a->max * sizeof(int64_t) );
+  }
+  memmove( a->keys + i + 1, a->keys + i, ( a->num - i ) * sizeof(int64_t) );
+  a->keys[ i ] = k;
+  a->num ++;
+  return 1;
+}
+
+static int suite_array_find( void * s, int64_t k )
+{
+  suite_array * a = s;
+  size_t i = suite_array_lower( a, k );
+  return ( i < a->num && a->keys[ i ] == k );
+}
+
+static int suite_array_remove( void * s, int64_t k )
+{
+  suite_array * a = s;
+  size_t i = suite_array_lower( a, k );
+  if( i < a->num && a->keys[ i ] == k ) {
+    memmove( a->keys + i, a->keys + i + 1, ( a->num - i - 1 ) * sizeof(int64_t) );
+    a->num --;
+    return 1;
+  }
+  return 0;
+}
+
+static size_t suite_array_memory( void * s )
+{
+  return ((suite_array*)s)->max * sizeof(int64_t);
+}
+
+static void suite_array_destroy( void * s )
+{
+  free( ((suite_array*)s)->keys );
+  free( s );
+}
+
+// tsearch() tree, keys stored in the node's key pointer
+typedef struct {
+  void * root;
+  size_t num;
+}
+suite_tree;
+
+static int suite_tree_cmp( const void * a, const void * b )
+{
+  int64_t x = (int64_t)(intptr_t)a, y = (int64_t)(intptr_t)b;
+  return ( x < y ? -1 : ( x > y ? 1 : 0 ) );
+}
+
+static void * suite_tree_create( void )
+{
+  return calloc( 1, sizeof(suite_tree) );
+}
+
+static int suite_tree_insert( void * s, int64_t k )
+{
+  suite_tree * t = s;
+  t->num ++;
+  return ( tsearch( (void*)(intptr_t)k, &(t->root), suite_tree_cmp ) != 0 );
+}
+
+static void suite_tree_load( void * s, const int64_t * keys, size_t n )
+{
+  size_t i = 0;
+  for( i = 0; i < n; i++ ) {
+    suite_tree_insert( s, keys[ i ] );
+  }
+}
+
+static int suite_tree_find( void * s, int64_t k )
+{
+  return ( tfind( (void*)(intptr_t)k, &(((suite_tree*)s)->root), suite_tree_cmp ) != 0 );
+}
+
+static int suite_tree_remove( void * s, int64_t k )
+{
+  suite_tree * t = s;
+  if( tdelete( (void*)(intptr_t)k, &(t->root), suite_tree_cmp ) ) {
+    t->num --;
+    return 1;
+  }
+  return 0;
+}
+
+// estimate: one malloc'ed node (key, two children, color) with its malloc header per key
+static size_t suite_tree_memory( void * s )
+{
+  return ((suite_tree*)s)->num * ( 4 * sizeof(void*) );
+}
+
+static void suite_tree_noop( void * p )
+{
+}
+
+static void suite_tree_destroy( void * s )
+{
+  tdestroy( ((suite_tree*)s)->root, suite_tree_noop );
+  free( s );
+}
+
+static const suite_structure suite_structures[] = {
+  { "ull", suite_ull_create, suite_ull_load, suite_ull_insert, suite_ull_find, suite_ull_remove,
+    suite_ull_memory, suite_ull_destroy, 0 },
+  { "sorted-array", suite_array_create, suite_array_load, suite_array_insert, suite_array_find, suite_array_remove,
+    suite_array_memory, suite_array_destroy, 100000 },
+  { "tsearch", suite_tree_create, suite_tree_load, suite_tree_insert, suite_tree_find, suite_tree_remove,
+    suite_tree_memory, suite_tree_destroy, 0 }
+};
+
+#define SUITE_UNIFORM 0
+#define SUITE_SEQUENTIAL 1
+#define SUITE_ZIPFIAN 2
+#define SUITE_MIXED 3
+
+static const char * suite_workloads[] = { "uniform", "sequential", "zipfian", "mixed" };
+
+static void suite_report( FILE * csv, const suite_structure * st, int w, size_t n, const char * phase,
+  size_t ops, double ns, size_t memory, const double * counters )
+{
+  printf("%-12s  %-10s  %10ld  %-6s  %8.1f ns/op  %8.2f Mops/s  %6.1f B/elem  %8.2f cache misses/op  %6.2f branch misses/op\n",
+    st->name, suite_workloads[ w ], n, phase, ns / (double)ops, (double)ops / ns * 1e3, (double)memory / (double)n,
+    ( counters[ 0 ] < 0 ? -1.0 : counters[ 0 ] / (double)ops ), ( counters[ 1 ] < 0 ? -1.0 : counters[ 1 ] / (double)ops ) );
+  if( csv ) {
+    fprintf( csv, "%s,%s,%ld,%s,%ld,%.2f,%.4f,%.2f,%.4f,%.4f\n",
+      st->name, suite_workloads[ w ], n, phase, ops, ns / (double)ops, (double)ops / ns * 1e3, (double)memory / (double)n,
+      ( counters[ 0 ] < 0 ? -1.0 : counters[ 0 ] / (double)ops ), ( counters[ 1 ] < 0 ? -1.0 : counters[ 1 ] / (double)ops ) );
+    fflush( csv );
+  }
+}
+
+// one workload of one structure: load n keys, then run the operations of the workload
+static void suite_run( FILE * csv, suite_counters * c, const suite_structure * st, int w, size_t n, size_t ops, suite_zipf * z )
+{
+  int64_t * keys = malloc( n * sizeof(int64_t) );
+  int64_t * queries = malloc( ops * sizeof(int64_t) );
+  void * s = st->create();
+  double counters[ 2 ];
+  double t0 = 0.0, t = 0.0;
+  size_t i = 0, found = 0;
+  for( i = 0; i < n; i++ ) {
+    keys[ i ] = ( w == SUITE_SEQUENTIAL ? (int64_t)i * 2 : rnd() );
+  }
+  // load
+  suite_counters_start( c );
+  t0 = now();
+  st->load( s, keys, n );
+  t = now() - t0;
+  suite_counters_stop( c, counters );
+  suite_report( csv, st, w, n, "load", n, t, st->memory( s ), counters );
+  // lookups (prepared up front, so that the generators are not measured)
+  for( i = 0; i < ops; i++ ) {
+    queries[ i ] = ( w == SUITE_SEQUENTIAL ? keys[ i % n ] : keys[ w == SUITE_ZIPFIAN ? suite_zipf_next( z ) : (size_t)rnd() % n ] );
+  }
+  if( w != SUITE_MIXED ) {
+    suite_counters_start( c );
+    t0 = now();
+    for( i = 0; i < ops; i++ ) {
+      found += (size_t)st->find( s, queries[ i ] );
+    }
+    t = now() - t0;
+    suite_counters_stop( c, counters );
+    suite_report( csv, st, w, n, "lookup", ops, t, st->memory( s ), counters );
+  }
+  else if( ! st->max_mixed || n <= st->max_mixed ) {
+    // 80% lookups, 20% writes: a key is removed and a new one inserted
+    int64_t * fresh = malloc( ops * sizeof(int64_t) );
+    size_t * pos = malloc( ops * sizeof(size_t) );
+    for( i = 0; i < ops; i++ ) {
+      fresh[ i ] = ( rnd() % 10 < 8 ? 0 : rnd() | 1 );
+      pos[ i ] = (size_t)rnd() % n;
+    }
+    suite_counters_start( c );
+    t0 = now();
+    for( i = 0; i < ops; i++ ) {
+      if( ! fresh[ i ] ) {
+        found += (size_t)st->find( s, queries[ i ] );
+      }
+      else {
+        st->remove( s, keys[ pos[ i ] ] );
+        keys[ pos[ i ] ] = fresh[ i ];
+        st->insert( s, fresh[ i ] );
+      }
+    }
+    t = now() - t0;
+    suite_counters_stop( c, counters );
+    suite_report( csv, st, w, n, "mixed", ops, t, st->memory( s ), counters );
+    free( fresh );
+    free( pos );
+  }
+  if( found == (size_t)-1 ) {
+    printf("\n"); // keeps the lookups
+  }
+  st->destroy( s );
+  free( keys );
+  free( queries );
+}
+
+static void bench_suite( size_t max, const char * path )
+{
+  FILE * csv = ( path ? fopen( path, "w" ) : 0 );
+  suite_counters c;
+  size_t n = 0, i = 0;
+  int w = 0;
+  c.fd[ 0 ] = suite_counter_open( 0 );
+  c.fd[ 1 ] = suite_counter_open( 1 );
+  if( c.fd[ 0 ] < 0 || c.fd[ 1 ] < 0 ) {
+    printf("(no hardware counters: perf_event_open() not available, reported as -1)\n");
+  }
+  if( csv ) {
+    fprintf( csv, "structure,workload,size,phase,ops,ns_per_op,mops_per_s,bytes_per_element,cache_misses_per_op,branch_misses_per_op\n" );
+  }
+  for( n = 1000; n <= max; n *= 10 ) {
+    size_t ops = ( n < 1000000 ? 1000000 : n );
+    suite_zipf z;
+    suite_zipf_init( &z, n );
+    for( w = SUITE_UNIFORM; w <= SUITE_MIXED; w++ ) {
+      for( i = 0; i < sizeof(suite_structures) / sizeof(suite_structure); i++ ) {
+        suite_run( csv, &c, &(suite_structures[ i ]), w, n, ops, &z );
+      }
+    }
+  }
+  for( i = 0; i < 2; i++ ) {
+    if( c.fd[ i ] >= 0 ) {
+      close( c.fd[ i ] );
+    }
+  }
+  if( csv ) {
+    fclose( csv );
+  }
+}
+
+int main( int argc, char * * argv )
+{
+  size_t num = ( argc > 1 ? (size_t)atol( argv[ 1 ] ) : 1000000 );
+  size_t lines = 0;
+  if( argc > 1 && strcmp( argv[ 1 ], "suite" ) == 0 ) {
+    bench_suite( ( argc > 2 ? (size_t)atol( argv[ 2 ] ) : 1000000 ), ( argc > 3 ? argv[ 3 ] : 0 ) );
+    return 0;
+  }
+  for( lines = 4; lines <= 16; lines *= 2 ) {
+    bench_kernel( lines );
+  }
+  for( lines = 4; lines <= 16; lines *= 2 ) {
+    bench_list( num, lines );
+  }
+  bench_build( num * 10 );
+  bench_batch( num, 10000, 0 );
+  bench_batch( num, 10000, 1 );
+  bench_finger( num );
+  bench_append( num, 0 );
+  bench_append( num, 1 );
+  bench_save( num * 10 );
+  bench_packed( num );
+  bench_packed( num * 10 );
+  bench_checkpoint( num * 10, 1000 );
+  bench_checkpoint( num * 10, 100000 );
+  for( lines = 1; lines <= 8; lines *= 2 ) {
+    bench_concurrent( num, lines );
+  }
+  for( lines = 1; lines <= 64; lines *= 2 ) {
+    bench_shards( num, lines );
+  }
+  return 0;
+}
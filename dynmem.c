@@ -29,11 +29,17 @@
  
 */
 
+// mremap() and MAP_ANONYMOUS
+#define _GNU_SOURCE
+
 #include "dynmem.h"
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 void hexdump( void * addr, size_t len )
 {
@@ -122,6 +128,236 @@ int dynmem_test( void )
 	return 0;
 }
 
+// system allocator backend: malloc()/realloc()/free()
+static void * _dynmem_malloc_alloc( void * ctx, size_t bytes )
+{
+  return malloc( bytes );
+}
+
+static void * _dynmem_malloc_resize( void * ctx, void * p, size_t old, size_t bytes )
+{
+  return realloc( p, bytes );
+}
+
+static void _dynmem_malloc_release( void * ctx, void * p, size_t bytes )
+{
+  free( p );
+}
+
+const dynmemallocator * dynmem_allocator_malloc( void )
+{
+  static const dynmemallocator a = { _dynmem_malloc_alloc, _dynmem_malloc_resize, _dynmem_malloc_release, 0 };
+  return &a;
+}
+
+// bump arena backend (ctx is a dynmemarena)
+// -> blocks start at a 16 byte boundary
+static void * _dynmem_arena_alloc( void * ctx, size_t bytes )
+{
+  dynmemarena * a = (dynmemarena*)ctx;
+  size_t off = ( a->used + 15 ) & ~((size_t)15);
+  if( off > a->size || a->size - off < bytes ) {
+    return NULL;
+  }
+  a->last = off;
+  a->used = off + bytes;
+  return a->base + off;
+}
+
+static void * _dynmem_arena_resize( void * ctx, void * p, size_t old, size_t bytes )
+{
+  dynmemarena * a = (dynmemarena*)ctx;
+  unsigned char * q = NULL;
+  if( (unsigned char*)p == a->base + a->last ) {
+    // the last block grows/shrinks in place
+    if( a->size - a->last < bytes ) {
+      return NULL;
+    }
+    a->used = a->last + bytes;
+    return p;
+  }
+  q = _dynmem_arena_alloc( ctx, bytes );
+  if( q ) {
+    memcpy( q, p, ( old < bytes ? old : bytes ) );
+  }
+  return q;
+}
+
+static void _dynmem_arena_release( void * ctx, void * p, size_t bytes )
+{
+  dynmemarena * a = (dynmemarena*)ctx;
+  if( (unsigned char*)p == a->base + a->last ) {
+    a->used = a->last;
+  }
+}
+
+const dynmemallocator * dynmem_allocator_arena( void )
+{
+  static const dynmemallocator a = { _dynmem_arena_alloc, _dynmem_arena_resize, _dynmem_arena_release, 0 };
+  return &a;
+}
+
+// inits an arena that carves its blocks from the size bytes at buf
+int dynmem_arena_init( dynmemarena * a, void * buf, size_t size )
+{
+  if( a && buf ) {
+    a->base = (unsigned char*)buf;
+    a->size = size;
+    a->used = 0;
+    a->last = 0;
+    return 1;
+  }
+  return 0;
+}
+
+// mmap backends: blocks are anonymous mappings (rounded up to whole pages) that grow with
+// mremap() on Linux, so the kernel moves the page table entries instead of copying the bytes
+// -> mappings of at least DYNMEM_HUGE_PAGE bytes start at a huge page boundary and are
+//    advised to use transparent huge pages (both backends have DYNMEM_HUGE_PAGE granularity,
+//    so blocks sized to it are backed by whole huge pages)
+// -> the hugetlb backend rounds up to whole huge pages and maps them with MAP_HUGETLB
+//    (falls back to transparent huge pages if no huge pages are reserved)
+static size_t _dynmem_mmap_size( size_t bytes, int huge )
+{
+  size_t page = ( huge ? DYNMEM_HUGE_PAGE : (size_t)sysconf( _SC_PAGESIZE ) );
+  return ( bytes + page - 1 ) / page * page;
+}
+
+static void _dynmem_mmap_advise( void * p, size_t size )
+{
+#ifdef MADV_HUGEPAGE
+  if( size >= DYNMEM_HUGE_PAGE ) {
+    madvise( p, size, MADV_HUGEPAGE );
+  }
+#endif
+}
+
+static void * _dynmem_mmap_map( size_t bytes, int huge )
+{
+  size_t size = _dynmem_mmap_size( bytes, huge );
+  void * p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  if( huge ) {
+    p = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+  }
+#endif
+  if( p == MAP_FAILED ) {
+    // a huge page more, then the unaligned head and the rest of the tail are unmapped
+    size_t extra = ( size >= DYNMEM_HUGE_PAGE ? DYNMEM_HUGE_PAGE : 0 ), head = 0;
+    p = mmap( NULL, size + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if( p == MAP_FAILED ) {
+      return NULL;
+    }
+    if( extra ) {
+      head = ( DYNMEM_HUGE_PAGE - (size_t)( (uintptr_t)p % DYNMEM_HUGE_PAGE ) ) % DYNMEM_HUGE_PAGE;
+      if( head ) {
+        munmap( p, head );
+      }
+      if( extra - head ) {
+        munmap( (unsigned char*)p + head + size, extra - head );
+      }
+      p = (unsigned char*)p + head;
+    }
+    _dynmem_mmap_advise( p, size );
+  }
+  return p;
+}
+
+static void * _dynmem_mmap_remap( void * p, size_t old, size_t bytes, int huge )
+{
+  size_t oldsize = _dynmem_mmap_size( old, huge );
+  size_t newsize = _dynmem_mmap_size( bytes, huge );
+  void * q = NULL;
+  if( oldsize == newsize ) {
+    return p;
+  }
+#ifdef __linux__
+  q = mremap( p, oldsize, newsize, MREMAP_MAYMOVE );
+  if( q != MAP_FAILED ) {
+    _dynmem_mmap_advise( q, newsize );
+    return q;
+  }
+#endif
+  // no mremap() (or not for this mapping) -> copy
+  q = _dynmem_mmap_map( bytes, huge );
+  if( q ) {
+    memcpy( q, p, ( oldsize < newsize ? oldsize : newsize ) );
+    munmap( p, oldsize );
+  }
+  return q;
+}
+
+static void * _dynmem_mmap_alloc( void * ctx, size_t bytes )
+{
+  return _dynmem_mmap_map( bytes, 0 );
+}
+
+static void * _dynmem_mmap_resize( void * ctx, void * p, size_t old, size_t bytes )
+{
+  return _dynmem_mmap_remap( p, old, bytes, 0 );
+}
+
+static void _dynmem_mmap_release( void * ctx, void * p, size_t bytes )
+{
+  munmap( p, _dynmem_mmap_size( bytes, 0 ) );
+}
+
+static void * _dynmem_hugetlb_alloc( void * ctx, size_t bytes )
+{
+  return _dynmem_mmap_map( bytes, 1 );
+}
+
+static void * _dynmem_hugetlb_resize( void * ctx, void * p, size_t old, size_t bytes )
+{
+  return _dynmem_mmap_remap( p, old, bytes, 1 );
+}
+
+static void _dynmem_hugetlb_release( void * ctx, void * p, size_t bytes )
+{
+  munmap( p, _dynmem_mmap_size( bytes, 1 ) );
+}
+
+const dynmemallocator * dynmem_allocator_mmap( void )
+{
+  static const dynmemallocator a = { _dynmem_mmap_alloc, _dynmem_mmap_resize, _dynmem_mmap_release, DYNMEM_HUGE_PAGE };
+  return &a;
+}
+
+const dynmemallocator * dynmem_allocator_hugetlb( void )
+{
+  static const dynmemallocator a = { _dynmem_hugetlb_alloc, _dynmem_hugetlb_resize, _dynmem_hugetlb_release, DYNMEM_HUGE_PAGE };
+  return &a;
+}
+
+// default policy: reserve the next power of 2 above the needed elements (at least
+// DYNMEM_GENERAL_MIN_ELEMENTS), never shrink
+static size_t _dynmem_pow2_grow( const dynmem * mem, size_t numelems )
+{
+  return round_up_to_power_of_2( numelems < DYNMEM_GENERAL_MIN_ELEMENTS ? DYNMEM_GENERAL_MIN_ELEMENTS : numelems );
+}
+
+// like the default policy, but shrinks to the next power of 2 above the length once
+// less than a quarter of the reserved elements is used
+static size_t _dynmem_pow2_shrink( const dynmem * mem )
+{
+  if( mem->length < mem->reserved / 4 && mem->reserved > DYNMEM_GENERAL_MIN_ELEMENTS * 2 ) {
+    return _dynmem_pow2_grow( mem, mem->length );
+  }
+  return mem->reserved;
+}
+
+const dynmempolicy * dynmem_policy_pow2( void )
+{
+  static const dynmempolicy p = { _dynmem_pow2_grow, NULL };
+  return &p;
+}
+
+const dynmempolicy * dynmem_policy_pow2_shrink( void )
+{
+  static const dynmempolicy p = { _dynmem_pow2_grow, _dynmem_pow2_shrink };
+  return &p;
+}
+
 int dynmem_init( dynmem * mem, size_t elemsize )
 {
 	if( mem ) {
@@ -129,20 +365,53 @@ int dynmem_init( dynmem * mem, size_t elemsize )
 		mem->elemsize = elemsize;
 		mem->reserved = 0;
 		mem->length = 0;
-		mem->avg_length_accessed = 0.0;
-		mem->num_accesses = 0;
+		mem->allocator = dynmem_allocator_malloc();
+		mem->allocator_ctx = NULL;
+		mem->policy = dynmem_policy_pow2();
 		return 1;
 	}
 	return 0;
 }
 
+// sets the allocator backend (only while no memory is allocated)
+int dynmem_set_allocator( dynmem * mem, const dynmemallocator * a, void * ctx )
+{
+  if( mem && a && mem->bytes == NULL ) {
+    mem->allocator = a;
+    mem->allocator_ctx = ctx;
+    return 1;
+  }
+  return 0;
+}
+
+// sets the growth policy
+int dynmem_set_policy( dynmem * mem, const dynmempolicy * p )
+{
+  if( mem && p && p->grow ) {
+    mem->policy = p;
+    return 1;
+  }
+  return 0;
+}
+
+// gives the memory back to the allocator (length and reserved become 0)
+void dynmem_free( dynmem * mem )
+{
+  if( mem && mem->bytes ) {
+    (mem->allocator->release)( mem->allocator_ctx, mem->bytes, mem->reserved * mem->elemsize );
+    mem->bytes = NULL;
+    mem->reserved = 0;
+    mem->length = 0;
+  }
+}
+
 void dynmem_debug( dynmem * mem )
 {
 	if( mem ) {
 		size_t numbytes = ( mem->reserved * mem->elemsize );
 		double kb = ( (double)numbytes / (double)1024.0 );
-		printf("<dynmem bytes %s, elemsize %ld, length %ld, avg_length_accessed %.4lf, num_accesses %ld, reserved %ld (%.4lfKB, %ldB)\n",
-			(mem->bytes == NULL ? "NULL" : "DEF"), mem->elemsize, mem->length, mem->avg_length_accessed, mem->num_accesses, mem->reserved, kb, numbytes );
+		printf("<dynmem bytes %s, elemsize %ld, length %ld, reserved %ld (%.4lfKB, %ldB)\n",
+			(mem->bytes == NULL ? "NULL" : "DEF"), mem->elemsize, mem->length, mem->reserved, kb, numbytes );
 		hexdump( mem->bytes, mem->elemsize * mem->length );
 		printf(">\n");
 	}
@@ -151,55 +420,57 @@ void dynmem_debug( dynmem * mem )
 	}
 }
 
+// reallocates the memory to hold exactly reserved elements
+static int _dynmem_realloc( dynmem * mem, size_t reserved )
+{
+  unsigned char * bytes = NULL;
+  if( reserved == 0 ) {
+    dynmem_free( mem );
+    return 1;
+  }
+  if( mem->bytes == NULL ) {
+    bytes = (mem->allocator->alloc)( mem->allocator_ctx, reserved * mem->elemsize );
+  }
+  else {
+    bytes = (mem->allocator->resize)( mem->allocator_ctx, mem->bytes, mem->reserved * mem->elemsize, reserved * mem->elemsize );
+  }
+  if( bytes == NULL ) {
+    return 0; // (the old memory is still valid)
+  }
+  mem->bytes = bytes;
+  mem->reserved = reserved;
+  mem->length = ( mem->length > reserved ? reserved : mem->length );
+  return 1;
+}
+
 // makes sure enough memory for given amount of elements (AND .length elements) is allocated
 // -> changes storage memory
-// -> upsize: to next multiple of n
-// -> downsize (if allowed): downsize to MAX(.max_access,newlength)
+// -> upsize: to the number of elements the policy asks for
 int dynmem_reserve( dynmem * mem, size_t numelems )
 {
-	//printf("--- dynmem_reserve() ---\n");
 	if( mem ) {
-		//size_t current_length = mem->reserved;
 		size_t min_length = ( numelems > mem->length ? numelems : mem->length );
-		size_t new_length = 0;
-		size_t avg_length = (size_t)( (double)(mem->avg_length_accessed) * (double)2.0 );
-
-		//printf("need %ld, avg %.0lf, accesses %ld -> newlen %ld\n", numelems, mem->avg_length_accessed, mem->num_accesses, new_length);
-
-		// if more than double the average length is allocated, the memory is downsized
-		if( mem->num_accesses > 42 && ( (double)(mem->reserved) / (double)2.0 ) > (double)avg_length ) {
-			// take max(min_length,avg_length)
-			min_length = ( avg_length > min_length ? avg_length : min_length );
-		}
-
-		new_length =
-			round_up_to_power_of_2( 
-				min_length < DYNMEM_GENERAL_MIN_ELEMENTS ? DYNMEM_GENERAL_MIN_ELEMENTS : min_length );
-
-		// reallocate
-		if( new_length > mem->reserved ) {
-			//printf("[need %ld] reallocating from %ld to %ld (%lf avg)\n", numelems, mem->reserved, new_length, mem->avg_length_accessed);
-			//printf("REALLOC FROM %ld bytes TO %ld bytes (REQUESTED %ld)\n", mem->reserved * mem->elemsize, new_length * mem->elemsize, numelems );
-			if( mem->bytes == NULL ) {
-				mem->bytes = malloc( new_length * mem->elemsize );
-			}
-			else {
-				mem->bytes = realloc( mem->bytes, new_length * mem->elemsize );				
-			}
-			if( mem->bytes == NULL && new_length > 0 ) {
-				//printf("BAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAD\n");
-				return 0;
-			}
-			else {
-				mem->reserved = new_length;
-				mem->length = ( mem->length > new_length ? new_length : mem->length );
-			}
+		if( min_length > mem->reserved ) {
+			size_t new_length = (mem->policy->grow)( mem, min_length );
+			return _dynmem_realloc( mem, ( new_length > min_length ? new_length : min_length ) );
 		}
 		return 1;
 	}
 	return 0;
 }
 
+// gives memory back if the policy wants to (failing to is fine), at least keep elements
+// stay reserved
+static void _dynmem_shrink( dynmem * mem, size_t keep )
+{
+	if( mem->policy->shrink && keep < mem->reserved ) {
+		size_t want = (mem->policy->shrink)( mem );
+		if( want < mem->reserved ) {
+			_dynmem_realloc( mem, ( want > keep ? want : keep ) );
+		}
+	}
+}
+
 // set .length and make sure enough memory for length elements is allocated
 int dynmem_resize( dynmem * mem, size_t length )
 {
@@ -208,7 +479,12 @@ int dynmem_resize( dynmem * mem, size_t length )
 		// set how many elements the memory SHOULD be able to hold (from the user perspective)
 		mem->length = length;
 		// make sure there is AT LEAST that amount of memory allocated
-		return dynmem_reserve( mem, length );
+		if( ! dynmem_reserve( mem, length ) ) {
+			return 0;
+		}
+		// downsize (if the policy wants to)
+		_dynmem_shrink( mem, length );
+		return 1;
 	}
 	return 0;
 }
@@ -221,7 +497,6 @@ int dynmem_truncate( dynmem * mem )
 }
 
 // set n elements
-// update also .max_access
 int dynmem_set( dynmem * mem, size_t elemoffset, size_t numelems, void * bytes )
 {
 	//printf("--- dynmem_set() ---\n");
@@ -237,9 +512,6 @@ int dynmem_set( dynmem * mem, size_t elemoffset, size_t numelems, void * bytes )
 		}
 		// update length
 		mem->length = ( ( elemoffset + numelems ) > mem->length ? ( elemoffset + numelems ) : mem->length );
-		// update average length accessed
-		mem->avg_length_accessed = ( (double)( mem->avg_length_accessed + elemoffset + numelems ) / (double)2.0 );
-		mem->num_accesses ++;
 		//printf("  -> SET OK: new len %ld\n", mem->length);
 		return 1;
 	}
@@ -247,7 +519,6 @@ int dynmem_set( dynmem * mem, size_t elemoffset, size_t numelems, void * bytes )
 }
 
 // get n elements (must be in range of current length)
-// update also .max_access
 int dynmem_get( dynmem * mem, size_t elemoffset, size_t numelems, void * * bytes )
 {
 	//printf("--- dynmem_get() ---\n");
@@ -257,9 +528,6 @@ int dynmem_get( dynmem * mem, size_t elemoffset, size_t numelems, void * * bytes
 			// copy bytes from dynmem storage to output
 			*bytes = mem->bytes + ( elemoffset * mem->elemsize );
 		}
-		// update average length accessed
-		mem->avg_length_accessed = ( (double)( mem->avg_length_accessed + elemoffset + numelems ) / (double)2.0 );
-		mem->num_accesses ++;
 		//printf("  -> GET OK\n");
 		return 1;
 	}
@@ -274,12 +542,19 @@ int dynmem_push( dynmem * mem, void * inbytes, void * * outbytes )
   return dynmem_set( mem, elemoffset, 1, inbytes ) && dynmem_get( mem, elemoffset, 1, outbytes );
 }
 
-// set .length
+// set .length, return ptr to the removed last element
+// -> the removed element stays reserved when the policy shrinks the memory, so the
+//    pointer is valid until the next change of the dynmem
 int dynmem_pop( dynmem * mem, void * * bytes )
 {
 	//printf("--- dynmem_pop() ---\n");
-  if( mem && mem->length > 0 && dynmem_get( mem, mem->length, 1, bytes ) ) {
-    return dynmem_resize( mem, dynmem_length( mem ) - 1 );
+  if( mem && mem->length > 0 ) {
+    mem->length --;
+    _dynmem_shrink( mem, mem->length + 1 );
+    if( bytes ) {
+      *bytes = mem->bytes + ( mem->length * mem->elemsize );
+    }
+    return 1;
   }
   return 0;
 }
@@ -33,27 +33,81 @@
 
 #include <string.h>
 
+struct _dynmem;
+
+// allocator backend of a dynmem (see dynmem_set_allocator())
+// -> alloc returns a block of at least bytes bytes (or NULL)
+// -> resize grows (or shrinks) block p of old bytes to bytes, keeping its content,
+//    and returns the (maybe moved) block or NULL (p is still valid then)
+// -> release gives back block p of bytes bytes
+// -> granularity is the block size the backend rounds up to (0 if it does not), callers
+//    that allocate many blocks of their own (e.g. node slabs) size them to multiples of it
+// -> ctx is the context passed to dynmem_set_allocator() (e.g. a dynmemarena)
+typedef struct _dynmemallocator {
+  void * (*alloc)( void * ctx, size_t bytes );
+  void * (*resize)( void * ctx, void * p, size_t old, size_t bytes );
+  void (*release)( void * ctx, void * p, size_t bytes );
+  size_t granularity;
+}
+dynmemallocator;
+
+// growth policy of a dynmem (see dynmem_set_policy())
+// -> grow returns the number of elements to reserve so that at least numelems fit
+// -> shrink (optional) returns the number of elements to keep reserved after the length
+//    dropped (mem->reserved to keep all), only called by dynmem_resize()/dynmem_pop()
+typedef struct _dynmempolicy {
+  size_t (*grow)( const struct _dynmem * mem, size_t numelems );
+  size_t (*shrink)( const struct _dynmem * mem );
+}
+dynmempolicy;
+
+// bump arena (see dynmem_allocator_arena()): blocks are carved from a caller-provided buffer,
+// the last block grows and shrinks in place, released blocks are only reused if they were the last
+typedef struct _dynmemarena {
+  unsigned char * base;
+  size_t size;
+  size_t used;
+  // offset of the last block
+  size_t last;
+}
+dynmemarena;
+
 // type that represents a heap allocated dynamic memory buffer
 // -> all LOGICAL ACCESSING functions (get/set/resize/push/pop) MUST ENSURE ENOUGH MEMORY is allocated
-// -> INTERNALLY the length_accessed length is used to determine how to scale the memory up/down AS SEEN FIT
-//    MAYBE: only ever scale up! special function dynmem_crop() to scale DOWN to a reasonable memory amount if requested!  
+// -> the allocator decides where the memory comes from, the policy how much of it is reserved
+//    (only when the memory has to grow or the length dropped, not on every access)
 typedef struct _dynmem {
 	// don't mess with this...
   unsigned char * bytes;
   size_t elemsize;
   size_t reserved; // number of elements max storable
   size_t length; // max number of elements used/accessed (arbitrary)
-  double avg_length_accessed; // average max number of elements accessed through dynmem_set() or dynmem_get()
-  size_t num_accesses; // number of accesses (used to determine if downsizing is allowed)
+  const dynmemallocator * allocator;
+  void * allocator_ctx;
+  const dynmempolicy * policy;
 }
 dynmem;
 
 #define DYNMEM_GENERAL_MIN_ELEMENTS 32
+// size of a huge page (see dynmem_allocator_mmap() and dynmem_allocator_hugetlb())
+#ifndef DYNMEM_HUGE_PAGE
+	#define DYNMEM_HUGE_PAGE ( (size_t)2 * 1024 * 1024 )
+#endif
 #ifndef DYNMEM_USE_MULTITHREADED_GLOBAL_BYTE_STORAGE
 	#define DYNMEM_USE_MULTITHREADED_GLOBAL_BYTE_STORAGE 1
 #endif
 
 extern int dynmem_init( dynmem * mem, size_t elemsize );
+extern int dynmem_set_allocator( dynmem * mem, const dynmemallocator * a, void * ctx );
+extern int dynmem_set_policy( dynmem * mem, const dynmempolicy * p );
+extern void dynmem_free( dynmem * mem );
+extern const dynmemallocator * dynmem_allocator_malloc( void );
+extern const dynmemallocator * dynmem_allocator_arena( void );
+extern const dynmemallocator * dynmem_allocator_mmap( void );
+extern const dynmemallocator * dynmem_allocator_hugetlb( void );
+extern int dynmem_arena_init( dynmemarena * a, void * buf, size_t size );
+extern const dynmempolicy * dynmem_policy_pow2( void );
+extern const dynmempolicy * dynmem_policy_pow2_shrink( void );
 extern void dynmem_debug( dynmem * mem );
 extern int dynmem_reserve( dynmem * mem, size_t numelems );
 extern int dynmem_resize( dynmem * mem, size_t length );
@@ -1,34 +1,1709 @@
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "ull.h"
+#include "ullshard.h"
+
+ULL_DEFINE( ullint, int, ( a < b ? -1 : ( a > b ? 1 : 0 ) ) )
+ULL_DEFINE( ulldbl, double, ( a < b ? -1 : ( a > b ? 1 : 0 ) ) )
+ULL_DEFINE_I64( ulli64 )
+typedef struct { int64_t twice; int version; } payload;
+ULL_DEFINE_MAP( ullmap, int, payload, ( a < b ? -1 : ( a > b ? 1 : 0 ) ) )
+ULL_DEFINE_KEYOPS( scalar_i32, int32_t, ( a < b ? -1 : ( a > b ? 1 : 0 ) ) )
+ULL_DEFINE_KEYOPS( scalar_i64, int64_t, ( a < b ? -1 : ( a > b ? 1 : 0 ) ) )
+ULL_DEFINE_KEYOPS( scalar_f64, double, ( a < b ? -1 : ( a > b ? 1 : 0 ) ) )
+
+static int failures = 0;
+
+#define CHECK( cond ) \
+  do { \
+    if( ! (cond) ) { \
+      printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      failures ++; \
+    } \
+  } while( 0 )
 
 int cmp( void * a, void * b )
 {
   int ia = *((int*)a);
-  int ib = *((int*)a);
+  int ib = *((int*)b);
   return ( ia < ib ? -1 : ( ia > ib ? 1 : 0 ) );
 }
 
 void dbg( void * a )
 {
   int ia = *((int*)a);
-	printf("%d", ia);
+	printf("%d\n", ia);
 }
 
-int main( void )
+// walks the node chain and checks links, order and the total element count
+static size_t check_chain( ull * u )
+{
+  size_t total = 0, nodes = 0;
+  ullnode * n = u->root;
+  ullnode * prev = 0;
+  int * last = 0;
+  int64_t lastk = 0;
+  while( n ) {
+    size_t i = 0;
+    CHECK( ULL_PREV( u, n ) == prev );
+    CHECK( n->num_elements > 0 && n->num_elements < u->capacity );
+    for( i = 0; i < n->num_elements && u->packed; i++ ) {
+      // (packed lists of int64_t)
+      int64_t k = 0;
+      _ull_node_copy( u, n, i, &k );
+      CHECK( ( prev == 0 && i == 0 ) || lastk <= k );
+      lastk = k;
+    }
+    for( i = 0; i < n->num_elements && ! u->packed; i++ ) {
+      int * e = (int*)_ull_node_element( u, n, i );
+      CHECK( ! last || *last <= *e );
+      last = e;
+    }
+    total += n->num_elements;
+    nodes ++;
+    prev = n;
+    n = ULL_NEXT( u, n );
+  }
+  CHECK( nodes == u->num_nodes );
+  CHECK( u->tail == prev );
+  return total;
+}
+
+// checks parent links, first elements and element counts of the index,
+// returns the number of leaves
+static size_t check_index( ull * u, ullindex * p, size_t depth, ullnode * * leaf )
+{
+  size_t i = 0, j = 0, num = 0;
+  CHECK( p->num_children > 0 && p->num_children <= ULL_INDEX_FANOUT );
+  for( i = 0; i < p->num_children; i++ ) {
+    if( p->leaves ) {
+      ullnode * n = (ullnode*)ULL_CHILD( u, p, i );
+      CHECK( depth == u->index_height );
+      CHECK( n == *leaf );
+      CHECK( ULL_PARENT( u, n ) == p && memcmp( ULL_INDEX_FIRST( u, p, i ), ULL_NODE_KEY( u, n, 0 ), u->keysize ) == 0 );
+      CHECK( (p->counts)[ i ] == n->num_elements );
+      *leaf = ULL_NEXT( u, n );
+      num ++;
+    }
+    else {
+      ullindex * c = (ullindex*)ULL_CHILD( u, p, i );
+      size_t count = 0;
+      CHECK( ULL_PARENT( u, c ) == p && memcmp( ULL_INDEX_FIRST( u, p, i ), ULL_INDEX_FIRST( u, c, 0 ), u->keysize ) == 0 );
+      for( j = 0; j < c->num_children; j++ ) {
+        count += (c->counts)[ j ];
+      }
+      CHECK( (p->counts)[ i ] == count );
+      num += check_index( u, c, depth + 1, leaf );
+    }
+  }
+  return num;
+}
+
+static size_t check_list( ull * u )
+{
+  size_t total = check_chain( u );
+  CHECK( ull_size( u ) == total );
+  if( u->root ) {
+    ullnode * leaf = u->root;
+    CHECK( u->index_root && u->index_root->parent == 0 );
+    CHECK( check_index( u, u->index_root, 1, &leaf ) == u->num_nodes && leaf == 0 );
+  }
+  return total;
+}
+
+// dynmem backends: fill a buffer element by element and read it back
+static int fill_dynmem( dynmem * d, int n )
+{
+  int i = 0, errors = 0;
+  int * e = 0;
+  dynmem_truncate( d );
+  for( i = 0; i < n; i++ ) {
+    errors += ! dynmem_push( d, &i, 0 );
+  }
+  for( i = 0; i < n; i++ ) {
+    errors += ( ! dynmem_get( d, (size_t)i, 1, (void**)&e ) || *e != i );
+  }
+  return errors == 0 && dynmem_length( d ) == (size_t)n;
+}
+
+static void test_dynmem( void )
+{
+  dynmem d;
+  dynmemarena a;
+  unsigned char * buf = malloc( 1 << 20 );
+  unsigned char * first = 0;
+  unsigned char * * slab = 0;
+  static int keys[ 100000 ];
+  ull u;
+  int * e = 0;
+  int k = 0;
+  dynmem_init( &d, sizeof(int) );
+  CHECK( fill_dynmem( &d, 100000 ) && d.reserved >= 100000 );
+  dynmem_free( &d );
+  CHECK( d.bytes == 0 && d.reserved == 0 && dynmem_length( &d ) == 0 );
+  // mmap'ed memory grows by remapping
+  CHECK( dynmem_set_allocator( &d, dynmem_allocator_mmap(), 0 ) );
+  CHECK( fill_dynmem( &d, 1000000 ) );
+  dynmem_free( &d );
+  CHECK( dynmem_set_allocator( &d, dynmem_allocator_hugetlb(), 0 ) );
+  CHECK( fill_dynmem( &d, 1000000 ) );
+  CHECK( ! dynmem_set_allocator( &d, dynmem_allocator_malloc(), 0 ) );
+  dynmem_free( &d );
+  // the last block of an arena grows in place until the arena is full
+  CHECK( dynmem_arena_init( &a, buf, 1 << 20 ) && dynmem_set_allocator( &d, dynmem_allocator_arena(), &a ) );
+  CHECK( fill_dynmem( &d, 100 ) );
+  first = d.bytes;
+  CHECK( fill_dynmem( &d, 100000 ) && d.bytes == first && a.used == d.reserved * sizeof(int) );
+  k = 1;
+  CHECK( ! dynmem_set( &d, 300000, 1, &k ) && dynmem_length( &d ) == 100000 );
+  CHECK( dynmem_get( &d, 99999, 1, (void**)&e ) && *e == 99999 );
+  dynmem_free( &d );
+  CHECK( a.used == 0 );
+  // the shrinking policy gives memory back once the length dropped
+  dynmem_init( &d, sizeof(int) );
+  CHECK( dynmem_set_policy( &d, dynmem_policy_pow2_shrink() ) );
+  CHECK( fill_dynmem( &d, 100000 ) && dynmem_resize( &d, 10 ) && d.reserved <= 2 * DYNMEM_GENERAL_MIN_ELEMENTS );
+  CHECK( dynmem_get( &d, 9, 1, (void**)&e ) && *e == 9 );
+  // ... also when the elements are popped one by one
+  CHECK( fill_dynmem( &d, 100000 ) );
+  for( k = 99999; k >= 10; k-- ) {
+    CHECK( dynmem_pop( &d, (void**)&e ) && *e == k );
+  }
+  CHECK( dynmem_length( &d ) == 10 && d.reserved <= 2 * DYNMEM_GENERAL_MIN_ELEMENTS );
+  dynmem_free( &d );
+  // a list whose slab table and node slabs are mmap'ed (the backend is set before ull_init()):
+  // the slabs are whole huge pages
+  CHECK( dynmem_set_allocator( &d, dynmem_allocator_mmap(), 0 ) );
+  CHECK( ull_init( &u, &d, cmp ) && d.allocator == dynmem_allocator_mmap() );
+  for( k = 0; k < 100000; k++ ) {
+    keys[ k ] = k;
+    CHECK( ull_insert( &u, &(keys[ k ]) ) );
+  }
+  CHECK( check_list( &u ) == 100000 );
+  CHECK( u.nodes.slab_objects * u.node_size > DYNMEM_HUGE_PAGE - u.node_size - ULL_CACHE_LINE );
+  CHECK( dynmem_get( &d, 0, 1, (void**)&slab ) && (uintptr_t)(*slab) % DYNMEM_HUGE_PAGE == 0 );
+  ull_remove_all( &u );
+  dynmem_free( &d );
+  // ... and a list whose node slabs are carved from an arena
+  CHECK( dynmem_arena_init( &a, buf, 1 << 20 ) && dynmem_set_allocator( &d, dynmem_allocator_arena(), &a ) );
+  CHECK( ull_init( &u, &d, cmp ) );
+  for( k = 0; k < 10000; k++ ) {
+    CHECK( ull_insert( &u, &(keys[ k ]) ) );
+  }
+  CHECK( check_list( &u ) == 10000 && a.used >= u.num_nodes * u.node_size );
+  CHECK( (unsigned char*)(u.root) >= buf && (unsigned char*)(u.root) < buf + ( 1 << 20 ) );
+  ull_remove_all( &u );
+  CHECK( d.allocator == dynmem_allocator_arena() );
+  free( buf );
+}
+
+static void test_basic( void )
 {
   ull u;
   dynmem d;
   int i = 42, j = 41;
   int * k = 0;
   dynmem_init( &d, sizeof(int) );
-  ull_init( &u, &d, cmp );
-  
-  ull_insert( &u, (void*)&i );
-	ull_debug( &u, dbg );
-  printf("u has %ld elements\n", ull_size( &u ));
-  
-  ull_get_nearest( &u, (void*)&j, 0, (void**)&k );
-  printf("k = %d\n", *k);
+  CHECK( ull_init( &u, &d, cmp ) );
   
+  CHECK( ull_insert( &u, (void*)&i ) );
+  CHECK( ull_get_nearest( &u, (void*)&j, 0, (void**)&k ) && k == &i );
+  CHECK( ! ull_get_nearest( &u, (void*)&j, 1, (void**)&k ) );
+  CHECK( ull_remove_all( &u ) );
+}
+
+static void test_many( void )
+{
+  ull u;
+  dynmem d;
+  size_t n = 20000, i = 0;
+  int * values = malloc( n * sizeof(int) );
+  dynmem_init( &d, 1 );
+  ull_init( &u, &d, cmp );
+  srand( 1 );
+  for( i = 0; i < n; i++ ) {
+    values[ i ] = rand() % 100000;
+    CHECK( ull_insert( &u, (void*)&(values[ i ]) ) );
+  }
+  // nodes come from slabs that never move -> all links must still be intact
+  CHECK( check_list( &u ) == n );
+  CHECK( u.index_height > 1 );
+  for( i = 0; i < n; i++ ) {
+    int * k = 0;
+    CHECK( ull_get_nearest( &u, (void*)&(values[ i ]), 1, (void**)&k ) && *k == values[ i ] );
+  }
+  ull_remove_all( &u );
+  CHECK( u.root == 0 && u.num_nodes == 0 && dynmem_length( &d ) == 0 );
+  // list is usable again after bulk release
+  CHECK( ull_insert( &u, (void*)&(values[ 0 ]) ) && check_list( &u ) == 1 );
+  ull_remove_all( &u );
+  free( values );
+}
+
+static void test_nearest( void )
+{
+  ull u;
+  dynmem d;
+  int values[ 1000 ];
+  int i = 0, q = 0;
+  dynmem_init( &d, 1 );
+  ull_init( &u, &d, cmp );
+  for( i = 0; i < 1000; i++ ) {
+    values[ i ] = i * 10;
+    ull_insert( &u, (void*)&(values[ i ]) );
+  }
+  for( q = -5; q < 10010; q++ ) {
+    int * k = 0;
+    int found = ull_get_nearest( &u, (void*)&q, 1, (void**)&k );
+    CHECK( found == ( q >= 0 && q < 10000 && q % 10 == 0 ) );
+    CHECK( ! found || *k == q );
+    // the nearest element is a direct neighbour of q
+    CHECK( ull_get_nearest( &u, (void*)&q, 0, (void**)&k ) );
+    if( q < 0 ) {
+      CHECK( *k == 0 );
+    }
+    else if( q >= 9990 ) {
+      CHECK( *k == 9990 );
+    }
+    else {
+      CHECK( *k == q - q % 10 || *k == q - q % 10 + 10 );
+      CHECK( q % 10 != 0 || *k == q );
+    }
+  }
+  ull_remove_all( &u );
+}
+
+static void test_sequential( void )
+{
+  ull u;
+  dynmem d;
+  size_t n = 50000, i = 0;
+  int * values = malloc( n * sizeof(int) );
+  dynmem_init( &d, 1 );
+  ull_init( &u, &d, cmp );
+  // descending inserts always change the first element of the first node
+  for( i = 0; i < n; i++ ) {
+    values[ i ] = (int)( n - i );
+    ull_insert( &u, (void*)&(values[ i ]) );
+  }
+  CHECK( check_list( &u ) == n );
+  for( i = 0; i < n; i += 7 ) {
+    int * k = 0;
+    CHECK( ull_get_nearest( &u, (void*)&(values[ i ]), 1, (void**)&k ) && *k == values[ i ] );
+  }
+  ull_remove_all( &u );
+  free( values );
+}
+
+static void test_typed( void )
+{
+  ullint l;
+  ulldbl ld;
+  dynmem d, dd;
+  size_t n = 20000, i = 0;
+  int k = 0;
+  double x = 0.0;
+  dynmem_init( &d, sizeof(void*) );
+  ullint_init( &l, &d );
+  dynmem_init( &dd, sizeof(void*) );
+  ulldbl_init( &ld, &dd );
+  srand( 2 );
+  for( i = 0; i < n; i++ ) {
+    // keys are stored by value, so a temporary is fine
+    int v = (int)( rand() % 100000 ) * 2;
+    CHECK( ullint_insert( &l, v ) );
+    CHECK( ulldbl_insert( &ld, (double)v / 4.0 ) );
+  }
+  // int keys are stored inline: the chain walk sees them through _ull_node_element
+  CHECK( check_list( &(l.u) ) == n );
+  for( i = 0; i < 1000; i++ ) {
+    int q = (int)( rand() % 200000 );
+    int found = ullint_get_nearest( &l, q, 1, &k );
+    CHECK( ! found || k == q );
+    CHECK( ( q % 2 != 0 ) ? ! found : 1 );
+    CHECK( ullint_get_nearest( &l, q, 0, &k ) );
+    CHECK( ulldbl_get_nearest( &ld, (double)q / 4.0, 0, &x ) );
+  }
+  CHECK( ullint_insert( &l, -1 ) && ullint_get_nearest( &l, -1, 1, &k ) && k == -1 );
+  CHECK( ulldbl_insert( &ld, 0.125 ) && ulldbl_get_nearest( &ld, 0.125, 1, &x ) && x == 0.125 );
+  ullint_remove_all( &l );
+  ulldbl_remove_all( &ld );
+}
+
+static void test_simd( void )
+{
+  int32_t k32[ 100 ];
+  int64_t k64[ 100 ];
+  double kf[ 100 ];
+  size_t n = 0, i = 0;
+  int upper = 0;
+  ulli64 l;
+  dynmem d;
+  int64_t k = 0;
+  // the selected kernels must agree with the scalar binary searches
+  srand( 3 );
+  for( n = 0; n < 100; n++ ) {
+    for( i = 0; i < n; i++ ) {
+      k32[ i ] = ( i > 0 ? k32[ i - 1 ] : -50 ) + rand() % 3;
+      k64[ i ] = ( i > 0 ? k64[ i - 1 ] : -50 ) + rand() % 3;
+      kf[ i ] = (double)k64[ i ] / 2.0;
+    }
+    for( upper = 0; upper < 2; upper++ ) {
+      int32_t q32 = (int32_t)( rand() % 200 ) - 60;
+      int64_t q64 = (int64_t)( rand() % 200 ) - 60;
+      double qf = (double)q64 / 2.0;
+      CHECK( (ull_keyops_i32()->search)( 0, k32, n, &q32, upper ) == scalar_i32_search( 0, k32, n, &q32, upper ) );
+      CHECK( (ull_keyops_i64()->search)( 0, k64, n, &q64, upper ) == scalar_i64_search( 0, k64, n, &q64, upper ) );
+      CHECK( (ull_keyops_f64()->search)( 0, kf, n, &qf, upper ) == scalar_f64_search( 0, kf, n, &qf, upper ) );
+    }
+  }
+  // nodes of 8 cache lines
+  dynmem_init( &d, sizeof(void*) );
+  ulli64_init( &l, &d );
+  CHECK( ull_set_node_capacity( &(l.u), 8 * ULL_CACHE_LINE / sizeof(int64_t) ) );
+  for( i = 0; i < 10000; i++ ) {
+    ulli64_insert( &l, (int64_t)( i * 3 ) );
+  }
+  CHECK( ! ull_set_node_capacity( &(l.u), 16 ) );
+  CHECK( check_list( &(l.u) ) == 10000 );
+  for( i = 0; i < 30000; i++ ) {
+    CHECK( ulli64_get_nearest( &l, (int64_t)i, 1, &k ) == ( i % 3 == 0 ) );
+  }
+  CHECK( ( (uintptr_t)ULL_NODE_KEY( &(l.u), l.u.root, 0 ) % ULL_CACHE_LINE ) == 0 );
+  ulli64_remove_all( &l );
+}
+
+static void test_build( void )
+{
+  ull u;
+  ulli64 l;
+  dynmem d, dl;
+  size_t sizes[] = { 0, 1, 2, 31, 32, 100, 5000, 100000 };
+  double fills[] = { 0.01, 0.5, 0.8, 1.0 };
+  size_t n = 100000, i = 0, s = 0, f = 0;
+  int * values = malloc( n * sizeof(int) );
+  int * * elems = malloc( n * sizeof(int*) );
+  int64_t * keys = malloc( n * sizeof(int64_t) );
+  int64_t k = 0;
+  for( i = 0; i < n; i++ ) {
+    values[ i ] = (int)( i * 2 );
+    elems[ i ] = &(values[ i ]);
+    keys[ i ] = (int64_t)( i * 2 );
+  }
+  dynmem_init( &d, sizeof(void*) );
+  ull_init( &u, &d, cmp );
+  dynmem_init( &dl, sizeof(void*) );
+  ulli64_init( &l, &dl );
+  for( s = 0; s < sizeof(sizes) / sizeof(sizes[ 0 ]); s++ ) {
+    for( f = 0; f < sizeof(fills) / sizeof(fills[ 0 ]); f++ ) {
+      CHECK( ull_build_from_sorted( &u, elems, sizes[ s ], fills[ f ] ) );
+      CHECK( check_list( &u ) == sizes[ s ] );
+      CHECK( ulli64_build_from_sorted( &l, keys, sizes[ s ], fills[ f ] ) );
+      CHECK( check_list( &(l.u) ) == sizes[ s ] );
+      for( i = 0; i < sizes[ s ]; i += 17 ) {
+        int * e = 0;
+        CHECK( ull_get_nearest( &u, (void*)&(values[ i ]), 1, (void**)&e ) && e == &(values[ i ]) );
+        CHECK( ulli64_get_nearest( &l, keys[ i ] + 1, 0, &k ) && ( k == keys[ i ] || k == keys[ i ] + 2 ) );
+      }
+    }
+  }
+  // a built list keeps working with inserts
+  CHECK( ull_build_from_sorted( &u, elems, n, 1.0 ) );
+  for( i = 0; i < n; i += 3 ) {
+    CHECK( ull_insert( &u, (void*)&(values[ i ]) ) );
+  }
+  CHECK( check_list( &u ) == n + ( n + 2 ) / 3 );
+  CHECK( ! ull_build_from_sorted( &u, elems, n, 0.0 ) );
+  ull_remove_all( &u );
+  ulli64_remove_all( &l );
+  free( values );
+  free( elems );
+  free( keys );
+}
+
+static void test_batch( void )
+{
+  ull u;
+  ulli64 l;
+  dynmem d, dl;
+  size_t n = 60000, i = 0, total = 0, b = 0;
+  int * values = malloc( n * sizeof(int) );
+  int * * elems = malloc( n * sizeof(int*) );
+  int64_t * keys = malloc( n * sizeof(int64_t) );
+  int64_t k = 0;
+  srand( 5 );
+  for( i = 0; i < n; i++ ) {
+    values[ i ] = rand() % 50000;
+    elems[ i ] = &(values[ i ]);
+    keys[ i ] = (int64_t)values[ i ];
+  }
+  dynmem_init( &d, sizeof(void*) );
+  ull_init( &u, &d, cmp );
+  dynmem_init( &dl, sizeof(void*) );
+  ulli64_init( &l, &dl );
+  // batches of growing size, the first one goes into the empty list
+  for( b = 1; total < n; b *= 3 ) {
+    size_t cnt = ( total + b > n ? n - total : b );
+    CHECK( ull_insert_batch( &u, elems + total, cnt ) );
+    CHECK( ulli64_insert_batch( &l, keys + total, cnt ) );
+    total += cnt;
+    CHECK( check_list( &u ) == total );
+    CHECK( check_list( &(l.u) ) == total );
+  }
+  for( i = 0; i < n; i += 11 ) {
+    int * e = 0;
+    CHECK( ull_get_nearest( &u, (void*)&(values[ i ]), 1, (void**)&e ) && *e == values[ i ] );
+    CHECK( ulli64_get_nearest( &l, keys[ i ], 1, &k ) && k == keys[ i ] );
+  }
+  // a batch of duplicates and keys before/after all others
+  for( i = 0; i < 100; i++ ) {
+    keys[ i ] = ( i % 3 == 0 ? -1 : ( i % 3 == 1 ? 7 : 1000000 ) );
+  }
+  CHECK( ulli64_insert_batch( &l, keys, 100 ) );
+  CHECK( check_list( &(l.u) ) == n + 100 );
+  CHECK( ulli64_get_nearest( &l, -5, 0, &k ) && k == -1 );
+  ull_remove_all( &u );
+  ulli64_remove_all( &l );
+  free( values );
+  free( elems );
+  free( keys );
+}
+
+// every node but a single one must hold at least the min fill
+static void check_min_fill( ull * u )
+{
+  ullnode * n = u->root;
+  while( n && u->num_nodes > 1 ) {
+    CHECK( n->num_elements >= _ull_min_fill( u ) );
+    n = n->next;
+  }
+}
+
+static void test_remove( void )
+{
+  ullint l;
+  dynmem d;
+  size_t n = 20000, i = 0, live = 0, nodes = 0;
+  int * values = malloc( n * sizeof(int) );
+  int k = 0;
+  dynmem_init( &d, sizeof(void*) );
+  ullint_init( &l, &d );
+  srand( 6 );
+  for( i = 0; i < n; i++ ) {
+    values[ i ] = rand() % 5000;
+    CHECK( ullint_insert( &l, values[ i ] ) );
+  }
+  nodes = l.u.num_nodes;
+  // remove every other inserted value (one of its duplicates each time)
+  for( i = 0; i < n; i += 2 ) {
+    CHECK( ullint_remove( &l, values[ i ] ) );
+  }
+  CHECK( ! ullint_remove( &l, -1 ) && ! ullint_remove( &l, 5000 ) );
+  live = n / 2;
+  CHECK( check_list( &(l.u) ) == live );
+  check_min_fill( &(l.u) );
+  CHECK( l.u.num_nodes < nodes );
+  for( i = 1; i < n; i += 2 ) {
+    CHECK( ullint_get_nearest( &l, values[ i ], 1, &k ) && k == values[ i ] );
+  }
+  // ranges inside a node, across many nodes, and empty ones
+  for( i = 1; i < n; i += 2 ) {
+    live -= ( values[ i ] >= 1000 && values[ i ] <= 3999 ) + ( values[ i ] == 4500 );
+  }
+  CHECK( ullint_remove_range( &l, 1000, 3999 ) + ullint_remove_range( &l, 4500, 4500 ) == n / 2 - live );
+  CHECK( ullint_remove_range( &l, 2000, 3000 ) == 0 && ullint_remove_range( &l, 10, 5 ) == 0 );
+  CHECK( check_list( &(l.u) ) == live );
+  check_min_fill( &(l.u) );
+  CHECK( ullint_get_nearest( &l, 1000, 0, &k ) && ( k < 1000 || k >= 4000 ) );
+  // freed nodes are reused: removing and reinserting does not grow the pool
+  nodes = l.u.nodes.used_in_slab;
+  CHECK( ullint_remove_range( &l, 0, 4999 ) == live );
+  CHECK( l.u.root == 0 && l.u.index_root == 0 && l.u.num_nodes == 0 );
+  for( i = 0; i < n / 4; i++ ) {
+    CHECK( ullint_insert( &l, values[ i ] ) );
+  }
+  CHECK( check_list( &(l.u) ) == n / 4 && l.u.nodes.used_in_slab == nodes );
+  // without merging only empty nodes are dropped
+  CHECK( ull_set_merge_threshold( &(l.u), 0.0 ) && ! ull_set_merge_threshold( &(l.u), 0.6 ) );
+  for( i = 0; i < n / 4; i += 3 ) {
+    CHECK( ullint_remove( &l, values[ i ] ) );
+  }
+  check_list( &(l.u) );
+  ullint_remove_all( &l );
+  free( values );
+}
+
+static int cmp_int( const void * a, const void * b )
+{
+  return cmp( (void*)a, (void*)b );
+}
+
+static void test_positions( void )
+{
+  ullint l;
+  dynmem d;
+  size_t n = 30000, i = 0;
+  int * values = malloc( n * sizeof(int) );
+  int k = 0;
+  dynmem_init( &d, sizeof(void*) );
+  ullint_init( &l, &d );
+  CHECK( ullint_size( &l ) == 0 && ! ullint_get( &l, 0, &k ) && ullint_rank( &l, 5 ) == 0 );
+  srand( 7 );
+  for( i = 0; i < n; i++ ) {
+    values[ i ] = rand() % 10000;
+    CHECK( ullint_insert( &l, values[ i ] ) );
+  }
+  CHECK( check_list( &(l.u) ) == n );
+  qsort( values, n, sizeof(int), cmp_int );
+  for( i = 0; i < n; i += 7 ) {
+    size_t first = i;
+    while( first > 0 && values[ first - 1 ] == values[ i ] ) {
+      first --;
+    }
+    CHECK( ullint_get( &l, i, &k ) && k == values[ i ] );
+    CHECK( ullint_rank( &l, values[ i ] ) == first );
+  }
+  CHECK( ullint_get( &l, n - 1, &k ) && k == values[ n - 1 ] && ! ullint_get( &l, n, &k ) );
+  CHECK( ullint_rank( &l, -1 ) == 0 && ullint_rank( &l, 10000 ) == n );
+  // counts follow removals, merges and batch inserts
+  ullint_remove_range( &l, 2000, 7999 );
+  CHECK( check_list( &(l.u) ) == ullint_size( &l ) );
+  CHECK( ullint_rank( &l, 8000 ) == ullint_rank( &l, 2000 ) );
+  CHECK( ullint_insert_batch( &l, values, n / 2 ) );
+  CHECK( check_list( &(l.u) ) == ullint_size( &l ) );
+  CHECK( ullint_build_from_sorted( &l, values, n, 0.5 ) && check_list( &(l.u) ) == n );
+  CHECK( ullint_get( &l, n / 2, &k ) && k == values[ n / 2 ] );
+  ullint_remove_all( &l );
+  CHECK( ullint_size( &l ) == 0 );
+  free( values );
+}
+
+static void test_cursor( void )
+{
+  ull u;
+  ullint l;
+  dynmem d, dl;
+  ullcursor c;
+  size_t n = 20000, i = 0, len = 0;
+  int * values = malloc( n * sizeof(int) );
+  const int * keys = 0;
+  void * span = 0;
+  int * e = 0;
+  int k = 0, v = 2001;
+  dynmem_init( &dl, sizeof(void*) );
+  ullint_init( &l, &dl );
+  dynmem_init( &d, sizeof(void*) );
+  ull_init( &u, &d, cmp );
+  CHECK( ullint_cursor_init( &c, &l ) && ! ullint_next( &c, &k ) && ! ull_seek_end( &c ) && ! ullint_seek( &c, 1 ) );
+  srand( 8 );
+  for( i = 0; i < n; i++ ) {
+    values[ i ] = rand() % 10000;
+    CHECK( ullint_insert( &l, values[ i ] ) );
+    CHECK( ull_insert( &u, (void*)&(values[ i ]) ) );
+  }
+  // forward, backward and span-wise over the whole list
+  CHECK( ullint_cursor_init( &c, &l ) );
+  for( i = 0; ullint_next( &c, &k ); i++ ) {
+    CHECK( ullint_get( &l, i, &v ) && k == v );
+  }
+  CHECK( i == n );
+  for( i = n; ullint_prev( &c, &k ); i-- ) {
+    CHECK( ullint_get( &l, i - 1, &v ) && k == v );
+  }
+  CHECK( i == 0 && ! ullint_prev( &c, &k ) );
+  for( i = 0; ullint_next_span( &c, &keys, &len ); i += len ) {
+    CHECK( len > 0 && ullint_get( &l, i, &v ) && keys[ 0 ] == v );
+    CHECK( ullint_get( &l, i + len - 1, &v ) && keys[ len - 1 ] == v );
+  }
+  CHECK( i == n );
+  // seek to the first element not before a key
+  CHECK( ullint_seek( &c, 5000 ) && ullint_next( &c, &k ) && k >= 5000 );
+  CHECK( ullint_rank( &l, 5000 ) == ullint_rank( &l, k ) );
+  CHECK( ullint_seek( &c, 5000 ) && ullint_prev( &c, &k ) && k < 5000 );
+  CHECK( ! ullint_seek( &c, 10000 ) && ullint_prev( &c, &k ) && ullint_get( &l, n - 1, &v ) && k == v );
+  CHECK( ull_seek_first( &c ) && ullint_next( &c, &k ) && ullint_get( &l, 0, &v ) && k == v );
+  // pointer lists hand out the stored element pointers
+  CHECK( ull_cursor_init( &c, &u ) && ull_seek( &c, (void*)&v ) );
+  CHECK( ull_next( &c, (void**)&e ) && *e >= v );
+  for( i = ull_rank( &u, (void*)e ) + 1; ull_next_span( &c, &span, &len ); i += len ) {
+    CHECK( ull_get( &u, i, (void**)&e ) && ((int**)span)[ 0 ] == e );
+  }
+  CHECK( i == n );
+  ull_remove_all( &u );
+  ullint_remove_all( &l );
+  free( values );
+}
+
+typedef struct {
+  ullint * l;
+  int max;
+  int stop;
+  int errors;
+  size_t lookups;
+}
+concurrent_test;
+
+// looks up random keys while the writer inserts and removes odd keys:
+// the multiples of 4 are in the list all the time, so the nearest element
+// is at most the multiples of 4 around the key away
+static void * concurrent_reader( void * arg )
+{
+  concurrent_test * t = (concurrent_test*)arg;
+  ullreader r;
+  unsigned int x = 12345;
+  if( ! ull_reader_init( &r, &(t->l->u) ) ) {
+    __atomic_add_fetch( &(t->errors), 1, __ATOMIC_RELAXED );
+    return 0;
+  }
+  while( ! __atomic_load_n( &(t->stop), __ATOMIC_ACQUIRE ) ) {
+    int key = 0, k = -1;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    key = (int)( x % (unsigned int)(t->max) );
+    if( ! ullint_read_nearest( &r, key & ~3, 1, &k ) || k != ( key & ~3 ) ) {
+      __atomic_add_fetch( &(t->errors), 1, __ATOMIC_RELAXED );
+    }
+    if( ! ullint_read_nearest( &r, key, 0, &k ) || k < ( key & ~3 ) || k > ( ( key + 3 ) & ~3 ) ) {
+      __atomic_add_fetch( &(t->errors), 1, __ATOMIC_RELAXED );
+    }
+    t->lookups ++;
+  }
+  ull_reader_release( &r );
+  return 0;
+}
+
+static void test_concurrent( void )
+{
+  ullint l;
+  dynmem d;
+  concurrent_test t;
+  pthread_t readers[ 3 ];
+  size_t n = 20000, i = 0, round = 0;
+  int * odd = malloc( n * sizeof(int) );
+  ullreader r;
+  int k = 0;
+  dynmem_init( &d, sizeof(void*) );
+  ullint_init( &l, &d );
+  CHECK( ! ull_reader_init( &r, &(l.u) ) );
+  CHECK( ull_set_concurrent( &(l.u), 1 ) );
+  for( i = 0; i <= n; i++ ) {
+    CHECK( ullint_insert( &l, (int)( 4 * i ) ) );
+  }
+  t.l = &l;
+  t.max = (int)( 4 * n );
+  t.stop = 0;
+  t.errors = 0;
+  t.lookups = 0;
+  for( i = 0; i < 3; i++ ) {
+    CHECK( pthread_create( &(readers[ i ]), 0, concurrent_reader, &t ) == 0 );
+  }
+  // the writer splits, merges and frees nodes while the readers run
+  srand( 9 );
+  for( round = 0; round < 6; round++ ) {
+    for( i = 0; i < n; i++ ) {
+      odd[ i ] = 2 * ( rand() % (int)( 2 * n ) ) + 1;
+    }
+    if( round % 2 ) {
+      CHECK( ullint_insert_batch( &l, odd, n ) );
+    }
+    else {
+      for( i = 0; i < n; i++ ) {
+        CHECK( ullint_insert( &l, odd[ i ] ) );
+      }
+    }
+    for( i = 0; i < n; i++ ) {
+      CHECK( ullint_remove( &l, odd[ i ] ) );
+    }
+  }
+  __atomic_store_n( &(t.stop), 1, __ATOMIC_RELEASE );
+  for( i = 0; i < 3; i++ ) {
+    pthread_join( readers[ i ], 0 );
+  }
+  CHECK( t.errors == 0 );
+  CHECK( check_list( &(l.u) ) == n + 1 );
+  // readers of a list that is empty, then refilled
+  CHECK( ull_reader_init( &r, &(l.u) ) );
+  CHECK( ullint_remove_range( &l, 0, (int)( 4 * n ) ) == n + 1 );
+  CHECK( ! ullint_read_nearest( &r, 5, 0, &k ) );
+  CHECK( ullint_insert_batch( &l, odd, n ) && check_list( &(l.u) ) == n );
+  CHECK( ullint_read_nearest( &r, odd[ 0 ], 1, &k ) && k == odd[ 0 ] );
+  ull_reader_release( &r );
+  CHECK( ull_set_concurrent( &(l.u), 0 ) );
+  ullint_remove_all( &l );
+  free( odd );
+}
+
+typedef struct {
+  ullshards * s;
+  int t;
+  volatile int stop;
+  int errors;
+}
+shards_test;
+
+// inserts the keys k < 16000 with k % 4 == t
+static void * shards_writer( void * arg )
+{
+  shards_test * t = (shards_test*)arg;
+  int32_t k = 0;
+  for( k = t->t; k < 16000; k += 4 ) {
+    if( ! ull_shards_insert( t->s, &k ) ) {
+      __atomic_add_fetch( &(t->errors), 1, __ATOMIC_RELAXED );
+    }
+  }
+  return 0;
+}
+
+// looks up the multiples of 4 (always present) until stopped
+static void * shards_reader( void * arg )
+{
+  shards_test * t = (shards_test*)arg;
+  ullshardsreader r;
+  int32_t k = 0, found = -1;
+  if( ! ull_shards_reader_init( &r, t->s ) ) {
+    __atomic_add_fetch( &(t->errors), 1, __ATOMIC_RELAXED );
+    return 0;
+  }
+  while( ! __atomic_load_n( &(t->stop), __ATOMIC_ACQUIRE ) ) {
+    k = ( k + 404 ) % 16000;
+    if( ! ull_shards_get_nearest( &r, &k, 1, &found ) || found != k ) {
+      __atomic_add_fetch( &(t->errors), 1, __ATOMIC_RELAXED );
+    }
+  }
+  ull_shards_reader_release( &r );
+  return 0;
+}
+
+static void test_shards( void )
+{
+  ullshards s;
+  ullshardsreader r;
+  shards_test t[ 4 ];
+  pthread_t threads[ 4 ];
+  int32_t splitters[ 3 ] = { 1000, 2000, 3000 };
+  int32_t k = 0, found = 0;
+  size_t i = 0, total = 0;
+  CHECK( ! ull_shards_init_keys( &s, ull_keyops_i32(), ULL_SHARDS_MAX + 1, splitters ) );
+  CHECK( ull_shards_init_keys( &s, ull_keyops_i32(), 4, splitters ) );
+  for( k = 0; k < 16000; k += 4 ) {
+    CHECK( ull_shards_insert( &s, &k ) );
+  }
+  // three writers and a reader at once, most keys go to the last shard
+  for( i = 0; i < 4; i++ ) {
+    t[ i ].s = &s;
+    t[ i ].t = (int)i;
+    t[ i ].stop = 0;
+    t[ i ].errors = 0;
+    CHECK( pthread_create( &(threads[ i ]), 0, ( i ? shards_writer : shards_reader ), &(t[ i ]) ) == 0 );
+  }
+  for( i = 1; i < 4; i++ ) {
+    pthread_join( threads[ i ], 0 );
+  }
+  __atomic_store_n( &(t[ 0 ].stop), 1, __ATOMIC_RELEASE );
+  pthread_join( threads[ 0 ], 0 );
+  for( i = 0; i < 4; i++ ) {
+    CHECK( t[ i ].errors == 0 );
+  }
+  CHECK( ull_shards_size( &s ) == 16000 );
+  // each shard is a valid list within its range and the hot shard gave elements away
+  for( i = 0; i < 4; i++ ) {
+    ull * u = &(s.shards[ i ]->u);
+    total += check_list( u );
+    void * first = 0, * last = 0;
+    if( ull_get( u, 0, &first ) && ull_get( u, ull_size( u ) - 1, &last ) ) {
+      CHECK( i == 0 || *((int32_t*)first) >= ((int32_t*)s.splitters)[ i - 1 ] );
+      CHECK( i == 3 || *((int32_t*)last) < ((int32_t*)s.splitters)[ i ] );
+    }
+  }
+  CHECK( total == 16000 );
+  CHECK( ull_size( &(s.shards[ 3 ]->u) ) < 13000 );
+  CHECK( ull_shards_reader_init( &r, &s ) );
+  for( k = 0; k < 16000; k++ ) {
+    if( ! ull_shards_get_nearest( &r, &k, 1, &found ) || found != k ) {
+      break;
+    }
+  }
+  CHECK( k == 16000 );
+  k = 20000;
+  CHECK( ull_shards_get_nearest( &r, &k, 0, &found ) && found == 15999 );
+  ull_shards_reader_release( &r );
+  ull_shards_free( &s );
+  // nearest across empty shards
+  CHECK( ull_shards_init_keys( &s, ull_keyops_i32(), 4, splitters ) );
+  CHECK( ull_shards_reader_init( &r, &s ) );
+  k = 1500;
+  CHECK( ! ull_shards_get_nearest( &r, &k, 0, &found ) );
+  k = 50;
+  CHECK( ull_shards_insert( &s, &k ) );
+  k = 3500;
+  CHECK( ull_shards_insert( &s, &k ) );
+  k = 1500;
+  CHECK( ull_shards_get_nearest( &r, &k, 0, &found ) && found == 3500 );
+  CHECK( ! ull_shards_get_nearest( &r, &k, 1, &found ) );
+  k = 0;
+  CHECK( ull_shards_get_nearest( &r, &k, 0, &found ) && found == 50 );
+  k = 4000;
+  CHECK( ull_shards_get_nearest( &r, &k, 0, &found ) && found == 3500 );
+  CHECK( ull_shards_remove( &s, &k ) == 0 );
+  k = 3500;
+  CHECK( ull_shards_remove( &s, &k ) && ull_shards_size( &s ) == 1 );
+  k = 4000;
+  CHECK( ull_shards_get_nearest( &r, &k, 0, &found ) && found == 50 );
+  ull_shards_reader_release( &r );
+  ull_shards_free( &s );
+}
+
+static void test_finger( void )
+{
+  ullint l;
+  dynmem d;
+  ullfinger f;
+  int n = 20000, k = 0, a = 0, b = 0, errors = 0;
+  size_t i = 0;
+  dynmem_init( &d, sizeof(void*) );
+  ullint_init( &l, &d );
+  ull_finger_init( &f );
+  CHECK( ! ullint_get_nearest_hint( &l, 5, 0, &a, &f ) );
+  // ascending inserts start at the node of the previous insert
+  for( k = 0; k < 2 * n; k += 2 ) {
+    CHECK( ullint_insert_hint( &l, k, &f ) );
+  }
+  CHECK( check_list( &(l.u) ) == (size_t)n );
+  // forward, backward and random lookups agree with ull_get_nearest()
+  for( k = -1; k <= 2 * n; k++ ) {
+    errors += ( ullint_get_nearest_hint( &l, k, 0, &a, &f ) != ullint_get_nearest( &l, k, 0, &b ) || a != b );
+    errors += ( ullint_get_nearest_hint( &l, k, 1, &a, &f ) != ( k >= 0 && k % 2 == 0 && k < 2 * n ) );
+  }
+  for( k = 2 * n; k >= -1; k-- ) {
+    errors += ( ullint_get_nearest_hint( &l, k, 0, &a, 0 ) != ullint_get_nearest( &l, k, 0, &b ) || a != b );
+  }
+  srand( 13 );
+  for( i = 0; i < 10000; i++ ) {
+    k = rand() % ( 2 * n );
+    errors += ( ullint_get_nearest_hint( &l, k, 0, &a, &f ) != ullint_get_nearest( &l, k, 0, &b ) || a != b );
+  }
+  CHECK( errors == 0 );
+  // removed nodes invalidate fingers
+  CHECK( ullint_get_nearest_hint( &l, 2 * n - 2, 1, &a, &f ) && a == 2 * n - 2 );
+  CHECK( ullint_remove_range( &l, n, 2 * n ) == (size_t)( n / 2 ) );
+  CHECK( f.gen != l.u.node_gen );
+  CHECK( ullint_get_nearest_hint( &l, 2 * n - 2, 0, &a, &f ) && a == n - 2 );
+  for( i = 0; i < 10000; i++ ) {
+    CHECK( ullint_insert_hint( &l, rand() % ( 2 * n ), ( i % 2 ? &f : 0 ) ) );
+  }
+  CHECK( check_list( &(l.u) ) == (size_t)( n / 2 + 10000 ) );
+  ullint_remove_all( &l );
+}
+
+static void test_multiset( void )
+{
+  ullint l;
+  dynmem d;
+  size_t counts[ 100 ] = { 0 };
+  size_t i = 0, errors = 0;
+  int k = 0;
+  dynmem_init( &d, sizeof(void*) );
+  ullint_init( &l, &d );
+  CHECK( ull_set_multiset( &(l.u), 1 ) );
+  srand( 19 );
+  for( i = 0; i < 200000; i++ ) {
+    k = ( rand() % 100 ) * 7;
+    counts[ k / 7 ] ++;
+    CHECK( ullint_insert( &l, k ) );
+  }
+  // one run per distinct key
+  CHECK( ullint_size( &l ) == 100 && check_list( &(l.u) ) == 100 && l.u.num_nodes <= 10 );
+  for( k = 0; k < 700; k++ ) {
+    errors += ( ullint_count( &l, k ) != ( k % 7 ? 0 : counts[ k / 7 ] ) );
+  }
+  CHECK( errors == 0 );
+  // removals take one off the count, the key goes with its last one
+  for( i = 0; i < counts[ 3 ]; i++ ) {
+    CHECK( ullint_remove( &l, 21 ) );
+    errors += ( ullint_count( &l, 21 ) != counts[ 3 ] - i - 1 );
+  }
+  CHECK( errors == 0 && ! ullint_remove( &l, 21 ) && ullint_size( &l ) == 99 );
+  CHECK( ullint_remove_range( &l, 0, 69 ) == 9 && ullint_count( &l, 70 ) == counts[ 10 ] );
+  CHECK( ullint_insert_hint( &l, 70, 0 ) && ullint_count( &l, 70 ) == counts[ 10 ] + 1 );
+  CHECK( ! ull_set_multiset( &(l.u), 0 ) );
+  ullint_remove_all( &l );
+  CHECK( ull_set_multiset( &(l.u), 0 ) );
+  // other lists count equal elements (here across several nodes)
+  for( i = 0; i < 1000; i++ ) {
+    CHECK( ullint_insert( &l, (int)( i % 10 == 0 ? 5 : i ) ) );
+  }
+  CHECK( ullint_count( &l, 5 ) == 101 && ullint_count( &l, 6 ) == 1 && ullint_count( &l, 10 ) == 0 );
+  ullint_remove_all( &l );
+}
+
+static void test_split_merge( void )
+{
+  static size_t counts[ 10000 ];
+  ullint l, r, a, b, m;
+  ullmap ma, mb, mm;
+  dynmem dl, dr, da, db, dm, dma, dmb, dmm;
+  payload v;
+  ullnode * tail = 0;
+  size_t i = 0, errors = 0, before = 0, memory = 0;
+  ullstats st, str;
+  int k = 0;
+  dynmem_init( &dl, sizeof(void*) );
+  ullint_init( &l, &dl );
+  dynmem_init( &dr, sizeof(void*) );
+  ullint_init( &r, &dr );
+  dynmem_init( &da, sizeof(void*) );
+  ullint_init( &a, &da );
+  srand( 31 );
+  for( i = 0; i < 50000; i++ ) {
+    k = rand() % 10000;
+    counts[ k ] ++;
+    CHECK( ullint_insert( &l, k ) );
+  }
+  // elements not before the key (all copies of it) move over, only one node is cut
+  CHECK( ullint_split_at( &l, 5000, &r ) );
+  CHECK( check_list( &(l.u) ) + check_list( &(r.u) ) == 50000 );
+  CHECK( ullint_get_nearest( &l, 10000, 0, &k ) && k < 5000 && ullint_count( &r, 5000 ) == counts[ 5000 ] );
+  CHECK( ullint_get( &r, 0, &k ) && k >= 5000 );
+  CHECK( ! ullint_split_at( &l, 100, &r ) && ! ullint_concat( &r, &l ) );
+  CHECK( ullint_concat( &l, &r ) && ullint_size( &r ) == 0 && check_list( &(l.u) ) == 50000 );
+  for( k = 0; k < 10000; k++ ) {
+    errors += ( ullint_count( &l, k ) != counts[ k ] );
+  }
+  CHECK( errors == 0 );
+  // splits before the first and after the last element
+  CHECK( ullint_split_at( &l, 10000, &r ) && ullint_size( &r ) == 0 );
+  CHECK( ullint_split_at( &l, -1, &r ) && ullint_size( &l ) == 0 && check_list( &(r.u) ) == 50000 );
+  CHECK( ullint_concat( &l, &r ) && check_list( &(l.u) ) == 50000 );
+  // the nodes move as they are: right holds the slabs of the split list as well,
+  // concat takes over the slabs of right
+  tail = l.u.tail;
+  CHECK( ullint_split_at( &l, 2000, &r ) && r.u.tail == tail && ullint_split_at( &r, 7000, &a ) );
+  CHECK( a.u.tail == tail && check_list( &(l.u) ) + check_list( &(r.u) ) + check_list( &(a.u) ) == 50000 );
+  CHECK( ullint_concat( &r, &a ) && ullint_concat( &l, &r ) && l.u.tail == tail && check_list( &(l.u) ) == 50000 );
+  // lists with other node sizes get copies
+  CHECK( ull_set_node_capacity( &(r.u), 2 * ULL_ELEMENTS_PER_NODE ) && ullint_split_at( &l, 5000, &r ) && r.u.tail != tail );
+  CHECK( ullint_concat( &l, &r ) && check_list( &(l.u) ) == 50000 && ull_set_node_capacity( &(r.u), ULL_ELEMENTS_PER_NODE ) );
+  for( k = 0; k < 10000; k++ ) {
+    errors += ( ullint_count( &l, k ) != counts[ k ] );
+  }
+  CHECK( errors == 0 );
+  // merging two lists in one pass
+  dynmem_init( &db, sizeof(void*) );
+  ullint_init( &b, &db );
+  dynmem_init( &dm, sizeof(void*) );
+  ullint_init( &m, &dm );
+  CHECK( ullint_split_at( &l, 3000, &a ) && ullint_merge( &l, &a, &m ) && check_list( &(m.u) ) == 50000 );
+  CHECK( ! ullint_merge( &l, &a, &m ) );
+  ullint_remove_all( &m );
+  for( i = 0; i < 20000; i++ ) {
+    k = rand() % 10000;
+    counts[ k ] ++;
+    CHECK( ullint_insert( &b, k ) );
+  }
+  CHECK( ullint_concat( &l, &a ) && ullint_merge( &l, &b, &m ) && check_list( &(m.u) ) == 70000 );
+  CHECK( ullint_size( &l ) == 50000 && ullint_size( &b ) == 20000 );
+  for( k = 0; k < 10000; k++ ) {
+    errors += ( ullint_count( &m, k ) != counts[ k ] );
+  }
+  CHECK( errors == 0 );
+  // multisets add the counts of equal elements
+  ullint_remove_all( &a );
+  ullint_remove_all( &m );
+  CHECK( ull_set_multiset( &(a.u), 1 ) && ull_set_multiset( &(m.u), 1 ) );
+  ullint_remove_all( &b );
+  CHECK( ull_set_multiset( &(b.u), 1 ) );
+  for( i = 0; i < 1000; i++ ) {
+    CHECK( ullint_insert( &a, (int)( i % 100 ) ) && ullint_insert( &b, (int)( i % 150 ) ) );
+  }
+  CHECK( ! ullint_merge( &l, &b, &m ) && ullint_merge( &a, &b, &m ) && ullint_size( &m ) == 150 );
+  CHECK( ullint_count( &m, 50 ) == 10 + 7 && ullint_count( &m, 120 ) == 6 );
+  // and concat adds the counts of the element at the border
+  ullint_remove_all( &m );
+  CHECK( ullint_split_at( &b, 100, &m ) && ullint_insert( &b, 100 ) && ullint_concat( &b, &m ) );
+  CHECK( ullint_size( &b ) == 150 && ullint_count( &b, 100 ) == 1 + 6 && check_list( &(b.u) ) == 150 );
+  // map lists keep the values of the second one
+  dynmem_init( &dma, sizeof(void*) );
+  ullmap_init( &ma, &dma );
+  dynmem_init( &dmb, sizeof(void*) );
+  ullmap_init( &mb, &dmb );
+  dynmem_init( &dmm, sizeof(void*) );
+  ullmap_init( &mm, &dmm );
+  for( k = 0; k < 1000; k++ ) {
+    v.twice = 2 * k;
+    v.version = 1;
+    CHECK( ullmap_upsert( &ma, k, v ) );
+    v.version = 2;
+    CHECK( k % 3 || ullmap_upsert( &mb, k, v ) );
+  }
+  CHECK( ull_merge( &(ma.u), &(mb.u), &(mm.u) ) && ullmap_size( &mm ) == 1000 && check_list( &(mm.u) ) == 1000 );
+  for( k = 0; k < 1000; k++ ) {
+    errors += ( ! ullmap_find( &mm, k, &v ) || v.twice != 2 * k || v.version != ( k % 3 ? 1 : 2 ) );
+  }
+  CHECK( errors == 0 && ullmap_remove( &mm, 999 ) && ! ullmap_find( &mm, 999, &v ) );
+  // the parts of a split list outlive each other, the slabs they share count half for each
+  CHECK( ull_stats_get( &(l.u), &st ) );
+  memory = st.memory;
+  CHECK( ullint_split_at( &l, 5000, &r ) && ull_stats_get( &(l.u), &st ) && ull_stats_get( &(r.u), &str ) );
+  CHECK( st.memory + str.memory < memory + memory / 2 );
+  memory = str.memory;
+  before = ullint_size( &r );
+  ullint_remove_all( &l );
+  CHECK( ull_stats_get( &(r.u), &str ) && str.memory > memory );
+  for( k = 0; k < 5000; k++ ) {
+    CHECK( ullint_insert( &r, k ) );
+    before -= (size_t)ullint_remove( &r, 5000 + k );
+  }
+  CHECK( check_list( &(r.u) ) == before + 5000 && ullint_concat( &l, &r ) && check_list( &(l.u) ) == before + 5000 );
+  ullint_remove_all( &l );
+  ullint_remove_all( &a );
+  ullint_remove_all( &b );
+  ullint_remove_all( &m );
+  ullmap_remove_all( &ma );
+  ullmap_remove_all( &mb );
+  ullmap_remove_all( &mm );
+}
+
+// count, sum, min and max of int keys (multisets count every key with its count)
+typedef struct { int64_t count; int64_t sum; int min; int max; } intstats;
+
+static void intstats_lift( ull * u, void * state, const void * key, const void * value )
+{
+  intstats * s = (intstats*)state;
+  s->min = s->max = *((const int*)key);
+  s->count = ( value ? (int64_t)*((const uint64_t*)value) : 1 );
+  s->sum = s->count * s->min;
+}
+
+static void intstats_combine( ull * u, void * state, const void * next )
+{
+  intstats * s = (intstats*)state;
+  const intstats * t = (const intstats*)next;
+  s->count += t->count;
+  s->sum += t->sum;
+  s->min = ( t->min < s->min ? t->min : s->min );
+  s->max = ( t->max > s->max ? t->max : s->max );
+}
+
+static const ullaggregate intstats_aggregate = { sizeof(intstats), intstats_lift, intstats_combine };
+
+// checks the aggregate of a range against the counts of the keys 0 .. 9999
+static size_t check_range_aggregate( ullint * l, const size_t * counts, int lo, int hi )
+{
+  intstats want = { 0, 0, 0, 0 }, got = { 0, 0, 0, 0 };
+  int k = 0;
+  for( k = lo; k <= hi; k++ ) {
+    if( counts[ k ] && ! want.count ) {
+      want.min = k;
+    }
+    want.count += counts[ k ];
+    want.sum += (int64_t)counts[ k ] * k;
+    want.max = ( counts[ k ] ? k : want.max );
+  }
+  if( ! ullint_range_aggregate( l, lo, hi, &got ) ) {
+    return ( want.count != 0 );
+  }
+  return ( got.count != want.count || got.sum != want.sum || got.min != want.min || got.max != want.max );
+}
+
+static void test_aggregate( void )
+{
+  static size_t counts[ 10000 ];
+  static int batch[ 1000 ];
+  static const ullaggregate too_big = { ULL_AGGREGATE_MAX_STATE + 1, intstats_lift, intstats_combine };
+  ullint l, r;
+  dynmem d, dr;
+  intstats all = { 0, 0, 0, 0 };
+  size_t i = 0, errors = 0;
+  int k = 0, lo = 0;
+  dynmem_init( &d, sizeof(void*) );
+  ullint_init( &l, &d );
+  CHECK( ! ull_set_aggregate( &(l.u), &too_big ) && ull_set_aggregate( &(l.u), &intstats_aggregate ) );
+  CHECK( ! ullint_range_aggregate( &l, 0, 9999, &all ) );
+  // inserts, removals and range removals keep the aggregates of nodes and index nodes
+  srand( 29 );
+  for( i = 0; i < 50000; i++ ) {
+    k = rand() % 10000;
+    counts[ k ] ++;
+    CHECK( ullint_insert( &l, k ) );
+  }
+  for( i = 0; i < 20000; i++ ) {
+    k = rand() % 10000;
+    errors += ( ullint_remove( &l, k ) != ( counts[ k ] > 0 ) );
+    counts[ k ] -= ( counts[ k ] > 0 );
+  }
+  CHECK( errors == 0 );
+  ullint_remove_range( &l, 1000, 1999 );
+  memset( counts + 1000, 0, 1000 * sizeof(size_t) );
+  CHECK( ! ullint_range_aggregate( &l, 1500, 1600, &all ) && ! ullint_range_aggregate( &l, 5, 4, &all ) );
+  for( i = 0; i < 1000; i++ ) {
+    batch[ i ] = rand() % 10000;
+    counts[ batch[ i ] ] ++;
+  }
+  CHECK( ullint_insert_batch( &l, batch, 1000 ) );
+  CHECK( ullint_range_aggregate( &l, 0, 9999, &all ) && all.count == (int64_t)ullint_size( &l ) );
+  for( i = 0; i < 300; i++ ) {
+    lo = rand() % 10000;
+    errors += check_range_aggregate( &l, counts, lo, lo + rand() % ( 10000 - lo ) );
+  }
+  CHECK( errors == 0 );
+  CHECK( ! ull_set_aggregate( &(l.u), 0 ) && ! ull_save( &(l.u), "test_aggregate.ull" ) );
+  // split and concat recompute the index nodes along the cut and the join
+  dynmem_init( &dr, sizeof(void*) );
+  ullint_init( &r, &dr );
+  CHECK( ull_set_aggregate( &(r.u), &intstats_aggregate ) && ullint_split_at( &l, 6000, &r ) );
+  for( i = 0; i < 100; i++ ) {
+    lo = rand() % 6000;
+    errors += check_range_aggregate( &l, counts, lo, lo + rand() % ( 6000 - lo ) );
+    lo = 6000 + rand() % 4000;
+    errors += check_range_aggregate( &r, counts, lo, lo + rand() % ( 10000 - lo ) );
+  }
+  CHECK( ullint_concat( &l, &r ) );
+  for( i = 0; i < 100; i++ ) {
+    lo = rand() % 10000;
+    errors += check_range_aggregate( &l, counts, lo, lo + rand() % ( 10000 - lo ) );
+  }
+  CHECK( errors == 0 );
+  // bulk loads
+  for( i = 0; i < 1000; i++ ) {
+    batch[ i ] = (int)i * 10;
+  }
+  memset( counts, 0, sizeof(counts) );
+  for( i = 0; i < 1000; i++ ) {
+    counts[ batch[ i ] ] = 1;
+  }
+  CHECK( ullint_build_from_sorted( &l, batch, 1000, 0.7 ) );
+  for( i = 0; i < 100; i++ ) {
+    lo = rand() % 10000;
+    errors += check_range_aggregate( &l, counts, lo, lo + rand() % ( 10000 - lo ) );
+  }
+  CHECK( errors == 0 );
+  // multisets lift keys with their counts
+  ullint_remove_all( &l );
+  CHECK( ull_set_multiset( &(l.u), 1 ) );
+  memset( counts, 0, sizeof(counts) );
+  for( i = 0; i < 20000; i++ ) {
+    k = rand() % 500;
+    counts[ k ] ++;
+    CHECK( ullint_insert( &l, k ) );
+  }
+  for( i = 0; i < 100; i++ ) {
+    lo = rand() % 500;
+    errors += check_range_aggregate( &l, counts, lo, lo + rand() % ( 500 - lo ) );
+  }
+  CHECK( errors == 0 );
+  ullint_remove_all( &l );
+}
+
+static size_t strcmp_calls = 0;
+
+static int cmp_str( void * a, void * b )
+{
+  strcmp_calls ++;
+  return strcmp( (const char *)a, (const char *)b );
+}
+
+static void test_abbrev( void )
+{
+  static char strs[ 20000 ][ 16 ];
+  static char sorted[ 100 ][ 8 ];
+  ullabbrevkey keys[ 100 ];
+  ull u;
+  dynmem d;
+  ullcursor c;
+  void * e = 0, * prev = 0;
+  size_t i = 0, n = 20000, errors = 0, shared = 0, distinct = 0;
+  CHECK( ull_abbrev_str( "ab" ) < ull_abbrev_str( "abc" ) && ull_abbrev_str( "abc" ) < ull_abbrev_str( "abd" ) );
+  CHECK( ull_abbrev_str( "abcdefgh1" ) == ull_abbrev_str( "abcdefgh2" ) );
+  dynmem_init( &d, sizeof(void*) );
+  CHECK( ! ull_init_abbrev( &u, &d, cmp_str, 0 ) );
+  CHECK( ull_init_abbrev( &u, &d, cmp_str, ull_abbrev_str ) );
+  // even strings share their first 8 bytes, odd ones (mostly) differ in them
+  srand( 23 );
+  for( i = 0; i < n; i++ ) {
+    snprintf( strs[ i ], 16, ( i % 2 ? "%07d" : "longpref%05d" ), rand() % 100000 );
+    CHECK( ull_insert( &u, strs[ i ] ) );
+  }
+  CHECK( ull_size( &u ) == n );
+  ull_cursor_init( &c, &u );
+  ull_seek_first( &c );
+  for( i = 0; ull_next( &c, &e ); i++ ) {
+    errors += ( prev && strcmp( (char *)prev, (char *)e ) > 0 );
+    prev = e;
+  }
+  CHECK( errors == 0 && i == n );
+  // the cmpfunc is only called when the abbreviations are equal
+  for( i = 0; i < n; i++ ) {
+    strcmp_calls = 0;
+    errors += ( ! ull_get_nearest( &u, strs[ i ], 1, &e ) || strcmp( (char *)e, strs[ i ] ) != 0 );
+    *( i % 2 ? &distinct : &shared ) += strcmp_calls;
+  }
+  CHECK( errors == 0 && distinct * 4 < shared );
+  for( i = 1; i < n; i += 2 ) {
+    CHECK( ull_remove( &u, strs[ i ] ) );
+  }
+  CHECK( ull_size( &u ) == n / 2 && ! ull_get_nearest( &u, "0", 1, &e ) );
+  // bulk loads only need the element pointers
+  for( i = 0; i < 100; i++ ) {
+    snprintf( sorted[ i ], 8, "k%03d", (int)i );
+    keys[ i ].elem = sorted[ i ];
+    keys[ i ].abbrev = 0;
+  }
+  CHECK( ull_build_from_sorted( &u, keys, 100, 0.5 ) && ull_size( &u ) == 100 );
+  CHECK( ull_get_nearest( &u, "k050", 1, &e ) && e == sorted[ 50 ] );
+  CHECK( ull_get_nearest( &u, "k0505", 0, &e ) && e == sorted[ 51 ] );
+  CHECK( ull_insert_batch( &u, keys, 10 ) && ull_size( &u ) == 110 );
+  CHECK( ((ullabbrevkey *)ULL_NODE_KEY( &u, u.root, 0 ))->abbrev == ull_abbrev_str( "k000" ) );
+  ull_remove_all( &u );
+}
+
+// packed nodes: the same answers as a plain list in a fraction of the memory
+static void test_packed_nodes( void )
+{
+  ulli64 l, pl;
+  ullint li;
+  dynmem d, dp, di;
+  ullcursor c, cp;
+  ullstats st, stp;
+  size_t n = 50000, i = 0, len = 0, errors = 0;
+  int64_t * keys = malloc( n * sizeof(int64_t) );
+  int64_t k = 0, x = 0, y = 0;
+  void * p = 0;
+  srand( 21 );
+  dynmem_init( &d, sizeof(void*) );
+  ulli64_init( &l, &d );
+  dynmem_init( &dp, sizeof(void*) );
+  ulli64_init( &pl, &dp );
+  dynmem_init( &di, sizeof(void*) );
+  ullint_init( &li, &di );
+  CHECK( ull_set_node_capacity( &(l.u), 256 ) && ull_set_node_capacity( &(pl.u), 256 ) );
+  CHECK( ull_set_packed( &(pl.u), 1 ) && pl.u.node_size * 3 < l.u.node_size );
+  // only for empty lists of 32/64 bit integers, without multisets, aggregates and concurrent mode
+  CHECK( ! ull_set_packed( &(li.u), 1 ) );
+  CHECK( ! ull_set_node_capacity( &(pl.u), ULL_PACKED_MAX_CAPACITY + 1 ) );
+  CHECK( ! ull_set_multiset( &(pl.u), 1 ) && ! ull_set_aggregate( &(pl.u), &intstats_aggregate ) );
+  CHECK( ! ull_set_concurrent( &(pl.u), 1 ) );
+  // clustered ids (timestamps) and some outliers
+  for( i = 0; i < n; i++ ) {
+    int64_t v = ( i % 500 == 0 ? ( (int64_t)rand() - RAND_MAX / 2 ) * 1000003 :
+      1000000000 + (int64_t)( i / 1000 ) * 100000 + rand() % 5000 );
+    CHECK( ulli64_insert( &l, v ) && ulli64_insert( &pl, v ) );
+  }
+  CHECK( check_list( &(pl.u) ) == n && ! ull_set_packed( &(pl.u), 0 ) );
+  CHECK( ull_stats_get( &(l.u), &st ) && ull_stats_get( &(pl.u), &stp ) && stp.memory * 2 < st.memory );
+  CHECK( pl.u.num_nodes * pl.u.node_size * 3 < l.u.num_nodes * l.u.node_size );
+  for( i = 0; i < n; i += 7 ) {
+    errors += ( ! ulli64_get( &l, i, &k ) || ! ulli64_get( &pl, i, &x ) || k != x );
+    errors += ( ulli64_rank( &pl, k ) != ulli64_rank( &l, k ) || ulli64_count( &pl, k ) != ulli64_count( &l, k ) );
+    // (the first key not before k + 1 or the last key of its node if there is none in it)
+    errors += ( ! ulli64_get_nearest( &pl, k + 1, 0, &x ) ||
+      ! ulli64_get( &l, ulli64_rank( &l, k + 1 ) - ( x <= k ? 1 : 0 ), &y ) || x != y );
+    errors += ( ulli64_get_nearest( &pl, k + 1, 1, &x ) != ulli64_get_nearest( &l, k + 1, 1, &y ) );
+  }
+  CHECK( errors == 0 );
+  // cursors in both directions
+  ulli64_cursor_init( &c, &l );
+  ulli64_cursor_init( &cp, &pl );
+  CHECK( ulli64_seek( &c, 1000500000 ) && ulli64_seek( &cp, 1000500000 ) );
+  for( i = 0; i < 3000; i++ ) {
+    errors += ( ! ulli64_next( &c, &k ) || ! ulli64_next( &cp, &x ) || k != x );
+  }
+  for( i = 0; i < 5000; i++ ) {
+    errors += ( ! ulli64_prev( &c, &k ) || ! ulli64_prev( &cp, &x ) || k != x );
+  }
+  CHECK( errors == 0 );
+  // the nodes hold no keys to point to
+  CHECK( ! ull_get( &(pl.u), 0, &p ) && ! ull_get_nearest( &(pl.u), &k, 0, &p ) );
+  CHECK( ! ull_next( &cp, &p ) && ! ull_prev( &cp, &p ) && ! ull_next_span( &cp, &p, &len ) );
+  CHECK( ! ull_save( &(pl.u), "/tmp/ull_test_packed.ull" ) );
+  // removals (merging nodes) and range removals
+  for( i = 0; i < n; i += 2 ) {
+    CHECK( ulli64_get( &l, i / 2, &k ) && ulli64_remove( &l, k ) && ulli64_remove( &pl, k ) );
+  }
+  CHECK( ulli64_remove_range( &l, 1001000000, 1002000000 ) == ulli64_remove_range( &pl, 1001000000, 1002000000 ) );
+  CHECK( ! ulli64_remove( &pl, 1001500000 ) && check_list( &(pl.u) ) == ulli64_size( &l ) );
+  for( i = 0; i < ulli64_size( &l ); i++ ) {
+    errors += ( ! ulli64_get( &l, i, &k ) || ! ulli64_get( &pl, i, &x ) || k != x );
+  }
+  CHECK( errors == 0 );
+  // batches and building from sorted keys
+  len = ulli64_size( &l );
+  for( i = 0; i < len; i++ ) {
+    ulli64_get( &l, i, keys + i );
+  }
+  CHECK( ulli64_insert_batch( &pl, keys, 100 ) && check_list( &(pl.u) ) == len + 100 );
+  CHECK( ulli64_build_from_sorted( &pl, keys, len, 1.0 ) && check_list( &(pl.u) ) == len );
+  for( i = 0; i < len; i++ ) {
+    errors += ( ! ulli64_get( &pl, i, &x ) || x != keys[ i ] );
+  }
+  CHECK( errors == 0 );
+  CHECK( ulli64_remove_all( &pl ) && ull_set_packed( &(pl.u), 0 ) && ulli64_insert( &pl, 1 ) );
+  CHECK( ull_get( &(pl.u), 0, &p ) && *((int64_t*)p) == 1 );
+  ulli64_remove_all( &l );
+  ulli64_remove_all( &pl );
+  ullint_remove_all( &li );
+  free( keys );
+}
+
+static void test_map( void )
+{
+  ullmap l;
+  dynmem d;
+  payload v;
+  int * versions = calloc( 100000, sizeof(int) );
+  size_t i = 0, errors = 0, distinct = 0;
+  int k = 0, key = 0;
+  void * pk = 0, * pv = 0;
+  dynmem_init( &d, sizeof(void*) );
+  CHECK( ullmap_init( &l, &d ) );
+  CHECK( ! ullmap_find( &l, 1, &v ) && ! ullmap_get_nearest( &l, 1, 0, &k, &v ) );
+  // random upserts (adds and updates), values follow their keys through splits
+  srand( 18 );
+  for( i = 0; i < 300000; i++ ) {
+    key = rand() % 100000;
+    distinct += ( versions[ key ] == 0 );
+    versions[ key ] ++;
+    v.twice = 2 * (int64_t)key;
+    v.version = versions[ key ];
+    CHECK( ullmap_upsert( &l, key, v ) );
+  }
+  CHECK( ullmap_size( &l ) == distinct && check_list( &(l.u) ) == distinct );
+  for( key = 0; key < 100000; key++ ) {
+    if( versions[ key ] ) {
+      errors += ( ! ullmap_find( &l, key, &v ) || v.twice != 2 * (int64_t)key || v.version != versions[ key ] );
+    }
+    else {
+      errors += ullmap_find( &l, key, &v );
+    }
+  }
+  CHECK( errors == 0 );
+  // removals (with merges) keep the values of the other keys, the nearest key comes with its value
+  for( key = 0; key < 100000; key += 3 ) {
+    if( versions[ key ] ) {
+      CHECK( ullmap_remove( &l, key ) );
+      versions[ key ] = 0;
+    }
+  }
+  for( key = 0; key < 100000; key++ ) {
+    if( ullmap_get_nearest( &l, key, 0, &k, &v ) ) {
+      errors += ( versions[ k ] == 0 || v.twice != 2 * (int64_t)k || v.version != versions[ k ] );
+    }
+  }
+  CHECK( errors == 0 );
+  // the value can be updated in place
+  CHECK( ull_find( &(l.u), &k, &pv ) );
+  ((payload*)pv)->version = -1;
+  CHECK( ullmap_find( &l, k, &v ) && v.version == -1 );
+  CHECK( ull_get_nearest_value( &(l.u), &k, 1, &pk, &pv ) && *((int*)pk) == k );
+  // map lists insert with ull_upsert() only
+  CHECK( ! ull_insert( &(l.u), &k ) && ! ull_insert_batch( &(l.u), &k, 1 ) );
+  CHECK( ullmap_remove_all( &l ) && ullmap_size( &l ) == 0 );
+  // ascending upserts
+  for( key = 0; key < 50000; key++ ) {
+    v.twice = 2 * (int64_t)key;
+    v.version = 1;
+    CHECK( ullmap_upsert( &l, key, v ) );
+  }
+  for( key = 0; key < 50000; key++ ) {
+    errors += ( ! ullmap_find( &l, key, &v ) || v.twice != 2 * (int64_t)key );
+  }
+  CHECK( errors == 0 && check_list( &(l.u) ) == 50000 );
+  ullmap_remove_all( &l );
+  free( versions );
+}
+
+static void test_append( void )
+{
+  ullint l;
+  dynmem d;
+  ullnode * n = 0;
+  size_t i = 0, n_keys = 100000, full = 0;
+  int k = 0;
+  dynmem_init( &d, sizeof(void*) );
+  ullint_init( &l, &d );
+  CHECK( ! ull_set_split_policy( &(l.u), 0.0, 0.5, 1 ) && ! ull_set_split_policy( &(l.u), 0.9, 1.0, 1 ) );
+  // monotonic keys (with duplicates) leave every node but the last one at the max fill
+  for( i = 0; i < n_keys; i++ ) {
+    CHECK( ullint_insert( &l, (int)( i / 3 ) ) );
+  }
+  CHECK( check_list( &(l.u) ) == n_keys );
+  for( n = l.u.root; n; n = n->next ) {
+    full += ( n->num_elements == _ull_max_fill( &(l.u) ) );
+  }
+  CHECK( full >= l.u.num_nodes - 1 );
+  // inserts in the middle still split by the ratio
+  CHECK( ullint_get_nearest( &l, 500, 1, &k ) && k == 500 );
+  for( i = 0; i < 1000; i++ ) {
+    CHECK( ullint_insert( &l, 500 ) );
+  }
+  CHECK( check_list( &(l.u) ) == n_keys + 1000 );
+  ullint_remove_all( &l );
+  // a higher fill and asymmetric splits
+  CHECK( ull_set_split_policy( &(l.u), 1.0, 0.75, 0 ) );
+  CHECK( _ull_max_fill( &(l.u) ) == l.u.capacity - 1 );
+  srand( 14 );
+  for( i = 0; i < n_keys; i++ ) {
+    CHECK( ullint_insert( &l, ( i % 2 ? (int)i : rand() ) ) );
+  }
+  CHECK( check_list( &(l.u) ) == n_keys );
+  for( i = 0; i < n_keys; i += 2 ) {
+    CHECK( ullint_remove( &l, (int)( i + 1 ) ) );
+  }
+  CHECK( check_list( &(l.u) ) == n_keys / 2 );
+  ullint_remove_all( &l );
+  CHECK( l.u.tail == 0 );
+}
+
+static void test_save( void )
+{
+  ullint l, m, m2;
+  ull u;
+  dynmem d, dm, dm2, du;
+  ullcursor c;
+  size_t n = 200000, i = 0, errors = 0;
+  int k = 0, a = 0, b = 0, fd = -1;
+  const char * path = "test_save.ull";
+  FILE * f = 0;
+  dynmem_init( &d, sizeof(void*) );
+  ullint_init( &l, &d );
+  srand( 15 );
+  for( i = 0; i < n; i++ ) {
+    CHECK( ullint_insert( &l, rand() % 1000000 ) );
+  }
+  CHECK( ull_save( &(l.u), path ) );
+  dynmem_init( &dm, sizeof(void*) );
+  CHECK( ull_open_mmap( &(m.u), &dm, path, ullint_keyops(), 1 ) );
+  // a second mapping of the same file is at another address (the links are offsets)
+  dynmem_init( &dm2, sizeof(void*) );
+  CHECK( ull_open_mmap( &(m2.u), &dm2, path, ullint_keyops(), 0 ) );
+  CHECK( m.u.mapping != m2.u.mapping );
+  CHECK( check_list( &(m.u) ) == n && check_list( &(m2.u) ) == n );
+  for( i = 0; i < 10000; i++ ) {
+    k = rand() % 1000000;
+    errors += ( ullint_get_nearest( &l, k, 0, &a ) != ullint_get_nearest( &m, k, 0, &b ) || a != b );
+    errors += ( ullint_get_nearest( &l, k, 1, &a ) != ullint_get_nearest( &m2, k, 1, &b ) );
+    errors += ( ! ullint_get( &l, i * 17, &a ) || ! ullint_get( &m, i * 17, &b ) || a != b );
+  }
+  CHECK( errors == 0 );
+  CHECK( ullint_cursor_init( &c, &m2 ) );
+  for( i = 0; ullint_next( &c, &b ); i++ ) {
+    errors += ( ! ullint_get( &l, i, &a ) || a != b );
+  }
+  CHECK( i == n && errors == 0 );
+  // mapped lists are read-only until ull_remove_all()
+  CHECK( ! ullint_insert( &m, 5 ) && ! ullint_remove( &m, a ) && ! ull_set_concurrent( &(m.u), 1 ) );
+  CHECK( ullint_remove_all( &m ) && m.u.mapping == 0 && ullint_size( &m ) == 0 );
+  CHECK( ullint_insert( &m, 5 ) && check_list( &(m.u) ) == 1 );
+  ullint_remove_all( &m );
+  ullint_remove_all( &m2 );
+  // a corrupted file fails the checksum
+  f = fopen( path, "r+b" );
+  CHECK( f && fseek( f, -1, SEEK_END ) == 0 && fputc( 0x55, f ) != EOF );
+  fclose( f );
+  CHECK( ! ull_open_mmap( &(m.u), &dm, path, ullint_keyops(), 1 ) );
+  CHECK( ! ull_open_mmap( &(m.u), &dm, path, ull_keyops_i64(), 0 ) );
+  // a truncated file or a header with counts beyond the file is refused without verify too
+  CHECK( ull_save( &(l.u), path ) );
+  fd = open( path, O_RDWR );
+  CHECK( fd >= 0 && ftruncate( fd, 4096 ) == 0 );
+  close( fd );
+  CHECK( ! ull_open_mmap( &(m.u), &dm, path, ullint_keyops(), 0 ) );
+  CHECK( ull_save( &(l.u), path ) );
+  f = fopen( path, "r+b" );
+  // num_nodes, after the magic, version, byte order and 8 other fields
+  CHECK( f && fseek( f, 16 + 8 * 8, SEEK_SET ) == 0 && fwrite( &n, sizeof(size_t), 1, f ) == 1 );
+  fclose( f );
+  CHECK( ! ull_open_mmap( &(m.u), &dm, path, ullint_keyops(), 0 ) );
+  // empty lists, lists of element pointers can not be saved
+  ullint_remove_all( &l );
+  CHECK( ull_save( &(l.u), path ) && ull_open_mmap( &(m.u), &dm, path, ullint_keyops(), 1 ) );
+  CHECK( ullint_size( &m ) == 0 && ! ullint_get_nearest( &m, 1, 0, &b ) );
+  ullint_remove_all( &m );
+  dynmem_init( &du, sizeof(void*) );
+  ull_init( &u, &du, cmp );
+  CHECK( ! ull_save( &u, path ) );
+  remove( path );
+}
+
+// whether two lists hold the same elements
+static int same_list( ull * a, ull * b )
+{
+  ullcursor ca, cb;
+  void * ea = 0, * eb = 0;
+  ull_cursor_init( &ca, a );
+  ull_cursor_init( &cb, b );
+  while( ull_next( &ca, &ea ) ) {
+    if( ! ull_next( &cb, &eb ) || (a->keyops->cmp)( a, ea, eb ) != 0 ) {
+      return 0;
+    }
+  }
+  return ! ull_next( &cb, &eb );
+}
+
+static void test_checkpoint( void )
+{
+  ullint l, r;
+  dynmem d, dr;
+  size_t i = 0, round = 0;
+  const char * base = "test_checkpoint.ull";
+  const char * log = "test_checkpoint.log";
+  off_t size = 0, before = 0;
+  uint64_t huge = (uint64_t)1 << 40;
+  FILE * f = 0;
+  int fd = -1, k = 0;
+  dynmem_init( &d, sizeof(void*) );
+  ullint_init( &l, &d );
+  CHECK( ! ull_checkpoint( &(l.u), 1 ) );
+  CHECK( ull_set_checkpointing( &(l.u), 1 ) );
+  srand( 16 );
+  for( i = 0; i < 100000; i++ ) {
+    CHECK( ullint_insert( &l, rand() % 1000000 ) );
+  }
+  CHECK( ull_save( &(l.u), base ) );
+  fd = open( log, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644 );
+  CHECK( fd >= 0 );
+  // small checkpoints: inserts (with splits), removals (with merges), a burst
+  for( round = 0; round < 5; round++ ) {
+    int burst[ 500 ];
+    for( i = 0; i < 500; i++ ) {
+      CHECK( ullint_insert( &l, rand() % 1000000 ) );
+      burst[ i ] = rand() % 1000000;
+    }
+    CHECK( ullint_insert_batch( &l, burst, 500 ) );
+    for( i = 0; i < 500; i++ ) {
+      CHECK( ullint_get( &l, (size_t)rand() % ullint_size( &l ), &k ) && ullint_remove( &l, k ) );
+    }
+    CHECK( ullint_remove_range( &l, (int)( round * 1000 ), (int)( round * 1000 + 5000 ) ) > 0 );
+    before = lseek( fd, 0, SEEK_END );
+    CHECK( ull_checkpoint( &(l.u), fd ) );
+    size = lseek( fd, 0, SEEK_END );
+    CHECK( size - before < (off_t)( l.u.num_nodes * l.u.node_size / 4 ) );
+    dynmem_init( &dr, sizeof(void*) );
+    CHECK( ull_recover( &(r.u), &dr, ullint_keyops(), base, log ) );
+    CHECK( check_list( &(r.u) ) == ullint_size( &l ) && same_list( &(l.u), &(r.u) ) );
+    ullint_remove_all( &r );
+  }
+  // a checkpoint of all nodes after ull_remove_all(), an incomplete one is ignored
+  ullint_remove_all( &l );
+  for( i = 0; i < 20000; i++ ) {
+    CHECK( ullint_insert( &l, (int)i ) );
+  }
+  CHECK( ull_checkpoint( &(l.u), fd ) );
+  CHECK( ullint_insert( &l, 7 ) && ull_checkpoint( &(l.u), fd ) );
+  CHECK( ullint_insert( &l, 8 ) );
+  size = lseek( fd, 0, SEEK_END );
+  CHECK( ull_checkpoint( &(l.u), fd ) && ftruncate( fd, lseek( fd, 0, SEEK_END ) - 5 ) == 0 );
+  CHECK( ull_recover( &(r.u), &dr, ullint_keyops(), base, log ) );
+  CHECK( check_list( &(r.u) ) == 20001 && ullint_get_nearest( &r, 7, 1, &k ) && ullint_rank( &r, 8 ) == 9 );
+  // the recovered list continues with new node ids
+  CHECK( r.u.next_node_id >= l.u.next_node_id - 1 );
+  ullint_remove_all( &r );
+  close( fd );
+  // a log without base file (the first checkpoint holds all nodes)
+  CHECK( ull_set_checkpointing( &(l.u), 0 ) && ull_set_checkpointing( &(l.u), 1 ) );
+  fd = open( log, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644 );
+  CHECK( ull_checkpoint( &(l.u), fd ) );
+  before = lseek( fd, 0, SEEK_END );
+  CHECK( ullint_remove( &l, 7 ) && ull_checkpoint( &(l.u), fd ) );
+  close( fd );
+  CHECK( ull_recover( &(r.u), &dr, ullint_keyops(), 0, log ) );
+  CHECK( check_list( &(r.u) ) == 20001 && same_list( &(l.u), &(r.u) ) );
+  ullint_remove_all( &r );
+  // a checkpoint whose node count does not fit its size (the checksum only covers the
+  // rest of the checkpoint) ends the log
+  f = fopen( log, "r+b" );
+  // num_nodes, after the magic, version, full flag and 3 other fields
+  CHECK( f && fseek( f, (long)before + 16 + 3 * 8, SEEK_SET ) == 0 && fwrite( &huge, sizeof(uint64_t), 1, f ) == 1 );
+  fclose( f );
+  CHECK( ull_recover( &(r.u), &dr, ullint_keyops(), 0, log ) );
+  CHECK( check_list( &(r.u) ) == 20002 && ullint_rank( &r, 8 ) == 9 );
+  ullint_remove_all( &r );
+  // a missing log fails after the base file was mapped (nothing is leaked)
+  CHECK( ! ull_recover( &(r.u), &dr, ullint_keyops(), base, "test_checkpoint.missing" ) );
+  CHECK( ull_set_checkpointing( &(l.u), 0 ) );
+  ullint_remove_all( &l );
+  remove( base );
+  remove( log );
+}
+
+static void test_stats( void )
+{
+  ullint l;
+  dynmem d;
+  ullstats st;
+  size_t i = 0, nodes = 0, walks = 0;
+  int k = 0;
+  dynmem_init( &d, sizeof(void*) );
+  ullint_init( &l, &d );
+  srand( 17 );
+  for( i = 0; i < 50000; i++ ) {
+    CHECK( ullint_insert( &l, rand() % 100000 ) );
+  }
+  for( i = 0; i < 1000; i++ ) {
+    ullint_get_nearest( &l, rand() % 100000, 0, &k );
+  }
+  for( i = 0; i < 40000; i++ ) {
+    CHECK( ullint_get( &l, (size_t)rand() % ullint_size( &l ), &k ) && ullint_remove( &l, k ) );
+  }
+  CHECK( ull_stats_get( &(l.u), &st ) );
+  for( i = 0; i < ULL_STATS_FILL_BUCKETS; i++ ) {
+    nodes += (st.fill_hist)[ i ];
+  }
+  for( i = 0; i < ULL_STATS_BUCKETS; i++ ) {
+    walks += (st.walks)[ i ];
+  }
+  CHECK( nodes == l.u.num_nodes && walks == st.lookups );
+  CHECK( st.memory >= l.u.num_nodes * l.u.node_size );
+#ifdef ULL_STATS
+  CHECK( st.enabled );
+  CHECK( st.lookups >= 1000 && st.comparisons > st.searches && st.searches > 0 );
+  CHECK( st.splits > 0 && st.merges > 0 && st.borrows > 0 );
+  CHECK( st.node_allocs - st.node_frees == l.u.num_nodes && st.index_allocs > 0 );
+  CHECK( st.slab_allocs > 0 && st.table_grows > 0 && st.slab_bytes >= st.node_allocs * l.u.node_size );
+#else
+  CHECK( ! st.enabled && st.lookups == 0 && st.splits == 0 && st.slab_allocs == 0 );
+#endif
+  ull_stats_reset( &(l.u) );
+  CHECK( ull_stats_get( &(l.u), &st ) && st.lookups == 0 && st.splits == 0 && st.node_allocs == 0 );
+  ullint_remove_all( &l );
+}
+
+int main( void )
+{
+  test_dynmem();
+  test_basic();
+  test_many();
+  test_nearest();
+  test_sequential();
+  test_typed();
+  test_simd();
+  test_build();
+  test_batch();
+  test_remove();
+  test_positions();
+  test_cursor();
+  test_finger();
+  test_append();
+  test_map();
+  test_multiset();
+  test_abbrev();
+  test_aggregate();
+  test_split_merge();
+  test_packed_nodes();
+  test_save();
+  test_checkpoint();
+  test_stats();
+  test_concurrent();
+  test_shards();
+  if( failures ) {
+    printf("%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("all tests passed\n");
   return 0;
 }
@@ -1,293 +1,4484 @@
+// sched_yield(), posix_memalign() and mmap()
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 #include "ull.h"
 
-// inits the list
-int ull_init( ull * u, dynmem * m, ullcmpfunc f )
+// the void* API: nodes store the element pointers, compared by the list's cmpfunc
+ULL_DEFINE_KEYOPS( _ull_ptr, void *, (u->cmpfunc)( a, b ) )
+
+// lists created with ull_init_abbrev(): the abbreviations decide unless they are equal,
+// only then the cmpfunc dereferences the element pointers
+ULL_DEFINE_KEYOPS( _ull_abbrev, ullabbrevkey,
+  ( a.abbrev < b.abbrev ? -1 : ( a.abbrev > b.abbrev ? 1 : (u->cmpfunc)( a.elem, b.elem ) ) ) )
+
+// built-in key operations for 32/64 bit integers and doubles
+// -> the generated binary searches are the scalar fallback of the SIMD kernels below
+ULL_DEFINE_KEYOPS( _ull_i32, int32_t, ( a < b ? -1 : ( a > b ? 1 : 0 ) ) )
+ULL_DEFINE_KEYOPS( _ull_i64, int64_t, ( a < b ? -1 : ( a > b ? 1 : 0 ) ) )
+ULL_DEFINE_KEYOPS( _ull_f64, double, ( a < b ? -1 : ( a > b ? 1 : 0 ) ) )
+
+// bit-packed keys of packed lists (see ull_set_packed()): keys are stored as deltas to a base key,
+// each delta w bits wide at bit i * w, little endian
+// -> a delta of at most ULL_PACK_MAX_WIDTH bits is inside the 8 bytes starting at its first
+//    byte, so it is read with one 8 byte load (the deltas are followed by 8 bytes of padding)
+
+// the 64 bits at p (little endian)
+static inline uint64_t _ull_pack_load( const unsigned char * p )
 {
-  if( ULL_ELEMENTS_PER_NODE < 2 ) {
-    // number of elements per node must be at least 2 to ensure logic
-    return 0;
+  uint64_t w = 0;
+  memcpy( &w, p, sizeof(uint64_t) );
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  w = __builtin_bswap64( w );
+#endif
+  return w;
+}
+
+static inline void _ull_pack_store( unsigned char * p, uint64_t w )
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  w = __builtin_bswap64( w );
+#endif
+  memcpy( p, &w, sizeof(uint64_t) );
+}
+
+// number of bits needed for delta d (deltas wider than ULL_PACK_MAX_WIDTH are stored in 64 bits)
+static unsigned int _ull_pack_width( uint64_t d )
+{
+  unsigned int w = 0;
+  while( d ) {
+    d >>= 1;
+    w ++;
   }
-  if( u && m && f ) {
-    u->root = 0;
-    //u->num_elements = 0;
-    u->num_nodes = 0;
-    u->cmpfunc = f;
-		u->nodes_memory = m;
-		dynmem_resize( m, 24 );
-    return 1;
+  return ( w > ULL_PACK_MAX_WIDTH ? 64 : w );
+}
+
+// the i-th delta of width w
+static uint64_t _ull_pack_delta( const unsigned char * d, unsigned int w, size_t i )
+{
+  size_t bit = i * w;
+  if( w == 64 ) {
+    return _ull_pack_load( d + i * 8 );
   }
-  return 0;
+  return ( _ull_pack_load( d + bit / 8 ) >> ( bit % 8 ) ) & ( ( (uint64_t)1 << w ) - 1 );
 }
 
-void ull_debug( ull * u, ulldebugfunc f )
+// packs the deltas of n keys to keys[ 0 ] with width w to d (which is cleared first,
+// including the padding)
+static void _ull_pack_deltas( unsigned char * d, const int64_t * keys, size_t n, unsigned int w )
 {
-  if( u ) {
-    ullnode * n = u->root;
-    int i = 0;
-    printf("<ull nodes_memory %s, root %s, num_nodes %ld\n",
-      (u->nodes_memory == NULL ? "NULL" : "DEF"), 
-      (u->root == NULL ? "NULL" : "DEF"), u->num_nodes);
-    printf("  memory: ");
-      dynmem_debug( u->nodes_memory );
-    while( n ) {
-      printf("  <ullnode %4d, prev %s, next %s, elements %s, num_elements %ld / %ld>\n",
-        i,
-        (n->prev == NULL ? "NULL" : "DEF"),
-        (n->next == NULL ? "NULL" : "DEF"),
-        ((n->elements)[0] == NULL ? "NULL" : "DEF"), n->num_elements, (size_t)(ULL_ELEMENTS_PER_NODE) );
-      if( f ) {
-        size_t j = 0;
-        for( j = 0; j < n->num_elements; j++ ) {
-          printf("    [  %4ld] ", j);
-          f( (n->elements)[j] );
-        }
-        if( n->num_elements < ULL_ELEMENTS_PER_NODE ) {
-          printf("    [..%4ld] not set\n", (size_t)(ULL_ELEMENTS_PER_NODE) - 1 );
-        }
-      }
-      n = n->next;
-      i++;
+  size_t i = 0;
+  memset( d, 0, ( n * w + 7 ) / 8 + sizeof(uint64_t) );
+  for( i = 0; w > 0 && i < n; i++ ) {
+    uint64_t delta = (uint64_t)(keys[ i ]) - (uint64_t)(keys[ 0 ]);
+    size_t bit = i * w;
+    if( w == 64 ) {
+      _ull_pack_store( d + i * 8, delta );
+    }
+    else {
+      _ull_pack_store( d + bit / 8, _ull_pack_load( d + bit / 8 ) | ( delta << ( bit % 8 ) ) );
+    }
+  }
+}
+
+// unpacks the keys [from,from+n) of deltas d of width w to base
+static void _ull_unpack_scalar( const unsigned char * d, unsigned int w, size_t from, size_t n, int64_t base, int64_t * keys )
+{
+  size_t i = 0;
+  for( i = 0; i < n; i++ ) {
+    keys[ i ] = (int64_t)( (uint64_t)base + _ull_pack_delta( d, w, from + i ) );
+  }
+}
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define ULL_HAVE_X86_KERNELS 1
+#include <immintrin.h>
+
+// SIMD kernels: since the keys are sorted, the number of keys before key
+// (or not after key) is the lower (or upper) bound
+// -> big nodes are first narrowed down to a window of ULL_SIMD_WINDOW keys by
+//    (branchless) binary search steps, then the kernels compare whole vectors
+//    of keys of the window and count the matching lanes
+// -> integer kernels count the keys not after t = key (upper) or t = key - 1 (lower)
+#define ULL_SIMD_WINDOW 16
+
+#define ULL_SIMD_NARROW( k, n, base, NOT_AFTER ) \
+  while( n > ULL_SIMD_WINDOW ) { \
+    size_t half = n / 2; \
+    base = ( NOT_AFTER( k[ base + half ] ) ? base + half : base ); \
+    n -= half; \
+  }
+
+#define ULL_INT_NOT_AFTER( x ) ( (x) <= t )
+#define ULL_F64_NOT_AFTER( x ) ( upper ? (x) <= b : (x) < b )
+
+__attribute__((target("avx2,popcnt")))
+static size_t _ull_i32_search_avx2( ull * u, const void * keys, size_t n, const void * key, int upper )
+{
+  const int32_t * k = (const int32_t*)keys;
+  int32_t t = *((const int32_t*)key);
+  __m256i vt;
+  size_t base = 0, i = 0, cnt = 0;
+  if( ! upper ) {
+    if( t == INT32_MIN ) {
+      return 0;
+    }
+    t --;
+  }
+  ULL_SIMD_NARROW( k, n, base, ULL_INT_NOT_AFTER )
+  k += base;
+  vt = _mm256_set1_epi32( t );
+  for( ; i + 8 <= n; i += 8 ) {
+    __m256i m = _mm256_cmpgt_epi32( _mm256_loadu_si256( (const __m256i*)( k + i ) ), vt );
+    cnt += (size_t)__builtin_popcount( _mm256_movemask_ps( _mm256_castsi256_ps( m ) ) );
+  }
+  for( ; i < n; i++ ) {
+    cnt += ( k[ i ] > t );
+  }
+  return base + n - cnt;
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t _ull_i64_search_avx2( ull * u, const void * keys, size_t n, const void * key, int upper )
+{
+  const int64_t * k = (const int64_t*)keys;
+  int64_t t = *((const int64_t*)key);
+  __m256i vt;
+  size_t base = 0, i = 0, cnt = 0;
+  if( ! upper ) {
+    if( t == INT64_MIN ) {
+      return 0;
+    }
+    t --;
+  }
+  ULL_SIMD_NARROW( k, n, base, ULL_INT_NOT_AFTER )
+  k += base;
+  vt = _mm256_set1_epi64x( t );
+  for( ; i + 4 <= n; i += 4 ) {
+    __m256i m = _mm256_cmpgt_epi64( _mm256_loadu_si256( (const __m256i*)( k + i ) ), vt );
+    cnt += (size_t)__builtin_popcount( _mm256_movemask_pd( _mm256_castsi256_pd( m ) ) );
+  }
+  for( ; i < n; i++ ) {
+    cnt += ( k[ i ] > t );
+  }
+  return base + n - cnt;
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t _ull_f64_search_avx2( ull * u, const void * keys, size_t n, const void * key, int upper )
+{
+  const double * k = (const double*)keys;
+  double b = *((const double*)key);
+  __m256d vb = _mm256_set1_pd( b );
+  size_t base = 0, i = 0, cnt = 0;
+  ULL_SIMD_NARROW( k, n, base, ULL_F64_NOT_AFTER )
+  k += base;
+  if( upper ) {
+    for( ; i + 4 <= n; i += 4 ) {
+      __m256d m = _mm256_cmp_pd( _mm256_loadu_pd( k + i ), vb, _CMP_LE_OQ );
+      cnt += (size_t)__builtin_popcount( _mm256_movemask_pd( m ) );
     }
-    printf(">\n");  
   }
   else {
-    printf("<NULL>");
+    for( ; i + 4 <= n; i += 4 ) {
+      __m256d m = _mm256_cmp_pd( _mm256_loadu_pd( k + i ), vb, _CMP_LT_OQ );
+      cnt += (size_t)__builtin_popcount( _mm256_movemask_pd( m ) );
+    }
+  }
+  for( ; i < n; i++ ) {
+    cnt += ULL_F64_NOT_AFTER( k[ i ] );
   }
+  return base + cnt;
 }
 
-int _ull_insert_new_node( ull * u, ullnode * prev, ullnode * next, ullnode * * new )
+__attribute__((target("sse4.2,popcnt")))
+static size_t _ull_i32_search_sse( ull * u, const void * keys, size_t n, const void * key, int upper )
 {
-  if( u && new ) {
-		//if( dynmem_resize( u->nodes_memory, u->num_nodes + 1, 0 ) &&
-    //    dynmem_get( u->nodes_memory, u->num_nodes, 1, (void **)&newnode ) &&
-    //    newnode ) {
-		//ullnode n = { 0 };
-		//size_t idx = dynmem_size( u->nodes_memory );
-		//if( dynmem_set( u->nodes_memory, idx, 1, (void*)&n ) ) {
-		//	ullnode * newnode = 0;
-		//	// get pointer to stored ullnode
-		//	if( dynmem_get( u->nodes_memory, idx, 1, (void**)&newnode ) ) {
-		ullnode n = { 0 };
-		ullnode * newnode = 0;
-		//printf("NEW NODE ?\n");
-		if( dynmem_push( u->nodes_memory, (void*)&n, (void**)&newnode ) && newnode ) {
-
-			//printf("  -> PUSHED\n");
-
-			// init node
-			newnode->prev = ( prev ? prev : 0 );
-			if( prev ) { // let previous node point to new node
-				prev->next = newnode;
-			}
-			newnode->next = ( next ? next : 0 );
-			if( next ) { // let new node point to next node
-				next->prev = newnode;
-			}
-			newnode->num_elements = 0;
-			*(newnode->elements) = 0;			
-			// inc total node counter
-			u->num_nodes ++;
-			// result
-			*new = newnode;
-			return 1;
+  const int32_t * k = (const int32_t*)keys;
+  int32_t t = *((const int32_t*)key);
+  __m128i vt;
+  size_t base = 0, i = 0, cnt = 0;
+  if( ! upper ) {
+    if( t == INT32_MIN ) {
+      return 0;
     }
+    t --;
   }
-  return 0;
+  ULL_SIMD_NARROW( k, n, base, ULL_INT_NOT_AFTER )
+  k += base;
+  vt = _mm_set1_epi32( t );
+  for( ; i + 4 <= n; i += 4 ) {
+    __m128i m = _mm_cmpgt_epi32( _mm_loadu_si128( (const __m128i*)( k + i ) ), vt );
+    cnt += (size_t)__builtin_popcount( _mm_movemask_ps( _mm_castsi128_ps( m ) ) );
+  }
+  for( ; i < n; i++ ) {
+    cnt += ( k[ i ] > t );
+  }
+  return base + n - cnt;
 }
 
-int _ull_insert_node_element( ullnode * n, size_t insert_at_index, void * elem )
+__attribute__((target("sse4.2,popcnt")))
+static size_t _ull_i64_search_sse( ull * u, const void * keys, size_t n, const void * key, int upper )
 {
-  if( n ) {
-    // shift elements after insert pos one up
-    if( n->num_elements > insert_at_index ) {
-			//printf("move up\n");
-			for( size_t i = n->num_elements; i > insert_at_index; i-- ) {
-				(n->elements)[ i ] = (n->elements)[ i - 1 ];
-			}
-		}
-    // set at pos
-    (n->elements)[ insert_at_index ] = elem;
-    n->num_elements ++;
-		//printf("inserted elem: ");
-		//tmplvar_debug( (n->elements)[ insert_at_index ] );
-    return 1;
+  const int64_t * k = (const int64_t*)keys;
+  int64_t t = *((const int64_t*)key);
+  __m128i vt;
+  size_t base = 0, i = 0, cnt = 0;
+  if( ! upper ) {
+    if( t == INT64_MIN ) {
+      return 0;
+    }
+    t --;
   }
-  return 1;
+  ULL_SIMD_NARROW( k, n, base, ULL_INT_NOT_AFTER )
+  k += base;
+  vt = _mm_set1_epi64x( t );
+  for( ; i + 2 <= n; i += 2 ) {
+    __m128i m = _mm_cmpgt_epi64( _mm_loadu_si128( (const __m128i*)( k + i ) ), vt );
+    cnt += (size_t)__builtin_popcount( _mm_movemask_pd( _mm_castsi128_pd( m ) ) );
+  }
+  for( ; i < n; i++ ) {
+    cnt += ( k[ i ] > t );
+  }
+  return base + n - cnt;
 }
 
-// uses compare function to insert element in a sorted fashion
-int ull_insert( ull * u, void * elem )
+__attribute__((target("sse4.2,popcnt")))
+static size_t _ull_f64_search_sse( ull * u, const void * keys, size_t n, const void * key, int upper )
 {
-  if( u->num_nodes == 0 ) {
-    // init first node with one element
-    ullnode * new = 0;
-    if( _ull_insert_new_node( u, 0, 0, &new ) ) {
-      // insert element
-      new->num_elements = 1;
-      (new->elements)[0] = elem;
-			new->prev = NULL;
-			new->next = NULL;
-      // insert node as root node
-      u->root = new;
-      return 1;
+  const double * k = (const double*)keys;
+  double b = *((const double*)key);
+  __m128d vb = _mm_set1_pd( b );
+  size_t base = 0, i = 0, cnt = 0;
+  ULL_SIMD_NARROW( k, n, base, ULL_F64_NOT_AFTER )
+  k += base;
+  if( upper ) {
+    for( ; i + 2 <= n; i += 2 ) {
+      cnt += (size_t)__builtin_popcount( _mm_movemask_pd( _mm_cmple_pd( _mm_loadu_pd( k + i ), vb ) ) );
     }
   }
   else {
-    // insert in a sorted fashion
-    ullnode * best = 0;
-    if( _ull_get_node_including_elem( u, elem, &best ) && best ) {
-      int res = 0;
-      if( best->num_elements > 0 && (u->cmpfunc)( elem, (best->elements)[0] ) < 0 ) {
-        // elem is before best node -> put as first node element
-				//printf("put as first (0)\n");
-        res = _ull_insert_node_element( best, 0, elem );
-      }
-      else if( best->num_elements > 0 && (u->cmpfunc)( elem, (best->elements)[best->num_elements - 1] ) > 0 ) {
-        // elem is after best node -> append to node elements
-				//printf("put as last (as %ld)\n", best->num_elements);
-        res = _ull_insert_node_element( best, best->num_elements, elem );
-      }
-      else {
-        // elem is inside best node, find a place inside node elements
-        size_t i = 0;
-				//printf("put inside\n");
-        for( i = 0; i < best->num_elements; i++ ) {
-          void * e = (best->elements)[ i ];
-          if( i == 0 && (u->cmpfunc)( elem, e ) < 0 ) {
-            // before current element (only applicable for first element)
-						//printf("  put before first (0)\n");
-            res = _ull_insert_node_element( best, i, elem );
-            break;
-          }
-          else if( (u->cmpfunc)( elem, e ) >= 0 && 
-              ( i == best->num_elements - 1 || (u->cmpfunc)( elem, (best->elements)[ i + 1 ] ) <= 0 ) ) {
-            // after current element
-						//printf("  put after %ld (as %ld)\n", i, i+1);
-            res = _ull_insert_node_element( best, i + 1, elem );
-            break;
-          }
-        }
-        res = 1;
-      }
-      // check if best node is full and needs to be split
-      // (always ensure a minimum of ONE empty element slot per node, for the logic above
-      // and optimally all nodes should not be fuller than 80%)
-      if( res &&
-          ( ( (double)(best->num_elements) / (double)(ULL_ELEMENTS_PER_NODE) ) > 0.8 ||
-            (ULL_ELEMENTS_PER_NODE - best->num_elements) < 1 ) ) {
-        
-				//printf("needs split\n");
-        // more than 80% full -> split in two nodes
-        ullnode * new = 0;
-        // insert a new node after best node
-        if( _ull_insert_new_node( u, best, best->next, &new ) && new ) {
-          // put second half of best's elements into new node
-          size_t firstnew = (size_t)( (double)(best->num_elements) / (double)2.0 + 0.1 );
-          size_t i = 0;
-          for( i = firstnew; i < best->num_elements; i++ ) {
-            (new->elements)[ i - firstnew ] = (best->elements)[ i ];
-            new->num_elements ++;
-          }
-          best->num_elements = firstnew;
-        }
-      }
-      return res;
+    for( ; i + 2 <= n; i += 2 ) {
+      cnt += (size_t)__builtin_popcount( _mm_movemask_pd( _mm_cmplt_pd( _mm_loadu_pd( k + i ), vb ) ) );
+    }
+  }
+  for( ; i < n; i++ ) {
+    cnt += ULL_F64_NOT_AFTER( k[ i ] );
+  }
+  return base + cnt;
+}
+
+// SIMD unpack kernel: 4 deltas at a time are gathered with one 8 byte load each
+// (at the byte of their first bit), shifted by their bit offset and masked
+__attribute__((target("avx2")))
+static void _ull_unpack_avx2( const unsigned char * d, unsigned int w, size_t from, size_t n, int64_t base, int64_t * keys )
+{
+  size_t i = 0;
+  if( w > 0 && w < 64 ) {
+    __m256i vmask = _mm256_set1_epi64x( (long long)( ( (uint64_t)1 << w ) - 1 ) );
+    __m256i vbase = _mm256_set1_epi64x( (long long)base );
+    __m256i vstep = _mm256_set1_epi64x( (long long)( 4 * w ) );
+    __m256i vseven = _mm256_set1_epi64x( 7 );
+    __m256i vbit = _mm256_setr_epi64x( (long long)( from * w ), (long long)( ( from + 1 ) * w ),
+      (long long)( ( from + 2 ) * w ), (long long)( ( from + 3 ) * w ) );
+    for( ; i + 4 <= n; i += 4 ) {
+      __m256i x = _mm256_i64gather_epi64( (const long long*)d, _mm256_srli_epi64( vbit, 3 ), 1 );
+      x = _mm256_srlv_epi64( x, _mm256_and_si256( vbit, vseven ) );
+      x = _mm256_add_epi64( _mm256_and_si256( x, vmask ), vbase );
+      _mm256_storeu_si256( (__m256i*)( keys + i ), x );
+      vbit = _mm256_add_epi64( vbit, vstep );
+    }
+  }
+  _ull_unpack_scalar( d, w, from + i, n - i, base, keys + i );
+}
+#endif
+
+// built-in key operations, the search kernel is selected once by cpu feature detection
+// (and the unpack kernel of bit-packed keys)
+static ullkeyops _ull_builtin_ops[ 3 ];
+static const char * _ull_kernel = 0;
+static void (*_ull_unpack_kernel)( const unsigned char *, unsigned int, size_t, size_t, int64_t, int64_t * ) = 0;
+
+static void _ull_select_kernels( void )
+{
+  if( ! _ull_kernel ) {
+    ullkeyops * ops = _ull_builtin_ops;
+    ops[ 0 ] = *( _ull_i32_keyops() );
+    ops[ 1 ] = *( _ull_i64_keyops() );
+    ops[ 2 ] = *( _ull_f64_keyops() );
+    _ull_unpack_kernel = _ull_unpack_scalar;
+    _ull_kernel = "scalar";
+#ifdef ULL_HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "avx2" ) ) {
+      ops[ 0 ].search = _ull_i32_search_avx2;
+      ops[ 1 ].search = _ull_i64_search_avx2;
+      ops[ 2 ].search = _ull_f64_search_avx2;
+      _ull_unpack_kernel = _ull_unpack_avx2;
+      _ull_kernel = "avx2";
+    }
+    else if( __builtin_cpu_supports( "sse4.2" ) ) {
+      ops[ 0 ].search = _ull_i32_search_sse;
+      ops[ 1 ].search = _ull_i64_search_sse;
+      ops[ 2 ].search = _ull_f64_search_sse;
+      _ull_kernel = "sse4.2";
     }
+#endif
+  }
+}
+
+const ullkeyops * ull_keyops_i32( void )
+{
+  _ull_select_kernels();
+  return &(_ull_builtin_ops[ 0 ]);
+}
+
+const ullkeyops * ull_keyops_i64( void )
+{
+  _ull_select_kernels();
+  return &(_ull_builtin_ops[ 1 ]);
+}
+
+const ullkeyops * ull_keyops_f64( void )
+{
+  _ull_select_kernels();
+  return &(_ull_builtin_ops[ 2 ]);
+}
+
+// name of the selected search kernel ("avx2", "sse4.2" or "scalar")
+const char * ull_keyops_kernel( void )
+{
+  _ull_select_kernels();
+  return _ull_kernel;
+}
+
+// unpacks the keys [from,from+n) of deltas d of width w to base (SIMD kernel with AVX2)
+static void _ull_unpack( const unsigned char * d, unsigned int w, size_t from, size_t n, int64_t base, int64_t * keys )
+{
+  _ull_select_kernels();
+  (_ull_unpack_kernel)( d, w, from, n, base, keys );
+}
+
+// hints the cpu to load memory that is read soon
+#if defined(__GNUC__)
+#define ULL_PREFETCH( addr ) __builtin_prefetch( (addr), 0, 3 )
+#else
+#define ULL_PREFETCH( addr ) ((void)(addr))
+#endif
+
+// rounds up to a multiple of the cache line size
+static size_t _ull_align( size_t size )
+{
+  return ( size + ULL_CACHE_LINE - 1 ) & ~((size_t)(ULL_CACHE_LINE - 1));
+}
+
+// operation statistics (see ull_stats_get()): the counters are only touched if
+// compiled with ULL_STATS, relaxed atomics since readers of a list in concurrent
+// mode count their lookups as well
+#ifdef ULL_STATS
+#define ULL_STAT_ADD( st, field, n ) __atomic_fetch_add( &((st)->field), (uint64_t)(n), __ATOMIC_RELAXED )
+#else
+#define ULL_STAT_ADD( st, field, n ) do {} while( 0 )
+#endif
+
+// counts a lookup that visited n nodes
+static inline void _ull_stat_walk( ull * u, size_t n )
+{
+#ifdef ULL_STATS
+  size_t b = 0;
+  while( n > 0 && b < ULL_STATS_BUCKETS - 1 ) {
+    n >>= 1;
+    b ++;
+  }
+  ULL_STAT_ADD( &(u->stats), lookups, 1 );
+  ULL_STAT_ADD( &(u->stats), walks[ b ], 1 );
+#else
+  (void)u;
+  (void)n;
+#endif
+}
+
+// the keyops calls of the list, counting the searches and comparisons
+static inline size_t _ull_search( ull * u, const void * keys, size_t n, const void * key, int upper )
+{
+#ifdef ULL_STATS
+  size_t steps = 1;
+  size_t m = n;
+  while( m > 1 ) {
+    m >>= 1;
+    steps ++;
+  }
+  ULL_STAT_ADD( &(u->stats), searches, 1 );
+  ULL_STAT_ADD( &(u->stats), comparisons, steps );
+#endif
+  return (u->keyops->search)( u, keys, n, key, upper );
+}
+
+static inline int _ull_cmp( ull * u, const void * a, const void * b )
+{
+  ULL_STAT_ADD( &(u->stats), comparisons, 1 );
+  return (u->keyops->cmp)( u, a, b );
+}
+
+// inits a pool for objects of given size, the slab table is kept in given dynmem
+// -> the dynmem must be initialized (see dynmem_init()), its allocator backend and policy
+//    are kept: the slabs come from that backend
+int _ull_pool_init( ullpool * p, dynmem * slabs, size_t objsize )
+{
+  if( p && slabs && slabs->allocator && slabs->policy && objsize >= sizeof(void*) ) {
+    p->slabs = slabs;
+    p->objsize = objsize;
+    p->cur_slab = 0;
+    p->used_in_slab = 0;
+    p->slab_objects = 0; // forces a new slab on first alloc
+    p->free_list = 0;
+    p->stats = 0;
+    slabs->bytes = 0;
+    slabs->elemsize = sizeof(void*);
+    slabs->reserved = 0;
+    slabs->length = 0;
+    return 1;
   }
   return 0;
 }
 
-// find the ullnode that would/does best include given element
-// -> does NOT check if given element is ACTUALLY inside the node, just in the RANGE of the node's elements!
-// -> if given element is BETWEEN two nodes (or before first node or after last node) then
-//    the node with the LEAST elements is returned (or first/last node)
-int _ull_get_node_including_elem( ull * u, void * elem, ullnode * * n )
+// bytes allocated per slab: the number of pools holding the slab (size_t, see _ull_pool_share()),
+// ULL_NODES_PER_SLAB objects and the room to align them to a cache line, rounded up to the
+// granularity of the allocator backend (whole huge pages for the mmap backends, filled with
+// more objects, so that a huge page is not spent on each slab)
+static size_t _ull_pool_slab_bytes( ullpool * p )
 {
-  if( n ) {
-    ullnode * cur = u->root;
-    ullnode * prev = 0; // previous node
-    while( cur && cur->num_elements > 0 ) { // stop if empty node is found (which should never happen)
-      void * first = (cur->elements)[ 0 ];
-      void * last = (cur->elements)[ cur->num_elements - 1 ];
-
-      if( (u->cmpfunc)( elem, first ) < 0 ) {
-        // elem is before first element of this node
-        if( prev ) {
-          // the previous node is the best for elem
-          *n = prev;
-          return 1;
-        }
-        else {
-          // this node is the best for elem
-          *n = cur;
-          return 1;
-        }
+  size_t bytes = sizeof(size_t) + p->objsize * ULL_NODES_PER_SLAB + ULL_CACHE_LINE - 1;
+  size_t g = p->slabs->allocator->granularity;
+  return ( g ? ( bytes + g - 1 ) / g * g : bytes );
+}
+
+// number of objects per slab (see _ull_pool_slab_bytes())
+static size_t _ull_pool_slab_objects( ullpool * p )
+{
+  return ( _ull_pool_slab_bytes( p ) - sizeof(size_t) - ( ULL_CACHE_LINE - 1 ) ) / p->objsize;
+}
+
+// O(1): takes an object from the free list or carves it from the last slab
+// -> objects never move, so pointers to them stay valid until they are freed
+void * _ull_pool_alloc( ullpool * p )
+{
+  void * obj = 0;
+  if( p->free_list ) {
+    obj = p->free_list;
+    p->free_list = *((void**)obj);
+  }
+  else {
+    if( p->used_in_slab >= p->slab_objects ) {
+      // last slab is exhausted -> add a new one, from the allocator backend of the slab table
+      // (the table keeps the allocated pointer, objects start at a cache line boundary)
+      unsigned char * slab = (p->slabs->allocator->alloc)( p->slabs->allocator_ctx, _ull_pool_slab_bytes( p ) );
+#ifdef ULL_STATS
+      size_t reserved = p->slabs->reserved;
+#endif
+      if( ! slab ) {
+        return 0;
       }
-      else if( (u->cmpfunc)( elem, last ) <= 0 ) {
-        // this node is best for elem
-        *n = cur;
-        return 1;
+      if( ! dynmem_push( p->slabs, (void*)&slab, 0 ) ) {
+        (p->slabs->allocator->release)( p->slabs->allocator_ctx, slab, _ull_pool_slab_bytes( p ) );
+        return 0;
       }
-      else if( ! cur->next ) {
-        // there is no next node, so current node is best for elem
-        *n = cur;
-        return 1;
+#ifdef ULL_STATS
+      if( p->stats ) {
+        ULL_STAT_ADD( p->stats, slab_allocs, 1 );
+        ULL_STAT_ADD( p->stats, slab_bytes, _ull_pool_slab_bytes( p ) );
+        if( p->slabs->reserved != reserved ) {
+          // the table was reallocated (the pointers before the new one were moved)
+          ULL_STAT_ADD( p->stats, table_grows, 1 );
+          ULL_STAT_ADD( p->stats, table_bytes_moved, ( p->slabs->length - 1 ) * p->slabs->elemsize );
+        }
       }
-      // else: go to next node and check that
-      cur = cur->next;
+#endif
+      *((size_t*)slab) = 1;
+      slab += sizeof(size_t);
+      p->cur_slab = slab + ( ( ULL_CACHE_LINE - ( (uintptr_t)slab % ULL_CACHE_LINE ) ) % ULL_CACHE_LINE );
+      p->used_in_slab = 0;
+      p->slab_objects = _ull_pool_slab_objects( p );
     }
+    obj = p->cur_slab + ( p->used_in_slab * p->objsize );
+    p->used_in_slab ++;
   }
-  return 0; // no best node found
+  return obj;
 }
 
-// uses compare function to retrieve nearest element
-int ull_get_nearest( ull * u, void * elem, int exactly, void * * nearest )
+// O(1): puts the object into the free list for reuse
+void _ull_pool_free( ullpool * p, void * obj )
 {
-  ullnode * best = 0;
-  if( _ull_get_node_including_elem( u, elem, &best ) && best ) {
-    // try to find element inside node
+  if( p && obj ) {
+    *((void**)obj) = p->free_list;
+    p->free_list = obj;
+  }
+}
+
+// releases all slabs and the slab table at once (all objects of the pool become invalid)
+// -> slabs that other pools hold as well stay until the last of them releases them
+void _ull_pool_release( ullpool * p )
+{
+  if( p && p->slabs ) {
     size_t i = 0;
-    for( i = 0; i < best->num_elements; i++ ) {
-      void * e = (best->elements)[ i ];
-      int cmpi = (u->cmpfunc)( elem, e );
-      
-      if( cmpi == 0 || // exact match
-          ( ! exactly && (
-            cmpi < 0 || // is before current element
-            ( cmpi > 0 && i < best->num_elements - 1 && (u->cmpfunc)( elem, (best->elements)[ i + 1 ] ) < 0 ) || // is between this and next element
-            ( cmpi > 0 && i == best->num_elements - 1 ) ) ) ) { // is after this element but there are no next elements
-        // current element is nearest
-        *nearest = (best->elements)[ i ];
-        return 1;
+    void * * slots = 0;
+    size_t num = dynmem_length( p->slabs );
+    if( num > 0 && dynmem_get( p->slabs, 0, num, (void**)&slots ) ) {
+      // (in reverse, so an arena can take back the blocks at its end)
+      for( i = num; i > 0; i-- ) {
+        if( -- *((size_t*)(slots[ i - 1 ])) == 0 ) {
+          (p->slabs->allocator->release)( p->slabs->allocator_ctx, slots[ i - 1 ], _ull_pool_slab_bytes( p ) );
+        }
       }
     }
+    dynmem_free( p->slabs );
+    p->cur_slab = 0;
+    p->used_in_slab = 0;
+    p->slab_objects = 0;
+    p->free_list = 0;
   }
-  return 0;
 }
 
-// nice to have
-size_t ull_size( ull * u )
+// whether pool "from" can share its slabs with pool "to": same object size and allocator backend
+static int _ull_pool_compatible( ullpool * to, ullpool * from )
 {
-	return 0;
-  //return ( u ? u->num_elements : 0 );
+  return ( to->slabs && from->slabs && to->objsize == from->objsize &&
+    to->slabs->allocator == from->slabs->allocator && to->slabs->allocator_ctx == from->slabs->allocator_ctx );
 }
 
-// nice to have
-int ull_get( ull * u, size_t pos, void * * value )
+// lets pool "to" hold all slabs of pool "from" as well (see _ull_pool_compatible()),
+// so objects of "from" can move to the list of "to" (ull_split_at(), ull_concat())
+// -> O(number of slabs): only the slab table of "to" grows, the objects stay where they are
+// -> every object is used by one list or free in one pool, pools only carve objects from their
+//    own last slab, and a slab is released by the last pool holding it
+static int _ull_pool_share( ullpool * to, ullpool * from )
 {
-  // ...
+  size_t i = 0, num = dynmem_length( from->slabs );
+  void * * slots = 0;
+  if( num > 0 && ! dynmem_get( from->slabs, 0, num, (void**)&slots ) ) {
+    return 0;
+  }
+  for( i = 0; i < num; i++ ) {
+    void * slab = slots[ i ];
+    if( ! dynmem_push( to->slabs, (void*)&slab, 0 ) ) {
+      return 0;
+    }
+    ( *((size_t*)slab) ) ++;
+  }
   return 1;
 }
 
-int ull_remove_all( ull * u )
+// after _ull_pool_share( to, from ): moves the free objects of "from" and the objects
+// not carved from its last slab yet to the free list of "to", "from" becomes empty
+// -> O(number of free objects of "from")
+static void _ull_pool_absorb( ullpool * to, ullpool * from )
 {
-  if( u ) {
-    u->root = 0;
-    //u->num_elements = 0;
-    u->num_nodes = 0;
-    return 1;
+  void * last = from->free_list;
+  if( last ) {
+    while( *((void**)last) ) {
+      last = *((void**)last);
+    }
+    *((void**)last) = to->free_list;
+    to->free_list = from->free_list;
+    from->free_list = 0;
+  }
+  while( from->used_in_slab < from->slab_objects ) {
+    _ull_pool_free( to, from->cur_slab + from->used_in_slab * from->objsize );
+    from->used_in_slab ++;
+  }
+  _ull_pool_release( from );
+}
+
+// concurrent mode: one writer thread modifies the list while reader threads look up
+// elements without taking locks (see ull_read_nearest())
+// -> every node and index node is a seqlock: the writer keeps its version odd while
+//    modifying it and readers retry if the version changed while they read it
+// -> the index only guides readers to a node, they check that the node still covers
+//    the key and move along the node chain otherwise
+// -> nodes and index nodes unlinked by the writer are retired: they go back to their pool
+//    once all readers that might still see them left their read sections (epoch-based reclamation)
+
+#define ULL_LOAD( x ) __atomic_load_n( &(x), __ATOMIC_RELAXED )
+#define ULL_STORE( x, v ) __atomic_store_n( &(x), (v), __ATOMIC_RELEASE )
+
+// an object waiting to be given back to its pool
+typedef struct _ullretired {
+  void * obj;
+  ullpool * pool;
+  unsigned long epoch;
+}
+ullretired;
+
+// one reader: (epoch << 1) | 1 while inside a read section, 0 outside
+// (one cache line each, so readers do not share lines)
+typedef struct _ullreaderslot {
+  unsigned long active;
+  int used;
+  unsigned char pad [ ULL_CACHE_LINE - sizeof(unsigned long) - sizeof(int) ];
+}
+ullreaderslot;
+
+typedef struct _ullepoch {
+  ullreaderslot readers [ ULL_MAX_READERS ];
+  // global epoch (only advanced by the writer)
+  unsigned long global;
+  // retired objects in the order of retirement
+  ullretired * retired;
+  size_t num_retired;
+  size_t max_retired;
+}
+ullepoch;
+
+// gives the objects retired at least two epochs ago back to their pools
+static void _ull_reclaim( ullepoch * e )
+{
+  size_t i = 0, keep = 0;
+  for( i = 0; i < e->num_retired; i++ ) {
+    if( (e->retired)[ i ].epoch + 2 <= e->global ) {
+      _ull_pool_free( (e->retired)[ i ].pool, (e->retired)[ i ].obj );
+    }
+    else {
+      (e->retired)[ keep++ ] = (e->retired)[ i ];
+    }
+  }
+  e->num_retired = keep;
+}
+
+// advances the global epoch if all readers inside a read section have seen it
+// -> an object retired in epoch g was unlinked before any reader entered in epoch g + 1,
+//    so it can be reused once no reader of epoch g is left (global epoch g + 2)
+static void _ull_try_advance( ullepoch * e )
+{
+  unsigned long g = e->global;
+  size_t i = 0;
+  __atomic_thread_fence( __ATOMIC_SEQ_CST );
+  for( i = 0; i < ULL_MAX_READERS; i++ ) {
+    unsigned long a = __atomic_load_n( &((e->readers)[ i ].active), __ATOMIC_ACQUIRE );
+    if( ( a & 1 ) && ( a >> 1 ) != g ) {
+      return;
+    }
+  }
+  __atomic_store_n( &(e->global), g + 1, __ATOMIC_RELEASE );
+  _ull_reclaim( e );
+}
+
+// gives an object that was unlinked from the list back to its pool
+// (in concurrent mode once no reader can see it anymore)
+static void _ull_retire( ull * u, ullpool * pool, void * obj )
+{
+  ullepoch * e = u->epoch;
+  if( ! e ) {
+    _ull_pool_free( pool, obj );
+    return;
+  }
+  if( e->num_retired == e->max_retired ) {
+    size_t max = ( e->max_retired ? 2 * e->max_retired : 64 );
+    ullretired * r = realloc( e->retired, max * sizeof(ullretired) );
+    if( ! r ) {
+      return; // the object is not reused
+    }
+    e->retired = r;
+    e->max_retired = max;
+  }
+  (e->retired)[ e->num_retired ].obj = obj;
+  (e->retired)[ e->num_retired ].pool = pool;
+  (e->retired)[ e->num_retired ].epoch = e->global;
+  e->num_retired ++;
+  _ull_try_advance( e );
+}
+
+// seqlock write section of a node or index node (only in concurrent mode)
+static void _ull_write_begin( ull * u, unsigned int * version )
+{
+  if( u->epoch ) {
+    __atomic_store_n( version, *version + 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+  }
+}
+
+static void _ull_write_end( ull * u, unsigned int * version )
+{
+  if( u->epoch ) {
+    __atomic_store_n( version, *version + 1, __ATOMIC_RELEASE );
+  }
+}
+
+// marks an unlinked node or index node for readers that still see it
+static void _ull_write_dead( ull * u, unsigned int * version, int * dead )
+{
+  _ull_write_begin( u, version );
+  *dead = 1;
+  _ull_write_end( u, version );
+}
+
+// dirty node tracking (see ull_set_checkpointing())
+typedef struct _ullcheckpoint {
+  // nodes modified since the last checkpoint (ullnode.dirty is the position + 1)
+  ullnode * * dirty;
+  size_t num_dirty;
+  size_t max_dirty;
+  // ids of the nodes removed since the last checkpoint
+  uint64_t * freed;
+  size_t num_freed;
+  size_t max_freed;
+  // the next checkpoint writes all nodes (first checkpoint, after ull_remove_all()
+  // or when the lists above could not grow)
+  int full;
+  uint64_t seq;
+}
+ullcheckpoint;
+
+static void _ull_node_dirty( ull * u, ullnode * n )
+{
+  ullcheckpoint * c = u->checkpoint;
+  if( c && ! n->dirty && ! c->full ) {
+    if( c->num_dirty == c->max_dirty ) {
+      size_t max = ( c->max_dirty ? 2 * c->max_dirty : 64 );
+      ullnode * * d = realloc( c->dirty, max * sizeof(ullnode*) );
+      if( ! d ) {
+        c->full = 1;
+        return;
+      }
+      c->dirty = d;
+      c->max_dirty = max;
+    }
+    (c->dirty)[ c->num_dirty ] = n;
+    c->num_dirty ++;
+    n->dirty = c->num_dirty;
+  }
+}
+
+static void _ull_node_freed( ull * u, ullnode * n )
+{
+  ullcheckpoint * c = u->checkpoint;
+  if( c ) {
+    if( n->dirty ) {
+      // the last dirty node takes its place
+      ullnode * last = (c->dirty)[ c->num_dirty - 1 ];
+      (c->dirty)[ n->dirty - 1 ] = last;
+      last->dirty = n->dirty;
+      c->num_dirty --;
+      n->dirty = 0;
+    }
+    if( ! c->full ) {
+      if( c->num_freed == c->max_freed ) {
+        size_t max = ( c->max_freed ? 2 * c->max_freed : 64 );
+        uint64_t * f = realloc( c->freed, max * sizeof(uint64_t) );
+        if( ! f ) {
+          c->full = 1;
+          return;
+        }
+        c->freed = f;
+        c->max_freed = max;
+      }
+      (c->freed)[ c->num_freed ] = n->id;
+      c->num_freed ++;
+    }
+  }
+}
+
+// forgets all dirty nodes (after a checkpoint or a save)
+static void _ull_checkpoint_clear( ull * u )
+{
+  ullcheckpoint * c = u->checkpoint;
+  size_t i = 0;
+  for( i = 0; i < c->num_dirty; i++ ) {
+    (c->dirty)[ i ]->dirty = 0;
+  }
+  c->num_dirty = 0;
+  c->num_freed = 0;
+  c->full = 0;
+}
+
+// starts modifying node n: a write section in concurrent mode and marks n dirty
+static void _ull_node_write_begin( ull * u, ullnode * n )
+{
+  _ull_node_dirty( u, n );
+  _ull_write_begin( u, &(n->version) );
+}
+
+// aggregates (see ull_set_aggregate()): adds the aggregate of elements from to to - 1
+// of node n to out (have: out already holds elements)
+static void _ull_agg_elements( ull * u, ullnode * n, size_t from, size_t to, void * out, int * have )
+{
+  uint64_t tmp [ ULL_AGGREGATE_MAX_STATE / sizeof(uint64_t) ];
+  size_t i = 0;
+  for( i = from; i < to; i++ ) {
+    const void * value = ( u->valuesize ? ULL_NODE_VALUE( u, n, i ) : 0 );
+    if( *have ) {
+      (u->aggregate->lift)( u, tmp, ULL_NODE_KEY( u, n, i ), value );
+      (u->aggregate->combine)( u, out, tmp );
+    }
+    else {
+      (u->aggregate->lift)( u, out, ULL_NODE_KEY( u, n, i ), value );
+      *have = 1;
+    }
+  }
+}
+
+// adds the aggregate state to out
+static void _ull_agg_add( ull * u, const void * state, void * out, int * have )
+{
+  if( *have ) {
+    (u->aggregate->combine)( u, out, state );
+  }
+  else {
+    memcpy( out, state, u->aggregate->statesize );
+    *have = 1;
+  }
+}
+
+// recomputes the aggregate of index node p from its children
+// (nodes that are empty for the moment are left out)
+static void _ull_agg_index( ull * u, ullindex * p )
+{
+  size_t i = 0;
+  int have = 0;
+  for( i = 0; i < p->num_children; i++ ) {
+    if( ! p->leaves ) {
+      _ull_agg_add( u, ULL_INDEX_AGG( u, (p->children)[ i ] ), ULL_INDEX_AGG( u, p ), &have );
+    }
+    else if( ((ullnode*)((p->children)[ i ]))->num_elements > 0 ) {
+      _ull_agg_add( u, ULL_NODE_AGG( u, (p->children)[ i ] ), ULL_INDEX_AGG( u, p ), &have );
+    }
+  }
+}
+
+// recomputes the aggregates of index node p and all index nodes above it
+static void _ull_agg_up( ull * u, ullindex * p )
+{
+  if( u->aggregate ) {
+    for( ; p; p = p->parent ) {
+      _ull_agg_index( u, p );
+    }
+  }
+}
+
+// ends modifying node n: recomputes its aggregate and the ones above it
+// -> O(elements per node + index height * index fanout) if the list has an aggregate
+static void _ull_node_write_end( ull * u, ullnode * n )
+{
+  _ull_write_end( u, &(n->version) );
+  if( u->aggregate ) {
+    int have = 0;
+    _ull_agg_elements( u, n, 0, n->num_elements, ULL_NODE_AGG( u, n ), &have );
+    _ull_agg_up( u, n->parent );
+  }
+}
+
+// waits until the writer is not modifying the object and returns its version
+static unsigned int _ull_read_begin( unsigned int * version )
+{
+  unsigned int v = 0;
+  int spins = 0;
+  while( ( v = __atomic_load_n( version, __ATOMIC_ACQUIRE ) ) & 1 ) {
+    if( ++spins == 100 ) {
+      sched_yield();
+      spins = 0;
+    }
+  }
+  return v;
+}
+
+// whether the object was not modified since _ull_read_begin() returned v
+static int _ull_read_validate( unsigned int * version, unsigned int v )
+{
+  __atomic_thread_fence( __ATOMIC_ACQUIRE );
+  return ( __atomic_load_n( version, __ATOMIC_RELAXED ) == v );
+}
+
+// computes the layout of nodes and index nodes:
+// keys follow the headers, starting at a cache line boundary
+static void _ull_layout( ull * u )
+{
+  u->node_keys_offset = _ull_align( sizeof(ullnode) );
+  u->node_values_offset = _ull_align( u->node_keys_offset + u->capacity * u->keysize );
+  u->node_agg_offset = _ull_align( u->node_values_offset + u->capacity * u->valuesize );
+  u->node_size = _ull_align( u->node_agg_offset + ( u->aggregate ? u->aggregate->statesize : 0 ) );
+  if( u->packed ) {
+    // packed lists: the first key, the width of the deltas and the deltas (plus their padding)
+    u->node_packed_offset = u->node_keys_offset + u->keysize + 1;
+    u->node_packed_bytes = u->capacity * u->keysize / ULL_PACKED_RATIO;
+    u->node_size = _ull_align( u->node_packed_offset + u->node_packed_bytes + sizeof(uint64_t) );
+  }
+  u->index_firsts_offset = _ull_align( sizeof(ullindex) );
+  u->index_agg_offset = _ull_align( u->index_firsts_offset + ULL_INDEX_FANOUT * u->keysize );
+  u->index_size = _ull_align( u->index_agg_offset + ( u->aggregate ? u->aggregate->statesize : 0 ) );
+}
+
+// inits a list whose nodes store keys by value using given key operations
+// -> given dynmem is used like with ull_init()
+// -> elements passed to and returned by the ull_* functions are pointers to keys
+int ull_init_keys( ull * u, dynmem * m, const ullkeyops * ops )
+{
+  if( ULL_ELEMENTS_PER_NODE < 2 ) {
+    // number of elements per node must be at least 2 to ensure logic
+    return 0;
+  }
+  if( u && m && ops && ops->keysize > 0 ) {
+    u->root = 0;
+    u->tail = 0;
+    u->index_root = 0;
+    u->index_height = 0;
+    u->num_elements = 0;
+    u->num_nodes = 0;
+    u->cmpfunc = 0;
+    u->abbrev = 0;
+    u->keyops = ops;
+    u->keysize = ops->keysize;
+    u->byvalue = 1;
+    u->valuesize = 0;
+    u->multiset = 0;
+    u->packed = 0;
+    u->aggregate = 0;
+    u->nodes_memory = m;
+    u->capacity = ULL_ELEMENTS_PER_NODE;
+    u->merge_threshold = ULL_MERGE_THRESHOLD;
+    u->split_fill = ULL_SPLIT_FILL;
+    u->split_ratio = ULL_SPLIT_RATIO;
+    u->split_append = 1;
+    u->epoch = 0;
+    u->node_gen = 0;
+    ull_finger_init( &(u->finger) );
+    u->mapping = 0;
+    u->mapping_size = 0;
+    u->next_node_id = 0;
+    u->checkpoint = 0;
+    memset( &(u->stats), 0, sizeof(ullstats) );
+    _ull_layout( u );
+    dynmem_init( &(u->index_memory), sizeof(void*) );
+    if( _ull_pool_init( &(u->nodes), m, u->node_size ) &&
+        _ull_pool_init( &(u->index_nodes), &(u->index_memory), u->index_size ) ) {
+      u->nodes.stats = &(u->stats);
+      u->index_nodes.stats = &(u->stats);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// inits the list
+// -> given dynmem must be initialized (see dynmem_init()), it holds the slab table of the
+//    node pool (its element size and content are reset), the node slabs come from its
+//    allocator backend (set before or after ull_init(), while the list has no nodes)
+// -> the list stores element pointers that are ordered by given compare function
+int ull_init( ull * u, dynmem * m, ullcmpfunc f )
+{
+  if( f && ull_init_keys( u, m, _ull_ptr_keyops() ) ) {
+    u->cmpfunc = f;
+    u->byvalue = 0;
+    return 1;
+  }
+  return 0;
+}
+
+// inits a list like ull_init() whose nodes also store an abbreviation of each
+// element next to its pointer: comparisons look at the abbreviations first and only
+// call the cmpfunc if they are equal, so most comparisons do not touch the elements
+// -> abbrev must agree with f: a before b if abbrev( a ) < abbrev( b ), and equal
+//    elements must have equal abbreviations (e.g. ull_abbrev_str() for strcmp())
+// -> elements are stored as ullabbrevkey (16 bytes instead of 8), which is what
+//    ull_next_span(), ull_insert_batch() and ull_build_from_sorted() see
+int ull_init_abbrev( ull * u, dynmem * m, ullcmpfunc f, ullabbrevfunc abbrev )
+{
+  if( f && abbrev && ull_init_keys( u, m, _ull_abbrev_keyops() ) ) {
+    u->cmpfunc = f;
+    u->abbrev = abbrev;
+    u->byvalue = 0;
+    return 1;
+  }
+  return 0;
+}
+
+// abbreviation of a NUL-terminated string for strcmp(): its first 8 bytes
+// as a big endian integer (padded with zeros)
+uint64_t ull_abbrev_str( void * s )
+{
+  const unsigned char * c = (const unsigned char *)s;
+  uint64_t a = 0;
+  size_t i = 0;
+  for( i = 0; i < 8; i++ ) {
+    a = ( a << 8 ) | *c;
+    c += ( *c != 0 );
+  }
+  return a;
+}
+
+// inits a map list: like ull_init_keys(), but every node also stores a value of
+// valuesize bytes per key (in an array after its keys), so no separate allocation
+// per element is needed
+// -> keys are unique: elements are added or updated with ull_upsert() and looked up with
+//    ull_find() or ull_get_nearest_value(), removals and lookups of keys work as for
+//    other lists
+// -> ull_insert(), ull_insert_batch(), ull_build_from_sorted(), ull_save() and
+//    checkpoints are not supported, concurrent readers only read the keys
+int ull_init_map( ull * u, dynmem * m, const ullkeyops * ops, size_t valuesize )
+{
+  if( valuesize > 0 && ull_init_keys( u, m, ops ) ) {
+    u->valuesize = valuesize;
+    _ull_layout( u );
+    u->nodes.objsize = u->node_size;
+    return 1;
+  }
+  return 0;
+}
+
+// sets the max number of elements per node (only while the list is empty)
+// -> e.g. size nodes to 4-16 cache lines: capacity = lines * ULL_CACHE_LINE / keysize
+int ull_set_node_capacity( ull * u, size_t capacity )
+{
+  if( u && capacity >= 2 && u->num_nodes == 0 && ! u->mapping &&
+      ( ! u->packed || capacity <= ULL_PACKED_MAX_CAPACITY ) ) {
+    _ull_pool_release( &(u->nodes) );
+    _ull_pool_release( &(u->index_nodes) );
+    u->capacity = capacity;
+    _ull_layout( u );
+    u->nodes.objsize = u->node_size;
+    u->index_nodes.objsize = u->index_size;
+    return 1;
+  }
+  return 0;
+}
+
+// sets the fill (fraction of the node capacity) below which nodes are refilled
+// from a neighbour after removals (0 only drops nodes that become empty)
+// -> at most 0.5, so that a merged node never has to be split again
+int ull_set_merge_threshold( ull * u, double fill )
+{
+  if( u && fill >= 0.0 && fill <= 0.5 ) {
+    u->merge_threshold = fill;
+    return 1;
+  }
+  return 0;
+}
+
+// sets when and how nodes are split on insert:
+// -> nodes are split when they hold more than fill (fraction of the capacity, at most
+//    capacity - 1 elements), the old node keeps ratio of the elements
+// -> with append set, a key after the last key of a full last node starts a new node
+//    instead of splitting it (monotonic keys then fill the nodes up to fill, not to
+//    fill * ratio)
+int ull_set_split_policy( ull * u, double fill, double ratio, int append )
+{
+  if( u && fill > 0.0 && fill <= 1.0 && ratio > 0.0 && ratio < 1.0 ) {
+    u->split_fill = fill;
+    u->split_ratio = ratio;
+    u->split_append = append;
+    return 1;
+  }
+  return 0;
+}
+
+// switches the multiset mode on or off (only while the list is empty, not for map lists):
+// equal elements are stored once (the first one inserted) with a count of how often
+// they were inserted, so memory and lookups grow with the number of distinct elements
+// -> ull_insert() adds one to the count, ull_remove() takes one off (and removes the
+//    element at 0), ull_count() returns it
+// -> sizes, positions and ranks (ull_size(), ull_get(), ull_rank(), cursors) count the
+//    distinct elements, ull_remove_range() removes them with all their counts
+// -> like map lists, multisets can not be bulk loaded, saved or checkpointed
+int ull_set_multiset( ull * u, int enable )
+{
+  if( u && u->num_nodes == 0 && ! u->mapping && ! u->packed && ( ! u->valuesize || u->multiset ) ) {
+    _ull_pool_release( &(u->nodes) );
+    u->multiset = ( enable != 0 );
+    u->valuesize = ( enable ? sizeof(uint64_t) : 0 );
+    _ull_layout( u );
+    u->nodes.objsize = u->node_size;
+    return 1;
+  }
+  return 0;
+}
+
+// switches the packed mode on or off (only while the list is empty, for lists of 32/64 bit
+// integers created with ull_keyops_i32() or ull_keyops_i64()): every node stores its first
+// key and the differences of its keys to it, bit-packed with the fewest bits the node needs
+// (chosen whenever the node is written, e.g. when it is split or built)
+// -> the deltas of a node take at most capacity * keysize / ULL_PACKED_RATIO bytes, a node
+//    holds at most the max fill of keys and only as many as fit, so keys that are close
+//    to their neighbours (ids, timestamps) take a fraction of their size
+// -> lookups narrow a node down by binary search steps on single deltas and unpack a window
+//    of keys with the SIMD unpack kernel (AVX2) for the search kernel
+// -> the nodes hold no keys to point to: ull_get_nearest(), ull_get(), ull_next(),
+//    ull_prev() and ull_next_span() fail, ull_get_nearest_key(), ull_get_key(),
+//    ull_next_key() and ull_prev_key() copy the keys (the typed lists use those)
+// -> ull_insert_batch() and ull_remove_range() handle one key at a time; like map lists,
+//    packed lists can not be saved, checkpointed, split, concatenated or merged, and
+//    they have no aggregates and no concurrent mode
+int ull_set_packed( ull * u, int enable )
+{
+  if( u && u->num_nodes == 0 && u->byvalue && ! u->mapping && ! u->valuesize && ! u->aggregate &&
+      ! u->epoch && ! u->checkpoint && ( ! enable || ( u->capacity <= ULL_PACKED_MAX_CAPACITY &&
+      ( u->keyops == ull_keyops_i32() || u->keyops == ull_keyops_i64() ) ) ) ) {
+    _ull_pool_release( &(u->nodes) );
+    u->packed = ( enable != 0 );
+    _ull_layout( u );
+    u->nodes.objsize = u->node_size;
+    return 1;
+  }
+  return 0;
+}
+
+// sets the aggregate that the nodes and index nodes keep (only while the list is empty,
+// 0 removes it), so ull_range_aggregate() reads whole nodes and subtrees instead of
+// visiting their elements
+// -> every modification of a node recomputes the aggregate of the node and of the index
+//    nodes above it: O(elements per node + index height * index fanout) per insert or removal
+// -> statesize is at most ULL_AGGREGATE_MAX_STATE, the state is stored after the values
+//    of a node and after the first keys of an index node
+// -> values changed in place (through the pointer of ull_find()) are not seen, use ull_upsert(),
+//    lists with an aggregate can not be saved
+int ull_set_aggregate( ull * u, const ullaggregate * agg )
+{
+  if( u && u->num_nodes == 0 && ! u->mapping && ! u->packed &&
+      ( ! agg || ( agg->lift && agg->combine && agg->statesize > 0 && agg->statesize <= ULL_AGGREGATE_MAX_STATE ) ) ) {
+    _ull_pool_release( &(u->nodes) );
+    _ull_pool_release( &(u->index_nodes) );
+    u->aggregate = agg;
+    _ull_layout( u );
+    u->nodes.objsize = u->node_size;
+    u->index_nodes.objsize = u->index_size;
+    return 1;
+  }
+  return 0;
+}
+
+// switches the concurrent mode on or off: while it is on, one writer thread may
+// insert and remove elements while reader threads look up elements with ull_read_nearest()
+// -> only the writer may call the other ull_* functions, and ull_remove_all(),
+//    ull_build_from_sorted() and ull_set_node_capacity() need the readers to be stopped
+// -> in lists created with ull_init() the elements are compared by readers while the writer
+//    removes them, so removed elements must stay valid until the readers are stopped
+// -> may only be switched while no other thread uses the list
+int ull_set_concurrent( ull * u, int enable )
+{
+  if( u && ! u->mapping && ( ! enable || ! u->packed ) ) {
+    if( enable && ! u->epoch ) {
+      void * e = 0;
+      if( posix_memalign( &e, ULL_CACHE_LINE, sizeof(ullepoch) ) != 0 ) {
+        return 0;
+      }
+      memset( e, 0, sizeof(ullepoch) );
+      u->epoch = e;
+    }
+    else if( ! enable && u->epoch ) {
+      // no reader is left -> all retired objects can be reused
+      u->epoch->global += 2;
+      _ull_reclaim( u->epoch );
+      free( u->epoch->retired );
+      free( u->epoch );
+      u->epoch = 0;
+    }
+    return 1;
+  }
+  return 0;
+}
+
+// registers the calling thread as reader of a list in concurrent mode
+// (returns 0 if there are ULL_MAX_READERS readers already)
+int ull_reader_init( ullreader * r, ull * u )
+{
+  if( r && u && u->epoch ) {
+    size_t i = 0;
+    for( i = 0; i < ULL_MAX_READERS; i++ ) {
+      int unused = 0;
+      if( __atomic_compare_exchange_n( &((u->epoch->readers)[ i ].used), &unused, 1, 0,
+          __ATOMIC_ACQ_REL, __ATOMIC_RELAXED ) ) {
+        r->u = u;
+        r->slot = i;
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+void ull_reader_release( ullreader * r )
+{
+  if( r && r->u && r->u->epoch ) {
+    __atomic_store_n( &((r->u->epoch->readers)[ r->slot ].used), 0, __ATOMIC_RELEASE );
+    r->u = 0;
+  }
+}
+
+// the i-th element of a node as seen by the user
+// (the stored pointer or the address of the stored key)
+void * _ull_node_element( ull * u, ullnode * n, size_t i )
+{
+  void * key = ULL_NODE_KEY( u, n, i );
+  return ( u->byvalue ? key : *((void**)key) );
+}
+
+void ull_debug( ull * u, ulldebugfunc f )
+{
+  if( u ) {
+    ullnode * n = u->root;
+    int i = 0;
+    printf("<ull nodes_memory %s, root %s, num_nodes %ld, index_height %ld\n",
+      (u->nodes_memory == NULL ? "NULL" : "DEF"), 
+      (u->root == NULL ? "NULL" : "DEF"), u->num_nodes, u->index_height);
+    printf("  memory: ");
+      dynmem_debug( u->nodes_memory );
+    while( n ) {
+      printf("  <ullnode %4d, prev %s, next %s, num_elements %ld / %ld>\n",
+        i,
+        (n->prev == NULL ? "NULL" : "DEF"),
+        (n->next == NULL ? "NULL" : "DEF"),
+        n->num_elements, u->capacity );
+      if( f ) {
+        size_t j = 0;
+        for( j = 0; j < n->num_elements; j++ ) {
+          int64_t k = 0;
+          printf("    [  %4ld] ", j);
+          if( u->packed ) {
+            // (the key unpacked)
+            _ull_node_copy( u, n, j, &k );
+            f( &k );
+          }
+          else {
+            f( _ull_node_element( u, n, j ) );
+          }
+        }
+        if( n->num_elements < u->capacity ) {
+          printf("    [..%4ld] not set\n", u->capacity - 1 );
+        }
+      }
+      n = ULL_NEXT( u, n );
+      i++;
+    }
+    printf(">\n");  
+  }
+  else {
+    printf("<NULL>");
+  }
+}
+
+int _ull_insert_new_node( ull * u, ullnode * prev, ullnode * next, ullnode * * new )
+{
+  if( u && new ) {
+    // nodes come from the pool, so they never move once allocated
+    ullnode * newnode = _ull_pool_alloc( &(u->nodes) );
+    if( newnode ) {
+			// init node (the caller puts it into the index)
+			// -> in concurrent mode the node is linked inside a write section
+			//    that the caller ends after filling it
+			newnode->parent = 0;
+			newnode->version = 0;
+			newnode->dead = 0;
+			newnode->id = u->next_node_id ++;
+			newnode->dirty = 0;
+			_ull_node_write_begin( u, newnode );
+			newnode->prev = ( prev ? prev : 0 );
+			newnode->next = ( next ? next : 0 );
+			if( prev ) { // let previous node point to new node
+				ULL_STORE( prev->next, newnode );
+			}
+			if( next ) { // let new node point to next node
+				ULL_STORE( next->prev, newnode );
+			}
+			else {
+				u->tail = newnode;
+			}
+			newnode->num_elements = 0;
+			// inc total node counter
+			u->num_nodes ++;
+      ULL_STAT_ADD( &(u->stats), node_allocs, 1 );
+			// result
+			*new = newnode;
+			return 1;
+    }
+  }
+  return 0;
+}
+
+// unlinks the node from the list and returns it to the pool for reuse
+void _ull_remove_node( ull * u, ullnode * n )
+{
+  if( u && n ) {
+    _ull_write_dead( u, &(n->version), &(n->dead) );
+    _ull_node_freed( u, n );
+    if( n->prev ) {
+      ULL_STORE( n->prev->next, n->next );
+    }
+    else {
+      u->root = n->next;
+    }
+    if( n->next ) {
+      ULL_STORE( n->next->prev, n->prev );
+    }
+    else {
+      u->tail = n->prev;
+    }
+    _ull_index_remove( u, n );
+    u->num_nodes --;
+    u->node_gen ++;
+    ULL_STAT_ADD( &(u->stats), node_frees, 1 );
+    _ull_retire( u, &(u->nodes), n );
+  }
+}
+
+// takes an index node from the pool
+static ullindex * _ull_index_alloc( ull * u )
+{
+  ullindex * p = _ull_pool_alloc( &(u->index_nodes) );
+  if( p ) {
+    ULL_STAT_ADD( &(u->stats), index_allocs, 1 );
+    p->version = 0;
+    p->dead = 0;
+  }
+  return p;
+}
+
+// returns the position of given child inside the index node
+size_t _ull_index_child_pos( ullindex * p, void * child )
+{
+  size_t i = 0;
+  while( i < p->num_children && (p->children)[ i ] != child ) {
+    i++;
+  }
+  return i;
+}
+
+// lets the i-th child of given index node point back to it
+static void _ull_index_adopt( ullindex * p, size_t i )
+{
+  if( p->leaves ) {
+    ((ullnode*)((p->children)[ i ]))->parent = p;
+  }
+  else {
+    ((ullindex*)((p->children)[ i ]))->parent = p;
+  }
+}
+
+// sets the first key of given child of p and passes it up while the
+// child is the first child of its index node
+static void _ull_index_set_first( ull * u, ullindex * p, void * child, const void * first )
+{
+  while( p ) {
+    size_t i = _ull_index_child_pos( p, child );
+    _ull_write_begin( u, &(p->version) );
+    memcpy( ULL_INDEX_FIRST( u, p, i ), first, u->keysize );
+    _ull_write_end( u, &(p->version) );
+    if( i != 0 ) {
+      break;
+    }
+    child = p;
+    p = p->parent;
+  }
+}
+
+// adds delta to the element count of given child of p and of all subtrees above it
+static void _ull_index_add_child_count( ullindex * p, void * child, ptrdiff_t delta )
+{
+  while( p ) {
+    (p->counts)[ _ull_index_child_pos( p, child ) ] += delta;
+    child = p;
+    p = p->parent;
+  }
+}
+
+// number of elements in the subtree of index node p
+static size_t _ull_index_total( ullindex * p )
+{
+  size_t i = 0, total = 0;
+  for( i = 0; i < p->num_children; i++ ) {
+    total += (p->counts)[ i ];
+  }
+  return total;
+}
+
+// inserts a child holding count elements at given position of index node p
+// (splits p if it is full)
+static int _ull_index_insert_child( ull * u, ullindex * p, size_t pos, void * child, const void * first, size_t count )
+{
+  if( p->num_children == ULL_INDEX_FANOUT ) {
+    // full -> move upper half of children into a new index node after p
+    size_t half = ULL_INDEX_FANOUT / 2;
+    size_t i = 0;
+    ullindex * q = _ull_index_alloc( u );
+    if( ! q ) {
+      return 0;
+    }
+    q->leaves = p->leaves;
+    q->num_children = ULL_INDEX_FANOUT - half;
+    memcpy( ULL_INDEX_FIRST( u, q, 0 ), ULL_INDEX_FIRST( u, p, half ), q->num_children * u->keysize );
+    memcpy( q->children, p->children + half, q->num_children * sizeof(void*) );
+    memcpy( q->counts, p->counts + half, q->num_children * sizeof(size_t) );
+    for( i = 0; i < q->num_children; i++ ) {
+      _ull_index_adopt( q, i );
+    }
+    // (until q is linked into the index, readers that need its children
+    //  are guided to the last child of p and move along the node chain)
+    _ull_write_begin( u, &(p->version) );
+    p->num_children = half;
+    _ull_write_end( u, &(p->version) );
+    if( u->aggregate ) {
+      _ull_agg_index( u, p );
+      _ull_agg_index( u, q );
+    }
+    if( p->parent ) {
+      // the elements of q move from p's count to q's own count in the parent
+      size_t qtotal = _ull_index_total( q );
+      _ull_index_add_child_count( p->parent, p, -(ptrdiff_t)qtotal );
+      q->parent = 0;
+      if( ! _ull_index_insert_child( u, p->parent,
+          _ull_index_child_pos( p->parent, p ) + 1, q, ULL_INDEX_FIRST( u, q, 0 ), qtotal ) ) {
+        return 0;
+      }
+    }
+    else {
+      // p was the index root -> grow the index by one level
+      ullindex * r = _ull_index_alloc( u );
+      if( ! r ) {
+        return 0;
+      }
+      r->parent = 0;
+      r->leaves = 0;
+      r->num_children = 2;
+      memcpy( ULL_INDEX_FIRST( u, r, 0 ), ULL_INDEX_FIRST( u, p, 0 ), u->keysize );
+      (r->children)[ 0 ] = p;
+      (r->counts)[ 0 ] = _ull_index_total( p );
+      memcpy( ULL_INDEX_FIRST( u, r, 1 ), ULL_INDEX_FIRST( u, q, 0 ), u->keysize );
+      (r->children)[ 1 ] = q;
+      (r->counts)[ 1 ] = _ull_index_total( q );
+      p->parent = r;
+      q->parent = r;
+      ULL_STORE( u->index_root, r );
+      u->index_height ++;
+    }
+    // continue with the half that receives the child
+    if( pos > half ) {
+      p = q;
+      pos -= half;
+    }
+  }
+  // shift children after pos one up
+  _ull_write_begin( u, &(p->version) );
+  memmove( ULL_INDEX_FIRST( u, p, pos + 1 ), ULL_INDEX_FIRST( u, p, pos ), ( p->num_children - pos ) * u->keysize );
+  memmove( p->children + pos + 1, p->children + pos, ( p->num_children - pos ) * sizeof(void*) );
+  memmove( p->counts + pos + 1, p->counts + pos, ( p->num_children - pos ) * sizeof(size_t) );
+  memcpy( ULL_INDEX_FIRST( u, p, pos ), first, u->keysize );
+  (p->children)[ pos ] = child;
+  (p->counts)[ pos ] = count;
+  p->num_children ++;
+  _ull_write_end( u, &(p->version) );
+  _ull_index_adopt( p, pos );
+  _ull_index_add_child_count( p->parent, p, (ptrdiff_t)count );
+  if( pos == 0 ) {
+    _ull_index_set_first( u, p->parent, p, first );
+  }
+  _ull_agg_up( u, p );
+  return 1;
+}
+
+// puts the new node into the index right after node n
+// -> the new node must already hold its elements
+int _ull_index_insert_after( ull * u, ullnode * n, ullnode * new )
+{
+  ullindex * p = n->parent;
+  return _ull_index_insert_child( u, p, _ull_index_child_pos( p, n ) + 1, new,
+    ULL_NODE_KEY( u, new, 0 ), new->num_elements );
+}
+
+// must be called when the first element of node n changed
+void _ull_index_update_first( ull * u, ullnode * n )
+{
+  if( n->num_elements > 0 ) {
+    _ull_index_set_first( u, n->parent, n, ULL_NODE_KEY( u, n, 0 ) );
+  }
+}
+
+// must be called when the number of elements of node n changed by delta
+void _ull_index_add_count( ull * u, ullnode * n, ptrdiff_t delta )
+{
+  _ull_index_add_child_count( n->parent, n, delta );
+}
+
+// shrinks the index while the root has a single index node child
+static void _ull_index_shrink( ull * u )
+{
+  while( u->index_root && ! u->index_root->leaves && u->index_root->num_children == 1 ) {
+    ullindex * r = u->index_root;
+    ((ullindex*)((r->children)[ 0 ]))->parent = 0;
+    ULL_STORE( u->index_root, (ullindex*)((r->children)[ 0 ]) );
+    u->index_height --;
+    _ull_write_dead( u, &(r->version), &(r->dead) );
+    _ull_retire( u, &(u->index_nodes), r );
+  }
+}
+
+// removes node n from the index (index nodes that become empty are removed too)
+// -> the elements n is counted with are subtracted from the subtrees above it
+void _ull_index_remove( ull * u, ullnode * n )
+{
+  void * child = n;
+  ullindex * p = n->parent;
+  while( p ) {
+    size_t i = _ull_index_child_pos( p, child );
+    size_t count = (p->counts)[ i ];
+    _ull_write_begin( u, &(p->version) );
+    memmove( ULL_INDEX_FIRST( u, p, i ), ULL_INDEX_FIRST( u, p, i + 1 ), ( p->num_children - i - 1 ) * u->keysize );
+    memmove( p->children + i, p->children + i + 1, ( p->num_children - i - 1 ) * sizeof(void*) );
+    memmove( p->counts + i, p->counts + i + 1, ( p->num_children - i - 1 ) * sizeof(size_t) );
+    p->num_children --;
+    p->dead = ( p->num_children == 0 );
+    _ull_write_end( u, &(p->version) );
+    if( p->num_children > 0 ) {
+      _ull_index_add_child_count( p->parent, p, -(ptrdiff_t)count );
+      if( i == 0 ) {
+        _ull_index_set_first( u, p->parent, p, ULL_INDEX_FIRST( u, p, 0 ) );
+      }
+      _ull_agg_up( u, p );
+      break;
+    }
+    else {
+      // index node is empty now -> remove it from its parent as well
+      ullindex * pp = p->parent;
+      if( ! pp ) {
+        ULL_STORE( u->index_root, (ullindex*)0 );
+        u->index_height = 0;
+      }
+      child = p;
+      _ull_retire( u, &(u->index_nodes), p );
+      p = pp;
+    }
+  }
+  _ull_index_shrink( u );
+}
+
+
+// packed lists (see ull_set_packed()): a key as 64 bit integer and back
+static int64_t _ull_packed_key( ull * u, const void * key )
+{
+  if( u->keysize == 4 ) {
+    int32_t k = 0;
+    memcpy( &k, key, sizeof(int32_t) );
+    return k;
+  }
+  else {
+    int64_t k = 0;
+    memcpy( &k, key, sizeof(int64_t) );
+    return k;
+  }
+}
+
+static void _ull_packed_put( ull * u, int64_t k, void * key )
+{
+  if( u->keysize == 4 ) {
+    int32_t k32 = (int32_t)k;
+    memcpy( key, &k32, sizeof(int32_t) );
+  }
+  else {
+    memcpy( key, &k, sizeof(int64_t) );
+  }
+}
+
+// width and address of the deltas of a packed node (after its first key)
+#define ULL_PACKED_WIDTH( u, n ) ( *( (unsigned char*)(n) + (u)->node_keys_offset + (u)->keysize ) )
+#define ULL_PACKED_DELTAS( u, n ) ( (unsigned char*)(n) + (u)->node_packed_offset )
+// number of keys a search unpacks at once
+#define ULL_PACKED_WINDOW 16
+
+// unpacks the keys [from,from+num) of packed node n
+static void _ull_packed_decode( ull * u, ullnode * n, size_t from, size_t num, int64_t * keys )
+{
+  _ull_unpack( ULL_PACKED_DELTAS( u, n ), ULL_PACKED_WIDTH( u, n ), from, num,
+    _ull_packed_key( u, ULL_NODE_KEY( u, n, 0 ) ), keys );
+}
+
+// writes num sorted keys into packed node n
+static void _ull_packed_store( ull * u, ullnode * n, const int64_t * keys, size_t num )
+{
+  unsigned int w = _ull_pack_width( (uint64_t)(keys[ num - 1 ]) - (uint64_t)(keys[ 0 ]) );
+  _ull_packed_put( u, keys[ 0 ], ULL_NODE_KEY( u, n, 0 ) );
+  ULL_PACKED_WIDTH( u, n ) = (unsigned char)w;
+  _ull_pack_deltas( ULL_PACKED_DELTAS( u, n ), keys, num, w );
+  n->num_elements = num;
+}
+
+// number of the first of num sorted keys (at least 1, at most max) that fit into one packed node
+static size_t _ull_packed_fit( ull * u, const int64_t * keys, size_t num, size_t max )
+{
+  size_t bits = u->node_packed_bytes * 8, k = 1;
+  num = ( num < max ? num : max );
+  if( num * _ull_pack_width( (uint64_t)(keys[ num - 1 ]) - (uint64_t)(keys[ 0 ]) ) <= bits ) {
+    return num;
+  }
+  while( k < num && ( k + 1 ) * _ull_pack_width( (uint64_t)(keys[ k ]) - (uint64_t)(keys[ 0 ]) ) <= bits ) {
+    k ++;
+  }
+  return k;
+}
+
+// number of keys of packed node n before key (upper: not after key)
+// -> binary search steps on single deltas narrow the node down to a window of
+//    ULL_PACKED_WINDOW keys, which is unpacked and searched by the i64 search kernel
+static size_t _ull_packed_search( ull * u, ullnode * n, const void * key, int upper )
+{
+  const unsigned char * d = ULL_PACKED_DELTAS( u, n );
+  unsigned int w = ULL_PACKED_WIDTH( u, n );
+  int64_t first = _ull_packed_key( u, ULL_NODE_KEY( u, n, 0 ) );
+  int64_t k = _ull_packed_key( u, key );
+  int64_t window[ ULL_PACKED_WINDOW ];
+  size_t num = n->num_elements, base = 0;
+  uint64_t t = 0;
+  if( num == 0 || k < first || ( ! upper && k == first ) ) {
+    return 0;
+  }
+  // (deltas are unsigned: k - first is the delta k would have)
+  t = (uint64_t)k - (uint64_t)first;
+  while( num > ULL_PACKED_WINDOW ) {
+    size_t half = num / 2;
+    uint64_t x = _ull_pack_delta( d, w, base + half );
+    base = ( ( upper ? x <= t : x < t ) ? base + half : base );
+    num -= half;
+  }
+  _ull_unpack( d, w, base, num, first, window );
+  ULL_STAT_ADD( &(u->stats), searches, 1 );
+  return base + (ull_keyops_i64()->search)( u, window, num, &k, upper );
+}
+
+// position of the first element of the node that is not before key
+size_t _ull_node_lower_bound( ull * u, ullnode * n, const void * key )
+{
+  if( u->packed ) {
+    return _ull_packed_search( u, n, key, 0 );
+  }
+  return _ull_search( u, ULL_NODE_KEY( u, n, 0 ), n->num_elements, key, 0 );
+}
+
+// position of the first element of the node that is after key
+size_t _ull_node_upper_bound( ull * u, ullnode * n, const void * key )
+{
+  if( u->packed ) {
+    return _ull_packed_search( u, n, key, 1 );
+  }
+  return _ull_search( u, ULL_NODE_KEY( u, n, 0 ), n->num_elements, key, 1 );
+}
+
+// whether the i-th element of node n equals key
+static int _ull_node_equals( ull * u, ullnode * n, size_t i, const void * key )
+{
+  if( u->packed ) {
+    int64_t k = 0;
+    _ull_packed_decode( u, n, i, 1, &k );
+    return ( k == _ull_packed_key( u, key ) );
+  }
+  return ( _ull_cmp( u, key, ULL_NODE_KEY( u, n, i ) ) == 0 );
+}
+
+// copies the i-th element of node n to out: the key of lists storing keys by value
+// (unpacked for packed lists), the element pointer otherwise
+void _ull_node_copy( ull * u, ullnode * n, size_t i, void * out )
+{
+  if( u->packed ) {
+    int64_t k = 0;
+    _ull_packed_decode( u, n, i, 1, &k );
+    _ull_packed_put( u, k, out );
+  }
+  else if( u->byvalue ) {
+    memcpy( out, ULL_NODE_KEY( u, n, i ), u->keysize );
+  }
+  else {
+    *((void**)out) = _ull_node_element( u, n, i );
+  }
+}
+
+// moves num keys (and their values) from position si of node src to position di of node dst
+// (the ranges may overlap if src is dst)
+static void _ull_node_move( ull * u, ullnode * dst, size_t di, ullnode * src, size_t si, size_t num )
+{
+  memmove( ULL_NODE_KEY( u, dst, di ), ULL_NODE_KEY( u, src, si ), num * u->keysize );
+  if( u->valuesize ) {
+    memmove( ULL_NODE_VALUE( u, dst, di ), ULL_NODE_VALUE( u, src, si ), num * u->valuesize );
+  }
+}
+
+// writes the key at position i of node n, its value (map lists and multisets)
+// is cleared until the caller sets it
+static void _ull_node_set_key( ull * u, ullnode * n, size_t i, const void * key )
+{
+  memcpy( ULL_NODE_KEY( u, n, i ), key, u->keysize );
+  if( u->valuesize ) {
+    memset( ULL_NODE_VALUE( u, n, i ), 0, u->valuesize );
+  }
+}
+
+int _ull_insert_node_element( ull * u, ullnode * n, size_t insert_at_index, const void * key )
+{
+  if( n ) {
+    _ull_node_write_begin( u, n );
+    // shift elements after insert pos one up
+    if( n->num_elements > insert_at_index ) {
+      _ull_node_move( u, n, insert_at_index + 1, n, insert_at_index, n->num_elements - insert_at_index );
+		}
+    // set at pos
+    _ull_node_set_key( u, n, insert_at_index, key );
+    n->num_elements ++;
+    _ull_node_write_end( u, n );
+    return 1;
+  }
+  return 0;
+}
+
+// max number of elements a node may hold without being split
+// (the split fill of the capacity, by default 80%, and always keep one empty slot)
+size_t _ull_max_fill( ull * u )
+{
+  size_t max = (size_t)( (double)(u->capacity) * u->split_fill );
+  max = ( max > u->capacity - 1 ? u->capacity - 1 : max );
+  return ( max < 1 ? 1 : max );
+}
+
+// min number of elements a node should hold (unless it is the only node)
+// -> never more than half the max fill: two neighbours below it always fit into one node
+size_t _ull_min_fill( ull * u )
+{
+  size_t min = (size_t)( (double)(u->capacity) * u->merge_threshold );
+  size_t max = _ull_max_fill( u ) / 2;
+  return ( min > max ? max : min );
+}
+
+// packed lists: inserts the key after all equal keys of its node, which is split into as
+// many nodes as its keys need once they exceed the max fill or do not fit packed
+// (the node keeps the split ratio of its keys if that many fit)
+static int _ull_packed_insert_key( ull * u, const void * key, ullnode * from, ullnode * * at )
+{
+  int64_t keys[ ULL_PACKED_MAX_CAPACITY + 1 ];
+  int64_t k = _ull_packed_key( u, key );
+  ullnode * n = 0, * prev = 0;
+  size_t num = 0, i = 0, keep = 0, pos = 0, max = _ull_max_fill( u );
+  int res = 1;
+  if( u->num_nodes == 0 ) {
+    // first node, indexed by a single index node
+    if( ! _ull_insert_new_node( u, 0, 0, &n ) ) {
+      return 0;
+    }
+    _ull_packed_store( u, n, &k, 1 );
+    _ull_node_write_end( u, n );
+    u->root = n;
+    u->num_elements = 1;
+    if( at ) {
+      *at = n;
+    }
+    return _ull_index_build( u, 1.0 );
+  }
+  if( ! _ull_get_node_including_key_from( u, from, key, &n ) || ! n ) {
+    return 0;
+  }
+  num = n->num_elements;
+  i = _ull_packed_search( u, n, key, 1 );
+  _ull_packed_decode( u, n, 0, num, keys );
+  memmove( keys + i + 1, keys + i, ( num - i ) * sizeof(int64_t) );
+  keys[ i ] = k;
+  num ++;
+  keep = _ull_packed_fit( u, keys, num, max );
+  if( keep < num ) {
+    // all but the new key stay if it is appended to the last node
+    size_t ratio = ( i + 1 == num && ! n->next && u->split_append ?
+      num - 1 : (size_t)( (double)num * u->split_ratio + 0.5 ) );
+    ratio = ( ratio < 1 ? 1 : ( ratio > num - 1 ? num - 1 : ratio ) );
+    keep = ( keep < ratio ? keep : ratio );
+  }
+  _ull_node_write_begin( u, n );
+  _ull_packed_store( u, n, keys, keep );
+  _ull_node_write_end( u, n );
+  _ull_index_add_count( u, n, (ptrdiff_t)keep - (ptrdiff_t)( num - 1 ) );
+  if( i == 0 ) {
+    _ull_index_update_first( u, n );
+  }
+  if( at ) {
+    *at = n;
+  }
+  for( prev = n, pos = keep; res && pos < num; ) {
+    ullnode * new = 0;
+    size_t len = _ull_packed_fit( u, keys + pos, num - pos, max );
+    res = _ull_insert_new_node( u, prev, prev->next, &new );
+    if( res ) {
+      _ull_packed_store( u, new, keys + pos, len );
+      _ull_node_write_end( u, new );
+      ULL_STAT_ADD( &(u->stats), splits, 1 );
+      res = _ull_index_insert_after( u, prev, new );
+      if( at && i >= pos && i < pos + len ) {
+        *at = new;
+      }
+      prev = new;
+      pos += len;
+    }
+  }
+  // (the keys [0,pos) are stored, num - 1 of them were stored before)
+  u->num_elements = u->num_elements + pos - ( num - 1 );
+  return res;
+}
+
+// packed lists: removes one key equal to key, its node is merged with a neighbour
+// if it holds less than the min fill and the keys of both fit into one node
+static int _ull_packed_remove_key( ull * u, const void * key )
+{
+  int64_t keys[ 2 * ULL_PACKED_MAX_CAPACITY ];
+  ullnode * n = 0, * left = 0, * right = 0;
+  size_t num = 0, i = 0;
+  if( ! _ull_get_node_including_key( u, key, &n ) || ! n ) {
+    return 0;
+  }
+  num = n->num_elements;
+  i = _ull_packed_search( u, n, key, 0 );
+  if( i == num ) {
+    return 0;
+  }
+  _ull_packed_decode( u, n, 0, num, keys );
+  if( keys[ i ] != _ull_packed_key( u, key ) ) {
+    return 0;
+  }
+  u->num_elements --;
+  if( num == 1 ) {
+    _ull_remove_node( u, n );
+    return 1;
+  }
+  memmove( keys + i, keys + i + 1, ( num - i - 1 ) * sizeof(int64_t) );
+  num --;
+  _ull_node_write_begin( u, n );
+  _ull_packed_store( u, n, keys, num );
+  _ull_node_write_end( u, n );
+  _ull_index_add_count( u, n, -1 );
+  if( i == 0 ) {
+    _ull_index_update_first( u, n );
+  }
+  // the neighbour is the next node (the previous one for the last node)
+  left = ( n->next ? n : n->prev );
+  right = ( n->next ? n->next : n );
+  if( num < _ull_min_fill( u ) && left ) {
+    size_t moved = right->num_elements, total = left->num_elements + right->num_elements;
+    _ull_packed_decode( u, left, 0, left->num_elements, keys );
+    _ull_packed_decode( u, right, 0, moved, keys + left->num_elements );
+    if( _ull_packed_fit( u, keys, total, _ull_max_fill( u ) ) == total ) {
+      _ull_node_write_begin( u, left );
+      _ull_packed_store( u, left, keys, total );
+      _ull_node_write_end( u, left );
+      _ull_index_add_count( u, left, (ptrdiff_t)moved );
+      _ull_remove_node( u, right );
+      ULL_STAT_ADD( &(u->stats), merges, 1 );
+    }
+  }
+  return 1;
+}
+
+// inserts the key in a sorted fashion, searching its node from node "from" (if not 0)
+// -> *at is set to the node that holds the key afterwards (if at is not 0)
+static int _ull_insert_key( ull * u, const void * key, ullnode * from, ullnode * * at )
+{
+  if( u->mapping ) {
+    return 0; // read-only
+  }
+  if( u->packed ) {
+    return _ull_packed_insert_key( u, key, from, at );
+  }
+  if( u->num_nodes == 0 ) {
+    // init first node with one element
+    ullnode * new = 0;
+    if( _ull_insert_new_node( u, 0, 0, &new ) ) {
+      // insert element
+      ullindex * r = _ull_index_alloc( u );
+      if( ! r ) {
+        return 0;
+      }
+      new->num_elements = 1;
+      _ull_node_set_key( u, new, 0, key );
+			new->prev = NULL;
+			new->next = NULL;
+      _ull_node_write_end( u, new );
+      // insert node as root node
+      u->root = new;
+      // index with a single child
+      r->parent = 0;
+      r->leaves = 1;
+      r->num_children = 1;
+      memcpy( ULL_INDEX_FIRST( u, r, 0 ), key, u->keysize );
+      (r->children)[ 0 ] = new;
+      (r->counts)[ 0 ] = 1;
+      new->parent = r;
+      ULL_STORE( u->index_root, r );
+      u->index_height = 1;
+      u->num_elements = 1;
+      _ull_agg_up( u, r );
+      if( at ) {
+        *at = new;
+      }
+      return 1;
+    }
+  }
+  else {
+    // insert in a sorted fashion
+    // -> O(1) for keys not before the last key (appends of monotonic keys)
+    ullnode * best = u->tail;
+    size_t num = best->num_elements;
+    int append = ( num > 0 && _ull_cmp( u, key, ULL_NODE_KEY( u, best, num - 1 ) ) >= 0 );
+    if( append && u->split_append && num >= _ull_max_fill( u ) ) {
+      // the last node stays full and the key starts a new last node
+      ullnode * new = 0;
+      if( ! _ull_insert_new_node( u, best, 0, &new ) ) {
+        return 0;
+      }
+      _ull_node_set_key( u, new, 0, key );
+      new->num_elements = 1;
+      _ull_node_write_end( u, new );
+      u->num_elements ++;
+      ULL_STAT_ADD( &(u->stats), splits, 1 );
+      ULL_STAT_ADD( &(u->stats), append_splits, 1 );
+      if( at ) {
+        *at = new;
+      }
+      return _ull_index_insert_after( u, best, new );
+    }
+    if( append || ( _ull_get_node_including_key_from( u, from, key, &best ) && best ) ) {
+      // put after all elements that are equal to elem
+      size_t pos = ( append ? num : _ull_node_upper_bound( u, best, key ) );
+      int res = _ull_insert_node_element( u, best, pos, key );
+      if( at ) {
+        *at = best;
+      }
+      _ull_index_add_count( u, best, 1 );
+      u->num_elements ++;
+      if( pos == 0 ) {
+        // elem is before best node -> new first element
+        _ull_index_update_first( u, best );
+      }
+      // check if best node is full and needs to be split
+      // (always ensure a minimum of ONE empty element slot per node, for the logic above
+      // and optimally all nodes should not be fuller than 80%)
+      if( res && best->num_elements > _ull_max_fill( u ) ) {
+        
+				//printf("needs split\n");
+        // fuller than the split fill -> split in two nodes
+        ullnode * new = 0;
+        // insert a new node after best node
+        _ull_node_write_begin( u, best );
+        if( _ull_insert_new_node( u, best, best->next, &new ) && new ) {
+          // best keeps the split ratio of its elements, the rest go into new node
+          size_t firstnew = (size_t)( (double)(best->num_elements) * u->split_ratio + 0.5 );
+          firstnew = ( firstnew < 1 ? 1 : ( firstnew > best->num_elements - 1 ? best->num_elements - 1 : firstnew ) );
+          new->num_elements = best->num_elements - firstnew;
+          _ull_node_move( u, new, 0, best, firstnew, new->num_elements );
+          best->num_elements = firstnew;
+          _ull_node_write_end( u, new );
+          ULL_STAT_ADD( &(u->stats), splits, 1 );
+          _ull_index_add_count( u, best, -(ptrdiff_t)(new->num_elements) );
+          res = _ull_index_insert_after( u, best, new );
+          if( at && pos >= firstnew ) {
+            *at = new;
+          }
+        }
+        _ull_node_write_end( u, best );
+      }
+      return res;
+    }
+  }
+  return 0;
+}
+
+void ull_finger_init( ullfinger * f )
+{
+  if( f ) {
+    f->node = 0;
+    f->gen = 0;
+  }
+}
+
+// the node to start from for given finger (0 if a node was removed since it was set)
+static ullnode * _ull_finger_node( ull * u, ullfinger * f )
+{
+  return ( f->node && f->gen == u->node_gen ? f->node : 0 );
+}
+
+static void _ull_finger_set( ull * u, ullfinger * f, ullnode * n )
+{
+  f->node = n;
+  f->gen = u->node_gen;
+}
+
+// descends the index from index node p to the node that would/does best include given key
+// -> the lookup is counted with the walked nodes visited before p (see ullstats)
+static ullnode * _ull_index_descend( ull * u, ullindex * p, const void * key, size_t walked )
+{
+  while( 1 ) {
+    size_t i = _ull_search( u, ULL_INDEX_FIRST( u, p, 0 ), p->num_children, key, 1 );
+    i = ( i > 0 ? i - 1 : 0 );
+    walked ++;
+    if( p->leaves ) {
+      _ull_stat_walk( u, walked + 1 );
+      return ULL_CHILD( u, p, i );
+    }
+    p = ULL_CHILD( u, p, i );
+  }
+}
+
+// find the ullnode that would/does best include given key
+// -> does NOT check if given key is ACTUALLY inside the node, just in the RANGE of the node's keys!
+// -> returns the last node whose first key is not after given key (or the first node),
+//    so if given key is BETWEEN two nodes the node before it is returned
+// -> O(log nodes): descends the index, binary searching the first keys of each index node
+int _ull_get_node_including_key( ull * u, const void * key, ullnode * * n )
+{
+  if( n && u->index_root ) {
+    *n = _ull_index_descend( u, u->index_root, key, 0 );
+    return 1;
+  }
+  return 0; // no best node found
+}
+
+// whether given key is in the range of node n (from its first key to the next node's first key)
+static int _ull_node_covers( ull * u, ullnode * n, const void * key )
+{
+  return ( ( ! n->prev || _ull_cmp( u, key, ULL_NODE_KEY( u, n, 0 ) ) >= 0 ) &&
+    ( ! n->next || _ull_cmp( u, key, ULL_NODE_KEY( u, ULL_NEXT( u, n ), 0 ) ) < 0 ) );
+}
+
+// the link to node or index node x as it is stored in the list (see ULL_LINK())
+#define ULL_LINK_TO( u, x ) \
+  ( (u)->mapping ? (void*)( (unsigned char*)(x) - (unsigned char*)(u)->mapping ) : (void*)(x) )
+
+// like _ull_get_node_including_key() but starts at node "from":
+// tries from and its neighbours first, then climbs the index only until the subtree
+// also covers given key and descends from there, so the cost grows with the distance
+// between from and the result (not with the list size)
+int _ull_get_node_including_key_from( ull * u, ullnode * from, const void * key, ullnode * * n )
+{
+  if( n && from ) {
+    ullindex * p = ULL_PARENT( u, from );
+    size_t walked = 1;
+    if( _ull_node_covers( u, from, key ) ) {
+      // still inside the range of from
+      _ull_stat_walk( u, 1 );
+      *n = from;
+      return 1;
+    }
+    if( from->next && _ull_node_covers( u, ULL_NEXT( u, from ), key ) ) {
+      _ull_stat_walk( u, 2 );
+      *n = ULL_NEXT( u, from );
+      return 1;
+    }
+    if( from->prev && _ull_node_covers( u, ULL_PREV( u, from ), key ) ) {
+      _ull_stat_walk( u, 3 );
+      *n = ULL_PREV( u, from );
+      return 1;
+    }
+    while( p->parent ) {
+      ullindex * pp = ULL_PARENT( u, p );
+      size_t i = _ull_index_child_pos( pp, ULL_LINK_TO( u, p ) );
+      if( _ull_cmp( u, key, ULL_INDEX_FIRST( u, p, 0 ) ) >= 0 &&
+          i + 1 < pp->num_children && _ull_cmp( u, key, ULL_INDEX_FIRST( u, pp, i + 1 ) ) < 0 ) {
+        break;
+      }
+      p = pp;
+      walked ++;
+    }
+    *n = _ull_index_descend( u, p, key, walked );
+    return 1;
+  }
+  return _ull_get_node_including_key( u, key, n );
+}
+
+// find the ullnode that would/does best include given element
+int _ull_get_node_including_elem( ull * u, void * elem, ullnode * * n )
+{
+  return _ull_get_node_including_key( u, ULL_ELEM_KEY( u, elem ), n );
+}
+
+// the position of the nearest element (see ull_get_nearest()), searching key's node from
+// node from (if not 0)
+// -> *at is set to the node it looked into, *pos to the position of the element in it
+static int _ull_nearest_pos( ull * u, const void * key, int exactly, ullnode * from, ullnode * * at, size_t * pos )
+{
+  ullnode * best = 0;
+  if( _ull_get_node_including_key_from( u, from, key, &best ) && best && best->num_elements > 0 ) {
+    size_t i = _ull_node_lower_bound( u, best, key );
+    *at = best;
+    if( i < best->num_elements ) {
+      if( ! exactly || _ull_node_equals( u, best, i, key ) ) {
+        *pos = i;
+        return 1;
+      }
+    }
+    else if( ! exactly ) {
+      // elem is after this node
+      *pos = best->num_elements - 1;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// the nearest element (see ull_get_nearest()), searching elem's node from node from (if not 0)
+// -> *at is set to the node it looked into
+static int _ull_get_nearest_from( ull * u, const void * key, int exactly, void * * nearest, ullnode * from, ullnode * * at )
+{
+  size_t pos = 0;
+  if( ! u->packed && _ull_nearest_pos( u, key, exactly, from, at, &pos ) ) {
+    *nearest = _ull_node_element( u, *at, pos );
+    return 1;
+  }
+  return 0;
+}
+
+// uses compare function to retrieve nearest element
+// -> the nearest element is the first element not before elem inside elem's node
+//    or the last element of the node if all its elements are before elem
+int ull_get_nearest( ull * u, void * elem, int exactly, void * * nearest )
+{
+  ullnode * at = 0;
+  return _ull_get_nearest_from( u, ULL_ELEM_KEY( u, elem ), exactly, nearest, 0, &at );
+}
+
+// like ull_get_nearest() but copies the nearest element to *nearest: the key (keysize bytes)
+// for lists storing keys by value, the element pointer otherwise
+// -> works for packed lists (see ull_set_packed()), whose nodes hold no keys to point to
+int ull_get_nearest_key( ull * u, void * elem, int exactly, void * nearest )
+{
+  ullnode * at = 0;
+  size_t pos = 0;
+  if( _ull_nearest_pos( u, ULL_ELEM_KEY( u, elem ), exactly, 0, &at, &pos ) ) {
+    _ull_node_copy( u, at, pos, nearest );
+    return 1;
+  }
+  return 0;
+}
+
+// like ull_get_nearest() but searches the node from the node of the previous hinted call
+// with the same finger (or the automatic finger of the list if f is 0)
+// -> O(1) if elem is in the same or a neighbouring node, O(log distance) otherwise,
+//    so sequential lookups (scans, sorted joins) do not descend from the index root
+int ull_get_nearest_hint( ull * u, void * elem, int exactly, void * * nearest, ullfinger * f )
+{
+  ullnode * at = 0;
+  int res = 0;
+  f = ( f ? f : &(u->finger) );
+  res = _ull_get_nearest_from( u, ULL_ELEM_KEY( u, elem ), exactly, nearest, _ull_finger_node( u, f ), &at );
+  _ull_finger_set( u, f, at );
+  return res;
+}
+
+// finds given key or adds it (at *n, position *i), returns 1 if found, 2 if added and 0 on failure
+// -> searches from the node of the previous call (automatic finger), so ascending
+//    keys do not descend the index
+static int _ull_find_or_insert( ull * u, const void * key, ullnode * * n, size_t * i )
+{
+  ullnode * from = _ull_finger_node( u, &(u->finger) );
+  ullnode * at = 0;
+  if( _ull_get_node_including_key_from( u, from, key, &at ) && at && at->num_elements > 0 ) {
+    *i = _ull_node_lower_bound( u, at, key );
+    if( *i < at->num_elements && _ull_node_equals( u, at, *i, key ) ) {
+      _ull_finger_set( u, &(u->finger), at );
+      *n = at;
+      return 1;
+    }
+    from = at;
+  }
+  if( ! _ull_insert_key( u, key, from, &at ) || ! at ) {
+    return 0;
+  }
+  // the key is unique, so it is at its lower bound in the node it went into
+  _ull_finger_set( u, &(u->finger), at );
+  *i = _ull_node_lower_bound( u, at, key );
+  *n = at;
+  return 2;
+}
+
+// map lists: sets the value of given key (key and value point to keysize and valuesize bytes),
+// adds the key if it is not in the list yet
+// -> upserts of ascending keys do not descend the index (see _ull_find_or_insert())
+int ull_upsert( ull * u, const void * key, const void * value )
+{
+  ullnode * n = 0;
+  size_t i = 0;
+  if( ! u->valuesize || u->multiset || u->mapping || ! _ull_find_or_insert( u, key, &n, &i ) ) {
+    return 0;
+  }
+  _ull_node_write_begin( u, n );
+  memcpy( ULL_NODE_VALUE( u, n, i ), value, u->valuesize );
+  _ull_node_write_end( u, n );
+  return 1;
+}
+
+// multisets: adds one to the count of given key (adds the key with count 1)
+static int _ull_count_add( ull * u, const void * key )
+{
+  ullnode * n = 0;
+  size_t i = 0;
+  int res = ( u->mapping ? 0 : _ull_find_or_insert( u, key, &n, &i ) );
+  if( res ) {
+    _ull_node_write_begin( u, n );
+    *((uint64_t*)ULL_NODE_VALUE( u, n, i )) = ( res == 2 ? 1 : *((uint64_t*)ULL_NODE_VALUE( u, n, i )) + 1 );
+    _ull_node_write_end( u, n );
+  }
+  return ( res != 0 );
+}
+
+// uses compare function to insert element in a sorted fashion
+int ull_insert( ull * u, void * elem )
+{
+  if( u->multiset ) {
+    return _ull_count_add( u, ULL_ELEM_KEY( u, elem ) );
+  }
+  if( u->valuesize ) {
+    return 0; // map lists insert with ull_upsert()
+  }
+  return _ull_insert_key( u, ULL_ELEM_KEY( u, elem ), 0, 0 );
+}
+
+// like ull_insert() but searches the node from the node of the previous hinted call
+// with the same finger (or the automatic finger of the list if f is 0)
+// -> O(1) if elem belongs to the same or a neighbouring node, O(log distance) otherwise
+int ull_insert_hint( ull * u, void * elem, ullfinger * f )
+{
+  ullnode * at = 0;
+  int res = 0;
+  if( u->multiset ) {
+    return _ull_count_add( u, ULL_ELEM_KEY( u, elem ) ); // (follows the automatic finger)
+  }
+  if( u->valuesize ) {
+    return 0;
+  }
+  f = ( f ? f : &(u->finger) );
+  res = _ull_insert_key( u, ULL_ELEM_KEY( u, elem ), _ull_finger_node( u, f ), &at );
+  _ull_finger_set( u, f, at );
+  return res;
+}
+
+// map lists: points *value to the value of given key (valid until the list is modified)
+int ull_find( ull * u, const void * key, void * * value )
+{
+  void * k = 0;
+  return ull_get_nearest_value( u, key, 1, &k, value );
+}
+
+// map lists: like ull_get_nearest() (for a list storing keys by value), but also points
+// *value to the value of the nearest key
+int ull_get_nearest_value( ull * u, const void * key, int exactly, void * * nearest, void * * value )
+{
+  ullnode * at = 0;
+  if( u->valuesize && _ull_get_nearest_from( u, key, exactly, nearest, 0, &at ) ) {
+    size_t i = (size_t)( (unsigned char*)(*nearest) - ULL_NODE_KEY( u, at, 0 ) ) / u->keysize;
+    *value = ULL_NODE_VALUE( u, at, i );
+    return 1;
+  }
+  return 0;
+}
+
+// concurrent mode: descends the index to the node that is assumed to include given key
+// (to the last node if key is 0)
+// -> reads a consistent snapshot of every index node on the way (retries while the
+//    writer modifies it), restarts from the index root at index nodes that were removed
+// -> adds the number of index nodes visited to *walked
+static ullnode * _ull_read_descend( ull * u, const void * key, size_t * walked )
+{
+  ullindex * p = __atomic_load_n( &(u->index_root), __ATOMIC_ACQUIRE );
+  while( p ) {
+    unsigned int v = _ull_read_begin( &(p->version) );
+    size_t num = ULL_LOAD( p->num_children );
+    int leaves = ULL_LOAD( p->leaves );
+    void * child = 0;
+    if( ULL_LOAD( p->dead ) ) {
+      p = __atomic_load_n( &(u->index_root), __ATOMIC_ACQUIRE );
+      continue;
+    }
+    *walked += 1;
+    if( num > 0 && num <= ULL_INDEX_FANOUT ) {
+      size_t i = ( key ? _ull_search( u, ULL_INDEX_FIRST( u, p, 0 ), num, key, 1 ) : num );
+      child = ULL_LOAD( (p->children)[ i > 0 ? i - 1 : 0 ] );
+    }
+    if( _ull_read_validate( &(p->version), v ) ) {
+      if( leaves ) {
+        return child;
+      }
+      p = child;
+    }
+  }
+  return 0;
+}
+
+// enters a read section of given reader in the current epoch
+static void _ull_reader_enter( ullreader * r )
+{
+  ullepoch * e = r->u->epoch;
+  unsigned long g = __atomic_load_n( &(e->global), __ATOMIC_ACQUIRE );
+  __atomic_store_n( &((e->readers)[ r->slot ].active), ( g << 1 ) | 1, __ATOMIC_RELAXED );
+  __atomic_thread_fence( __ATOMIC_SEQ_CST );
+}
+
+static void _ull_reader_exit( ullreader * r )
+{
+  __atomic_store_n( &((r->u->epoch->readers)[ r->slot ].active), 0, __ATOMIC_RELEASE );
+}
+
+// what a reader looks for
+#define ULL_READ_NEAREST 0 // like ull_get_nearest( ..., 0, ... )
+#define ULL_READ_EXACT 1   // like ull_get_nearest( ..., 1, ... )
+#define ULL_READ_LOWER 2   // the first element not before the key (in any node)
+
+// what a reader copies out of a node: the stored key or, for lists created with
+// ull_init_abbrev(), only the element pointer (the first member of the key)
+#define ULL_READ_SIZE( u ) ( (u)->abbrev ? sizeof(void*) : (u)->keysize )
+
+// concurrent mode: finds the element for given key and copies it into out (ULL_READ_SIZE() bytes)
+// -> lock-free: reads a consistent snapshot of each visited node and starts over if the writer
+//    modified it meanwhile, the index only guides the reader to a node and the reader
+//    moves along the node chain until it found the node that covers the key
+static int _ull_read( ull * u, const void * key, int mode, void * out )
+{
+  size_t walked = 0;
+  while( 1 ) {
+    // out holds the last element of the node before n (all before key)
+    int have_before = 0;
+    ullnode * n = _ull_read_descend( u, key, &walked );
+    if( ! n ) {
+      _ull_stat_walk( u, walked );
+      return 0;
+    }
+    while( n ) {
+      unsigned int v = _ull_read_begin( &(n->version) );
+      size_t num = ULL_LOAD( n->num_elements );
+      ullnode * prev = ULL_LOAD( n->prev );
+      ullnode * next = ULL_LOAD( n->next );
+      ullnode * step = 0;
+      int found = -1;
+      if( ULL_LOAD( n->dead ) || num == 0 || num > u->capacity ) {
+        break; // removed meanwhile -> start over
+      }
+      if( _ull_cmp( u, key, ULL_NODE_KEY( u, n, 0 ) ) < 0 && ( prev || have_before ) ) {
+        if( have_before && mode == ULL_READ_LOWER ) {
+          memcpy( out, ULL_NODE_KEY( u, n, 0 ), ULL_READ_SIZE( u ) );
+          found = 1;
+        }
+        else if( have_before ) {
+          found = ( mode == ULL_READ_NEAREST ); // key is between prev and n
+        }
+        else {
+          step = prev;
+        }
+      }
+      else {
+        size_t i = _ull_search( u, ULL_NODE_KEY( u, n, 0 ), num, key, 0 );
+        if( i < num ) {
+          found = ( mode != ULL_READ_EXACT || _ull_cmp( u, key, ULL_NODE_KEY( u, n, i ) ) == 0 );
+          if( found ) {
+            memcpy( out, ULL_NODE_KEY( u, n, i ), ULL_READ_SIZE( u ) );
+          }
+        }
+        else if( next ) {
+          memcpy( out, ULL_NODE_KEY( u, n, num - 1 ), ULL_READ_SIZE( u ) );
+          step = next;
+        }
+        else {
+          memcpy( out, ULL_NODE_KEY( u, n, num - 1 ), ULL_READ_SIZE( u ) );
+          found = ( mode == ULL_READ_NEAREST );
+        }
+      }
+      if( ! _ull_read_validate( &(n->version), v ) ) {
+        break; // modified meanwhile -> start over
+      }
+      walked ++;
+      if( found >= 0 ) {
+        _ull_stat_walk( u, walked );
+        return found;
+      }
+      have_before = ( step == next );
+      n = step;
+    }
+  }
+}
+
+// concurrent mode: ull_get_nearest() for reader threads that copies the nearest element
+// into *nearest as stored in the nodes (the element pointer for lists created with ull_init()
+// or ull_init_abbrev(), else the key), so nearest must point to room for it
+int ull_read_nearest( ullreader * r, void * elem, int exactly, void * nearest )
+{
+  int res = 0;
+  _ull_reader_enter( r );
+  res = _ull_read( r->u, ULL_ELEM_KEY( r->u, elem ), ( exactly ? ULL_READ_EXACT : ULL_READ_NEAREST ), nearest );
+  _ull_reader_exit( r );
+  return res;
+}
+
+// concurrent mode: copies the first element that is not before elem into *lower
+// (see ull_read_nearest()), returns 0 if all elements are before elem
+int ull_read_lower_bound( ullreader * r, void * elem, void * lower )
+{
+  int res = 0;
+  _ull_reader_enter( r );
+  res = _ull_read( r->u, ULL_ELEM_KEY( r->u, elem ), ULL_READ_LOWER, lower );
+  _ull_reader_exit( r );
+  return res;
+}
+
+// concurrent mode: copies the last element into *last (see ull_read_nearest()),
+// returns 0 if the list is empty
+int ull_read_last( ullreader * r, void * last )
+{
+  ull * u = r->u;
+  int res = -1;
+  size_t walked = 0;
+  _ull_reader_enter( r );
+  while( res < 0 ) {
+    ullnode * n = _ull_read_descend( u, 0, &walked );
+    if( ! n ) {
+      res = 0;
+    }
+    while( n ) {
+      unsigned int v = _ull_read_begin( &(n->version) );
+      size_t num = ULL_LOAD( n->num_elements );
+      ullnode * next = ULL_LOAD( n->next );
+      if( ULL_LOAD( n->dead ) || num == 0 || num > u->capacity ) {
+        break;
+      }
+      if( ! next ) {
+        memcpy( last, ULL_NODE_KEY( u, n, num - 1 ), ULL_READ_SIZE( u ) );
+      }
+      if( ! _ull_read_validate( &(n->version), v ) ) {
+        break;
+      }
+      if( ! next ) {
+        res = 1;
+      }
+      walked ++;
+      n = next;
+    }
+  }
+  _ull_reader_exit( r );
+  _ull_stat_walk( u, walked );
+  return res;
+}
+
+// number of elements in the list (O(1))
+size_t ull_size( ull * u )
+{
+  return ( u ? ULL_LOAD( u->num_elements ) : 0 );
+}
+
+// descends the index by the element counts of the children to the node holding
+// the element at position *pos (< number of elements), which becomes its position in the node
+static ullnode * _ull_index_descend_pos( ull * u, size_t * pos )
+{
+  ullindex * p = u->index_root;
+  while( 1 ) {
+    size_t i = 0;
+    while( i + 1 < p->num_children && *pos >= (p->counts)[ i ] ) {
+      *pos -= (p->counts)[ i ];
+      i++;
+    }
+    if( p->leaves ) {
+      return ULL_CHILD( u, p, i );
+    }
+    p = ULL_CHILD( u, p, i );
+  }
+}
+
+// retrieves the element at given position (0 is the first element)
+// -> O(log n): descends the index by the element counts of the children
+int ull_get( ull * u, size_t pos, void * * value )
+{
+  if( u && value && pos < u->num_elements && ! u->packed ) {
+    ullnode * n = _ull_index_descend_pos( u, &pos );
+    *value = _ull_node_element( u, n, pos );
+    return 1;
+  }
+  return 0;
+}
+
+// like ull_get() but copies the element to *key (see ull_get_nearest_key())
+int ull_get_key( ull * u, size_t pos, void * key )
+{
+  if( u && key && pos < u->num_elements ) {
+    ullnode * n = _ull_index_descend_pos( u, &pos );
+    _ull_node_copy( u, n, pos, key );
+    return 1;
+  }
+  return 0;
+}
+
+// descends the index to the last node whose first element is before key (or the first node)
+// -> all elements of the nodes before it are before key, their number is added to *rank
+static ullnode * _ull_index_descend_before( ull * u, const void * key, size_t * rank )
+{
+  ullindex * p = u->index_root;
+  while( 1 ) {
+    size_t i = _ull_search( u, ULL_INDEX_FIRST( u, p, 0 ), p->num_children, key, 0 );
+    size_t j = 0;
+    i = ( i > 0 ? i - 1 : 0 );
+    for( j = 0; j < i; j++ ) {
+      *rank += (p->counts)[ j ];
+    }
+    if( p->leaves ) {
+      return ULL_CHILD( u, p, i );
+    }
+    p = ULL_CHILD( u, p, i );
+  }
+}
+
+// number of elements that are before elem (so the position elem would be inserted at
+// before all equal elements)
+// -> O(log n): descends to the last child whose first element is before elem,
+//    all children before it hold only elements before elem
+size_t ull_rank( ull * u, void * elem )
+{
+  size_t rank = 0;
+  if( u && u->index_root ) {
+    const void * key = ULL_ELEM_KEY( u, elem );
+    ullnode * n = _ull_index_descend_before( u, key, &rank );
+    rank += _ull_node_lower_bound( u, n, key );
+  }
+  return rank;
+}
+
+// how often given element is in the list: its count in multisets (see ull_set_multiset()),
+// otherwise the number of equal elements (O(log n + count))
+size_t ull_count( ull * u, void * elem )
+{
+  const void * key = ULL_ELEM_KEY( u, elem );
+  ullnode * n = 0;
+  size_t i = 0, count = 0;
+  if( ! u->index_root ) {
+    return 0;
+  }
+  n = _ull_index_descend_before( u, key, &count );
+  count = 0;
+  i = _ull_node_lower_bound( u, n, key );
+  if( i == n->num_elements && n->next ) {
+    // key is not after the first element of the next node
+    n = ULL_NEXT( u, n );
+    i = 0;
+  }
+  if( u->multiset ) {
+    return ( i < n->num_elements && _ull_cmp( u, key, ULL_NODE_KEY( u, n, i ) ) == 0 ?
+      (size_t)*((uint64_t*)ULL_NODE_VALUE( u, n, i )) : 0 );
+  }
+  // equal elements start in n and may go on in the following nodes
+  while( n ) {
+    size_t j = _ull_node_upper_bound( u, n, key );
+    count += j - i;
+    if( j < n->num_elements ) {
+      break;
+    }
+    n = ULL_NEXT( u, n );
+    i = 0;
+  }
+  return count;
+}
+
+// starts loading node n (header and keys) into the cache
+static void _ull_prefetch_node( ull * u, ullnode * n )
+{
+  if( n ) {
+    size_t off = 0;
+    for( off = 0; off < u->node_size; off += ULL_CACHE_LINE ) {
+      ULL_PREFETCH( (unsigned char*)n + off );
+    }
+  }
+}
+
+// inits the cursor before the first element of the list
+int ull_cursor_init( ullcursor * c, ull * u )
+{
+  if( c && u ) {
+    c->u = u;
+    c->node = u->root;
+    c->pos = 0;
+    return 1;
+  }
+  return 0;
+}
+
+// moves the cursor before the first element, returns 0 if the list is empty
+int ull_seek_first( ullcursor * c )
+{
+  c->node = c->u->root;
+  c->pos = 0;
+  return ( c->node != 0 );
+}
+
+// moves the cursor after the last element, returns 0 if the list is empty
+int ull_seek_end( ullcursor * c )
+{
+  ullindex * p = c->u->index_root;
+  c->node = 0;
+  c->pos = 0;
+  if( p ) {
+    while( ! p->leaves ) {
+      p = ULL_CHILD( c->u, p, p->num_children - 1 );
+    }
+    c->node = ULL_CHILD( c->u, p, p->num_children - 1 );
+    c->pos = c->node->num_elements;
+  }
+  return ( c->node != 0 );
+}
+
+// moves the cursor before the first element that is not before elem,
+// returns 0 if there is no such element (the cursor is at the end then)
+int ull_seek( ullcursor * c, void * elem )
+{
+  ull * u = c->u;
+  size_t rank = 0;
+  c->node = 0;
+  c->pos = 0;
+  if( u->index_root ) {
+    const void * key = ULL_ELEM_KEY( u, elem );
+    c->node = _ull_index_descend_before( u, key, &rank );
+    c->pos = _ull_node_lower_bound( u, c->node, key );
+    if( c->pos == c->node->num_elements && c->node->next ) {
+      c->node = ULL_NEXT( u, c->node );
+      c->pos = 0;
+    }
+    _ull_prefetch_node( u, ULL_NEXT( u, c->node ) );
+    return ( c->pos < c->node->num_elements );
+  }
+  return 0;
+}
+
+// moves the cursor from the end of its node to the start of the next node
+// and prefetches the node after that one
+static void _ull_cursor_enter_next( ullcursor * c )
+{
+  ullnode * n = c->node;
+  if( n && c->pos == n->num_elements && n->next ) {
+    c->node = ULL_NEXT( c->u, n );
+    c->pos = 0;
+    _ull_prefetch_node( c->u, ULL_NEXT( c->u, c->node ) );
+  }
+}
+
+// retrieves the element after the cursor and moves the cursor behind it,
+// returns 0 at the end of the list
+int ull_next( ullcursor * c, void * * elem )
+{
+  _ull_cursor_enter_next( c );
+  if( c->node && c->pos < c->node->num_elements && ! c->u->packed ) {
+    *elem = _ull_node_element( c->u, c->node, c->pos );
+    c->pos ++;
+    return 1;
+  }
+  return 0;
+}
+
+// like ull_next() but copies the element to *key (see ull_get_nearest_key())
+int ull_next_key( ullcursor * c, void * key )
+{
+  _ull_cursor_enter_next( c );
+  if( c->node && c->pos < c->node->num_elements ) {
+    _ull_node_copy( c->u, c->node, c->pos, key );
+    c->pos ++;
+    return 1;
+  }
+  return 0;
+}
+
+// moves the cursor from the start of its node to the end of the previous node
+// and prefetches the node before that one
+static void _ull_cursor_enter_prev( ullcursor * c )
+{
+  ullnode * n = c->node;
+  if( n && c->pos == 0 && n->prev ) {
+    c->node = ULL_PREV( c->u, n );
+    c->pos = c->node->num_elements;
+    _ull_prefetch_node( c->u, ULL_PREV( c->u, c->node ) );
+  }
+}
+
+// retrieves the element before the cursor and moves the cursor before it,
+// returns 0 at the start of the list
+int ull_prev( ullcursor * c, void * * elem )
+{
+  _ull_cursor_enter_prev( c );
+  if( c->node && c->pos > 0 && ! c->u->packed ) {
+    c->pos --;
+    *elem = _ull_node_element( c->u, c->node, c->pos );
+    return 1;
+  }
+  return 0;
+}
+
+// like ull_prev() but copies the element to *key (see ull_get_nearest_key())
+int ull_prev_key( ullcursor * c, void * key )
+{
+  _ull_cursor_enter_prev( c );
+  if( c->node && c->pos > 0 ) {
+    c->pos --;
+    _ull_node_copy( c->u, c->node, c->pos, key );
+    return 1;
+  }
+  return 0;
+}
+
+// retrieves all elements from the cursor to the end of its node at once and moves
+// the cursor behind them, returns 0 at the end of the list
+// -> *span points directly into the node (nothing is copied): to the stored element
+//    pointers (void*) of lists created with ull_init(), to the ullabbrevkey of lists
+//    created with ull_init_abbrev() or to the keys of lists storing keys by value,
+//    *len is the number of elements
+// -> the next node is prefetched while the caller works on the span
+int ull_next_span( ullcursor * c, void * * span, size_t * len )
+{
+  _ull_cursor_enter_next( c );
+  if( c->node && c->pos < c->node->num_elements && ! c->u->packed ) {
+    _ull_prefetch_node( c->u, ULL_NEXT( c->u, c->node ) );
+    *span = ULL_NODE_KEY( c->u, c->node, c->pos );
+    *len = c->node->num_elements - c->pos;
+    c->pos = c->node->num_elements;
+    return 1;
+  }
+  return 0;
+}
+
+int ull_remove_all( ull * u )
+{
+  if( u ) {
+    // give back all node memory at once
+    _ull_pool_release( &(u->nodes) );
+    _ull_pool_release( &(u->index_nodes) );
+    if( u->mapping ) {
+      // a mapped list becomes an empty list in memory
+      munmap( u->mapping, u->mapping_size );
+      u->mapping = 0;
+      u->mapping_size = 0;
+    }
+    u->root = 0;
+    u->tail = 0;
+    u->index_root = 0;
+    u->index_height = 0;
+    u->num_elements = 0;
+    u->num_nodes = 0;
+    u->node_gen ++;
+    if( u->epoch ) {
+      // the retired objects were released with their pools
+      u->epoch->num_retired = 0;
+    }
+    if( u->checkpoint ) {
+      // so were the dirty nodes
+      u->checkpoint->num_dirty = 0;
+      u->checkpoint->full = 1;
+    }
+    return 1;
+  }
+	return 0;
+}
+
+// removes the elements [from,to) of node n (the node itself if it becomes empty)
+void _ull_remove_node_elements( ull * u, ullnode * n, size_t from, size_t to )
+{
+  if( to - from == n->num_elements ) {
+    _ull_remove_node( u, n );
+  }
+  else if( from < to ) {
+    _ull_node_write_begin( u, n );
+    _ull_node_move( u, n, from, n, to, n->num_elements - to );
+    n->num_elements -= to - from;
+    _ull_node_write_end( u, n );
+    _ull_index_add_count( u, n, -(ptrdiff_t)( to - from ) );
+    if( from == 0 ) {
+      _ull_index_update_first( u, n );
+    }
+  }
+}
+
+// refills node n if it holds less than the min fill:
+// merges it with a neighbour if both fit into one node (the right one goes back to the pool),
+// otherwise moves elements over from the neighbour so both hold half of them
+// -> the neighbour is the next node (the previous one for the last node),
+//    so only n or the node after it may be freed
+void _ull_rebalance_node( ull * u, ullnode * n )
+{
+  ullnode * left = n;
+  ullnode * right = n->next;
+  if( n->num_elements >= _ull_min_fill( u ) ) {
+    return;
+  }
+  if( ! right ) {
+    left = n->prev;
+    right = n;
+  }
+  if( ! left ) {
+    return; // single node
+  }
+  if( left->num_elements + right->num_elements <= _ull_max_fill( u ) ) {
+    // (readers may find right's elements in both nodes until right is unlinked)
+    _ull_node_write_begin( u, left );
+    _ull_node_move( u, left, left->num_elements, right, 0, right->num_elements );
+    left->num_elements += right->num_elements;
+    _ull_node_write_end( u, left );
+    _ull_index_add_count( u, left, (ptrdiff_t)(right->num_elements) );
+    _ull_remove_node( u, right );
+    ULL_STAT_ADD( &(u->stats), merges, 1 );
+  }
+  else {
+    size_t half = ( left->num_elements + right->num_elements ) / 2;
+    ULL_STAT_ADD( &(u->stats), borrows, 1 );
+    _ull_node_write_begin( u, left );
+    _ull_node_write_begin( u, right );
+    if( left->num_elements < half ) {
+      // move first elements of right to the end of left
+      size_t k = half - left->num_elements;
+      _ull_node_move( u, left, left->num_elements, right, 0, k );
+      _ull_node_move( u, right, 0, right, k, right->num_elements - k );
+      left->num_elements += k;
+      right->num_elements -= k;
+      _ull_index_add_count( u, left, (ptrdiff_t)k );
+      _ull_index_add_count( u, right, -(ptrdiff_t)k );
+    }
+    else {
+      // move last elements of left to the front of right
+      size_t k = left->num_elements - half;
+      _ull_node_move( u, right, k, right, 0, right->num_elements );
+      _ull_node_move( u, right, 0, left, half, k );
+      left->num_elements -= k;
+      right->num_elements += k;
+      _ull_index_add_count( u, left, -(ptrdiff_t)k );
+      _ull_index_add_count( u, right, (ptrdiff_t)k );
+    }
+    _ull_node_write_end( u, right );
+    _ull_node_write_end( u, left );
+    _ull_index_update_first( u, right );
+  }
+}
+
+// removes one element that compares equal to elem, returns 0 if there is none
+int ull_remove( ull * u, void * elem )
+{
+  const void * key = ULL_ELEM_KEY( u, elem );
+  ullnode * n = 0;
+  if( u->packed ) {
+    return _ull_packed_remove_key( u, key );
+  }
+  if( ! u->mapping && _ull_get_node_including_key( u, key, &n ) && n ) {
+    // equal elements in nodes before n would make n's first element equal to elem
+    size_t i = _ull_node_lower_bound( u, n, key );
+    if( i < n->num_elements && _ull_cmp( u, key, ULL_NODE_KEY( u, n, i ) ) == 0 ) {
+      uint64_t * count = (uint64_t*)ULL_NODE_VALUE( u, n, i );
+      if( u->multiset && *count > 1 ) {
+        _ull_node_write_begin( u, n );
+        (*count) --;
+        _ull_node_write_end( u, n );
+        return 1;
+      }
+      u->num_elements --;
+      if( n->num_elements == 1 ) {
+        _ull_remove_node( u, n );
+      }
+      else {
+        _ull_remove_node_elements( u, n, i, i + 1 );
+        _ull_rebalance_node( u, n );
+      }
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// removes all elements that are neither before lo nor after hi,
+// returns the number of removed elements
+// -> nodes completely inside the range are dropped as a whole,
+//    only the two nodes at the range borders are refilled afterwards
+size_t ull_remove_range( ull * u, void * lo, void * hi )
+{
+  const void * lokey = ULL_ELEM_KEY( u, lo );
+  const void * hikey = ULL_ELEM_KEY( u, hi );
+  ullnode * n = 0;
+  ullnode * first = 0;
+  ullnode * last = 0;
+  size_t removed = 0, from = 0;
+  if( u->packed ) {
+    // one key at a time: the first key not before lo while it is not after hi
+    ullcursor c;
+    int64_t k = 0;
+    while( _ull_cmp( u, lokey, hikey ) <= 0 && ull_cursor_init( &c, u ) && ull_seek( &c, lo ) &&
+        ull_next_key( &c, &k ) && _ull_cmp( u, &k, hikey ) <= 0 && _ull_packed_remove_key( u, &k ) ) {
+      removed ++;
+    }
+    return removed;
+  }
+  if( u->mapping || _ull_cmp( u, lokey, hikey ) > 0 || ! _ull_get_node_including_key( u, lokey, &n ) || ! n ) {
+    return 0;
+  }
+  // elements equal to lo may continue in the nodes before
+  while( n->prev && _ull_cmp( u, ULL_NODE_KEY( u, n->prev, n->prev->num_elements - 1 ), lokey ) >= 0 ) {
+    n = n->prev;
+  }
+  from = _ull_node_lower_bound( u, n, lokey );
+  while( n ) {
+    ullnode * next = n->next;
+    size_t num = n->num_elements;
+    size_t to = _ull_node_upper_bound( u, n, hikey );
+    if( from < to ) {
+      removed += to - from;
+      _ull_remove_node_elements( u, n, from, to );
+    }
+    if( from < to && to - from == num ) {
+      n = 0; // dropped
+    }
+    else if( ! first ) {
+      first = n;
+    }
+    else {
+      last = n;
+    }
+    if( to < num ) {
+      break; // the range ends inside n
+    }
+    n = next;
+    from = 0;
+  }
+  // the last border node first: refilling it never frees the first border node
+  if( last ) {
+    _ull_rebalance_node( u, last );
+  }
+  if( first ) {
+    _ull_rebalance_node( u, first );
+  }
+  u->num_elements -= removed;
+  return removed;
+}
+
+// adds the aggregate of the elements of the subtree of index node p that are neither before
+// lokey nor after hikey to out, next is the first key after the subtree (0: none)
+// -> children inside the range are added as a whole, only the children that contain lokey
+//    or hikey are descended into (and their elements visited at the nodes)
+static void _ull_agg_range( ull * u, ullindex * p, const void * lokey, const void * hikey, const void * next, void * out, int * have )
+{
+  size_t i = 0;
+  for( i = 0; i < p->num_children; i++ ) {
+    void * child = (p->children)[ i ];
+    const void * first = ULL_INDEX_FIRST( u, p, i );
+    // all elements of the child are not after the first key of the next child
+    const void * after = ( i + 1 < p->num_children ? ULL_INDEX_FIRST( u, p, i + 1 ) : next );
+    if( _ull_cmp( u, first, hikey ) > 0 ) {
+      break; // this and all following children are after the range
+    }
+    if( after && _ull_cmp( u, after, lokey ) < 0 ) {
+      continue; // before the range
+    }
+    if( after && _ull_cmp( u, first, lokey ) >= 0 && _ull_cmp( u, after, hikey ) <= 0 ) {
+      if( ! p->leaves ) {
+        _ull_agg_add( u, ULL_INDEX_AGG( u, child ), out, have );
+      }
+      else if( ((ullnode*)child)->num_elements > 0 ) {
+        _ull_agg_add( u, ULL_NODE_AGG( u, child ), out, have );
+      }
+    }
+    else if( p->leaves ) {
+      ullnode * n = (ullnode*)child;
+      _ull_agg_elements( u, n, _ull_node_lower_bound( u, n, lokey ), _ull_node_upper_bound( u, n, hikey ), out, have );
+    }
+    else {
+      _ull_agg_range( u, (ullindex*)child, lokey, hikey, after, out, have );
+    }
+  }
+}
+
+// computes the aggregate (see ull_set_aggregate()) of all elements that are neither before
+// lo nor after hi into out (statesize bytes), returns 0 if there are none (out is not set then)
+// -> O(log n + elements per node): whole nodes and subtrees inside the range are read
+//    from their aggregates, only the nodes at the range borders are visited
+int ull_range_aggregate( ull * u, void * lo, void * hi, void * out )
+{
+  int have = 0;
+  if( u && u->aggregate && out && u->index_root ) {
+    const void * lokey = ULL_ELEM_KEY( u, lo );
+    const void * hikey = ULL_ELEM_KEY( u, hi );
+    if( _ull_cmp( u, lokey, hikey ) <= 0 ) {
+      _ull_agg_range( u, u->index_root, lokey, hikey, 0, out, &have );
+    }
+  }
+  return have;
+}
+
+// builds the index bottom-up over the (already linked) node chain,
+// index nodes get fill_factor * ULL_INDEX_FANOUT children
+int _ull_index_build( ull * u, double fill_factor )
+{
+  size_t per = (size_t)( (double)ULL_INDEX_FANOUT * fill_factor );
+  size_t count = u->num_nodes, i = 0, j = 0;
+  void * * level = 0;
+  int leaves = 1;
+  per = ( per < 2 ? 2 : ( per > ULL_INDEX_FANOUT ? ULL_INDEX_FANOUT : per ) );
+  if( count == 0 ) {
+    return 1;
+  }
+  // children of the current level
+  level = malloc( count * sizeof(void*) );
+  if( ! level ) {
+    return 0;
+  }
+  {
+    ullnode * n = u->root;
+    for( i = 0; n; i++, n = n->next ) {
+      level[ i ] = n;
+    }
+  }
+  u->index_height = 0;
+  do {
+    // spread the children of this level evenly over the index nodes of the next level
+    size_t num = ( count + per - 1 ) / per;
+    size_t c = 0;
+    for( i = 0; i < num; i++ ) {
+      size_t cnt = count / num + ( i < count % num ? 1 : 0 );
+      ullindex * p = _ull_index_alloc( u );
+      if( ! p ) {
+        free( level );
+        return 0;
+      }
+      p->parent = 0;
+      p->leaves = leaves;
+      p->num_children = cnt;
+      for( j = 0; j < cnt; j++, c++ ) {
+        (p->children)[ j ] = level[ c ];
+        (p->counts)[ j ] = ( leaves ? ((ullnode*)(level[ c ]))->num_elements : _ull_index_total( (ullindex*)(level[ c ]) ) );
+        memcpy( ULL_INDEX_FIRST( u, p, j ),
+          ( leaves ? ULL_NODE_KEY( u, (ullnode*)(level[ c ]), 0 ) : ULL_INDEX_FIRST( u, (ullindex*)(level[ c ]), 0 ) ),
+          u->keysize );
+        _ull_index_adopt( p, j );
+      }
+      if( u->aggregate ) {
+        _ull_agg_index( u, p );
+      }
+      // the new level is written over the start of the current one
+      level[ i ] = p;
+    }
+    count = num;
+    leaves = 0;
+    u->index_height ++;
+  }
+  while( count > 1 );
+  ULL_STORE( u->index_root, (ullindex*)(level[ 0 ]) );
+  free( level );
+  return 1;
+}
+
+// lists created with ull_init_abbrev(): computes the abbreviations of n keys
+static void _ull_abbrev_keys( ull * u, void * keys, size_t n )
+{
+  ullabbrevkey * k = (ullabbrevkey*)keys;
+  size_t i = 0;
+  for( i = 0; i < n; i++ ) {
+    k[ i ].abbrev = (u->abbrev)( k[ i ].elem );
+  }
+}
+
+// replaces the contents of the list with given n sorted elements in O(n)
+// -> elems is an array of elements as stored in the nodes: element pointers for
+//    lists created with ull_init(), ullabbrevkey for lists created with ull_init_abbrev()
+//    (only elem needs to be set, the abbreviations are computed) or keys for lists
+//    storing keys by value
+// -> nodes are packed to fill_factor (0 < fill_factor <= 1) of their capacity
+//    (but always keep one free slot), allocated and linked in one pass
+int ull_build_from_sorted( ull * u, const void * elems, size_t n, double fill_factor )
+{
+  if( u && ( elems || n == 0 ) && fill_factor > 0.0 && fill_factor <= 1.0 && ! u->valuesize ) {
+    const unsigned char * src = (const unsigned char *)elems;
+    size_t per = (size_t)( (double)(u->capacity) * fill_factor + 0.5 );
+    size_t num = 0, i = 0;
+    ullnode * prev = 0;
+    ull_remove_all( u );
+    if( n == 0 ) {
+      return 1;
+    }
+    per = ( per < 1 ? 1 : ( per > u->capacity - 1 ? u->capacity - 1 : per ) );
+    if( u->packed ) {
+      // packed lists: at most per keys, as many as fit
+      int64_t keys[ ULL_PACKED_MAX_CAPACITY ];
+      for( i = 0; i < n; ) {
+        size_t cnt = ( n - i < per ? n - i : per ), j = 0;
+        ullnode * new = 0;
+        for( j = 0; j < cnt; j++ ) {
+          keys[ j ] = _ull_packed_key( u, src + ( i + j ) * u->keysize );
+        }
+        cnt = _ull_packed_fit( u, keys, cnt, per );
+        if( ! _ull_insert_new_node( u, prev, 0, &new ) ) {
+          return 0;
+        }
+        _ull_packed_store( u, new, keys, cnt );
+        _ull_node_write_end( u, new );
+        if( ! prev ) {
+          u->root = new;
+        }
+        prev = new;
+        i += cnt;
+        u->num_elements = i;
+      }
+      return _ull_index_build( u, fill_factor );
+    }
+    num = ( n + per - 1 ) / per;
+    for( i = 0; i < num; i++ ) {
+      // spread the elements evenly
+      size_t cnt = n / num + ( i < n % num ? 1 : 0 );
+      ullnode * new = 0;
+      if( ! _ull_insert_new_node( u, prev, 0, &new ) ) {
+        return 0;
+      }
+      memcpy( ULL_NODE_KEY( u, new, 0 ), src, cnt * u->keysize );
+      if( u->abbrev ) {
+        _ull_abbrev_keys( u, ULL_NODE_KEY( u, new, 0 ), cnt );
+      }
+      new->num_elements = cnt;
+      _ull_node_write_end( u, new );
+      src += cnt * u->keysize;
+      if( ! prev ) {
+        u->root = new;
+      }
+      prev = new;
+    }
+    u->num_elements = n;
+    return _ull_index_build( u, fill_factor );
+  }
+  return 0;
+}
+
+// stable sort of n keys (tmp must hold n keys)
+// -> uses the sort of the key operations or else a merge sort of pointers
+//    to the keys (fixed size moves) that gathers the keys afterwards
+int _ull_sort_keys( ull * u, unsigned char * keys, size_t n, unsigned char * tmp )
+{
+  size_t ks = u->keysize, width = 1, i = 0;
+  const unsigned char * * src = 0, * * dst = 0, * * mem = 0;
+  if( u->keyops->sort ) {
+    (u->keyops->sort)( u, keys, n, tmp );
+    return 1;
+  }
+  src = malloc( 2 * n * sizeof(unsigned char*) );
+  dst = src + n;
+  mem = src;
+  if( ! src ) {
+    return 0;
+  }
+  for( i = 0; i < n; i++ ) {
+    src[ i ] = keys + i * ks;
+  }
+  for( width = 1; width < n; width *= 2 ) {
+    size_t lo = 0;
+    for( lo = 0; lo < n; lo += 2 * width ) {
+      size_t mid = ( lo + width < n ? lo + width : n );
+      size_t hi = ( lo + 2 * width < n ? lo + 2 * width : n );
+      size_t a = lo, b = mid, o = lo;
+      while( a < mid && b < hi ) {
+        dst[ o++ ] = ( _ull_cmp( u, src[ b ], src[ a ] ) < 0 ? src[ b++ ] : src[ a++ ] );
+      }
+      while( a < mid ) {
+        dst[ o++ ] = src[ a++ ];
+      }
+      while( b < hi ) {
+        dst[ o++ ] = src[ b++ ];
+      }
+    }
+    // swap roles
+    {
+      const unsigned char * * t = src;
+      src = dst;
+      dst = t;
+    }
+  }
+  for( i = 0; i < n; i++ ) {
+    memcpy( tmp + i * ks, src[ i ], ks );
+  }
+  memcpy( keys, tmp, n * ks );
+  free( mem );
+  return 1;
+}
+
+// merges cnt sorted keys into node n (after equal elements of the node) and
+// spreads the result over n and as many new nodes after n as needed
+// -> tmp must hold n->num_elements + cnt keys
+static int _ull_merge_into_node( ull * u, ullnode * n, const unsigned char * keys, size_t cnt, unsigned char * tmp )
+{
+  size_t ks = u->keysize;
+  size_t na = n->num_elements, a = 0, b = 0, o = 0;
+  size_t total = na + cnt, maxf = _ull_max_fill( u ), num = 0, k = 0, first = 0;
+  const unsigned char * src = tmp;
+  int first_changed = ( cnt > 0 && ( na == 0 || _ull_cmp( u, keys, ULL_NODE_KEY( u, n, 0 ) ) < 0 ) );
+  ullnode * cur = n;
+  // each batch key goes after the run of node elements not after it
+  for( b = 0; b < cnt; b++ ) {
+    size_t run = ( a < na ? _ull_search( u, ULL_NODE_KEY( u, n, a ), na - a, keys + b * ks, 1 ) : 0 );
+    memcpy( tmp + o * ks, ULL_NODE_KEY( u, n, a ), run * ks );
+    o += run;
+    a += run;
+    memcpy( tmp + ( o++ ) * ks, keys + b * ks, ks );
+  }
+  memcpy( tmp + o * ks, ULL_NODE_KEY( u, n, a ), ( na - a ) * ks );
+  // spread evenly over as few nodes as possible
+  // -> the new nodes after n are filled before n is rewritten, so that readers
+  //    in concurrent mode find every element all the time
+  num = ( total + maxf - 1 ) / maxf;
+  first = total / num + ( total % num > 0 ? 1 : 0 );
+  src = tmp + first * ks;
+  for( k = 1; k < num; k++ ) {
+    size_t c = total / num + ( k < total % num ? 1 : 0 );
+    ullnode * new = 0;
+    if( ! _ull_insert_new_node( u, cur, cur->next, &new ) ) {
+      return 0;
+    }
+    memcpy( ULL_NODE_KEY( u, new, 0 ), src, c * ks );
+    new->num_elements = c;
+    _ull_node_write_end( u, new );
+    if( ! _ull_index_insert_after( u, cur, new ) ) {
+      return 0;
+    }
+    cur = new;
+    src += c * ks;
+  }
+  _ull_node_write_begin( u, n );
+  memcpy( ULL_NODE_KEY( u, n, 0 ), tmp, first * ks );
+  n->num_elements = first;
+  _ull_node_write_end( u, n );
+  _ull_index_add_count( u, n, (ptrdiff_t)first - (ptrdiff_t)na );
+  if( first_changed ) {
+    _ull_index_update_first( u, n );
+  }
+  u->num_elements += cnt;
+  return 1;
+}
+
+// inserts n elements at once: the batch is sorted and then merged with the
+// node chain in one forward pass, nodes that overflow are split in the same pass
+// -> elems is an array of elements as stored in the nodes (see ull_build_from_sorted())
+// -> O(n log n) for sorting the batch plus O(1) per visited node
+int ull_insert_batch( ull * u, const void * elems, size_t n )
+{
+  if( u && ( elems || n == 0 ) && ! u->mapping && ! u->valuesize ) {
+    size_t ks = u->keysize, i = 0;
+    unsigned char * batch = 0, * tmp = 0;
+    ullnode * cur = 0;
+    int res = 1;
+    if( u->packed ) {
+      // packed lists: one key at a time
+      for( i = 0; res && i < n; i++ ) {
+        res = _ull_packed_insert_key( u, (const unsigned char*)elems + i * ks, 0, 0 );
+      }
+      return res;
+    }
+    if( n == 0 ) {
+      return 1;
+    }
+    batch = malloc( n * ks );
+    tmp = malloc( ( n + u->capacity ) * ks );
+    if( ! batch || ! tmp ) {
+      free( batch );
+      free( tmp );
+      return 0;
+    }
+    memcpy( batch, elems, n * ks );
+    if( u->abbrev ) {
+      _ull_abbrev_keys( u, batch, n );
+    }
+    if( ! _ull_sort_keys( u, batch, n, tmp ) ) {
+      free( batch );
+      free( tmp );
+      return 0;
+    }
+    if( u->num_nodes == 0 && ! u->epoch ) {
+      res = ull_build_from_sorted( u, batch, n, (double)_ull_max_fill( u ) / (double)(u->capacity) );
+    }
+    else {
+      if( u->num_nodes == 0 ) {
+        // concurrent mode: readers may be active, so the list is not rebuilt
+        res = ull_insert( u, ( u->byvalue ? (void*)batch : *((void**)batch) ) );
+        i = 1;
+      }
+      if( res && i < n ) {
+        _ull_get_node_including_key( u, batch + i * ks, &cur );
+      }
+      while( res && i < n ) {
+        ullnode * next = cur->next;
+        // all batch keys before the next node's first key belong into cur
+        size_t j = ( next ?
+          i + _ull_search( u, batch + i * ks, n - i, ULL_NODE_KEY( u, next, 0 ), 0 ) : n );
+        if( j > i ) {
+          res = _ull_merge_into_node( u, cur, batch + i * ks, j - i, tmp );
+          i = j;
+        }
+        if( res && i < n ) {
+          // go forward to the node of the next batch key
+          _ull_get_node_including_key_from( u, next, batch + i * ks, &cur );
+        }
+      }
+    }
+    free( batch );
+    free( tmp );
+    return res;
+  }
+  return 0;
+}
+
+// appends elements to the end of a list in whole runs (see ull_merge(), and ull_split_at()
+// and ull_concat() for lists whose nodes can not move between them): elements of another
+// list are copied into new nodes filled up to the max fill
+// -> nodes appended to a list that had an index are put into it one by one, an empty
+//    list gets its index built in one pass at the end
+typedef struct _ullappend {
+  ull * u;
+  // the node being filled (its write section is open)
+  ullnode * node;
+  int indexed;
+}
+ullappend;
+
+static void _ull_append_begin( ullappend * a, ull * u )
+{
+  a->u = u;
+  a->node = 0;
+  a->indexed = ( u->num_nodes > 0 );
+}
+
+// closes the node being filled
+static int _ull_append_close( ullappend * a )
+{
+  ullnode * n = a->node;
+  if( n ) {
+    a->node = 0;
+    _ull_node_write_end( a->u, n );
+    if( a->indexed ) {
+      return _ull_index_insert_after( a->u, n->prev, n );
+    }
+  }
+  return 1;
+}
+
+// appends num keys (and their values, if the list has values) that are not before
+// the last element of the list
+static int _ull_append_keys( ullappend * a, const unsigned char * keys, const unsigned char * values, size_t num )
+{
+  ull * u = a->u;
+  size_t max = _ull_max_fill( u );
+  while( num > 0 ) {
+    size_t cnt = 0;
+    if( ! a->node ) {
+      if( ! _ull_insert_new_node( u, u->tail, 0, &(a->node) ) ) {
+        return 0;
+      }
+      if( ! u->root ) {
+        u->root = a->node;
+      }
+    }
+    cnt = max - a->node->num_elements;
+    cnt = ( cnt < num ? cnt : num );
+    memcpy( ULL_NODE_KEY( u, a->node, a->node->num_elements ), keys, cnt * u->keysize );
+    if( u->valuesize ) {
+      memcpy( ULL_NODE_VALUE( u, a->node, a->node->num_elements ), values, cnt * u->valuesize );
+      values += cnt * u->valuesize;
+    }
+    a->node->num_elements += cnt;
+    u->num_elements += cnt;
+    keys += cnt * u->keysize;
+    num -= cnt;
+    if( a->node->num_elements == max && ! _ull_append_close( a ) ) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// appends the elements [from,to) of node n of list src
+static int _ull_append_elements( ullappend * a, ull * src, ullnode * n, size_t from, size_t to )
+{
+  return ( from >= to || _ull_append_keys( a, ULL_NODE_KEY( src, n, from ),
+    ( src->valuesize ? ULL_NODE_VALUE( src, n, from ) : 0 ), to - from ) );
+}
+
+static int _ull_append_end( ullappend * a )
+{
+  ull * u = a->u;
+  if( ! _ull_append_close( a ) ) {
+    return 0;
+  }
+  return ( a->indexed || _ull_index_build( u, (double)_ull_max_fill( u ) / (double)(u->capacity) ) );
+}
+
+// lists whose elements can be moved between each other: same keys, values and order
+static int _ull_compatible( ull * a, ull * b )
+{
+  return ( a != b && a->keyops == b->keyops && a->keysize == b->keysize && a->cmpfunc == b->cmpfunc &&
+    a->abbrev == b->abbrev && a->byvalue == b->byvalue && a->valuesize == b->valuesize &&
+    a->multiset == b->multiset && ! a->mapping && ! b->mapping && ! a->epoch && ! b->epoch &&
+    ! a->packed && ! b->packed );
+}
+
+// whether the nodes and index nodes of list b can move to list a (and back): same node
+// and index node layout, slabs from the same allocator backends (see _ull_pool_share()),
+// and no checkpoints (whose logs name the nodes by id)
+static int _ull_spliceable( ull * a, ull * b )
+{
+  return ( a->capacity == b->capacity && a->node_size == b->node_size && a->index_size == b->index_size &&
+    a->aggregate == b->aggregate && ! a->checkpoint && ! b->checkpoint &&
+    _ull_pool_compatible( &(a->nodes), &(b->nodes) ) && _ull_pool_compatible( &(a->index_nodes), &(b->index_nodes) ) );
+}
+
+// number of nodes below index node p
+static size_t _ull_index_num_nodes( ullindex * p )
+{
+  size_t i = 0, num = 0;
+  if( p->leaves ) {
+    return p->num_children;
+  }
+  for( i = 0; i < p->num_children; i++ ) {
+    num += _ull_index_num_nodes( (ullindex*)((p->children)[ i ]) );
+  }
+  return num;
+}
+
+// cuts the index of u before node b (not the first node): every index node on the path from b
+// to the root keeps the children before the path, a new index node takes the ones after it
+// (after the new index node of the level below), the new index nodes become the index of right
+// -> O(index height * index fanout), the subtrees right of the path move as a whole
+// -> right must hold the slabs of u (see _ull_pool_share()), the new index nodes come from
+//    its own pool
+static int _ull_index_cut( ull * u, ullnode * b, ull * right )
+{
+  void * child = b;
+  ullindex * p = b->parent, * moved = 0;
+  int empty = 0;
+  while( p ) {
+    size_t j = _ull_index_child_pos( p, child ), from = j, k = 0;
+    ullindex * q = _ull_index_alloc( right );
+    if( ! q ) {
+      return 0;
+    }
+    q->parent = 0;
+    q->leaves = p->leaves;
+    q->num_children = 0;
+    if( moved ) {
+      // child keeps the part of its subtree before the path (if any)
+      memcpy( ULL_INDEX_FIRST( u, q, 0 ), ULL_INDEX_FIRST( u, moved, 0 ), u->keysize );
+      (q->children)[ 0 ] = moved;
+      (q->counts)[ 0 ] = _ull_index_total( moved );
+      (p->counts)[ j ] -= (q->counts)[ 0 ];
+      q->num_children = 1;
+      from = j + 1;
+      if( empty ) {
+        _ull_retire( u, &(u->index_nodes), child );
+      }
+    }
+    k = p->num_children - from;
+    memcpy( ULL_INDEX_FIRST( u, q, q->num_children ), ULL_INDEX_FIRST( u, p, from ), k * u->keysize );
+    memcpy( q->children + q->num_children, p->children + from, k * sizeof(void*) );
+    memcpy( q->counts + q->num_children, p->counts + from, k * sizeof(size_t) );
+    q->num_children += k;
+    for( k = 0; k < q->num_children; k++ ) {
+      _ull_index_adopt( q, k );
+    }
+    p->num_children = ( moved && ! empty ? j + 1 : j );
+    empty = ( p->num_children == 0 );
+    if( u->aggregate ) {
+      _ull_agg_index( u, q );
+      if( ! empty ) {
+        _ull_agg_index( u, p );
+      }
+    }
+    child = p;
+    moved = q;
+    p = p->parent;
+  }
+  // (b is not the first node, so the root keeps children)
+  right->index_root = moved;
+  right->index_height = u->index_height;
+  _ull_index_shrink( u );
+  _ull_index_shrink( right );
+  return 1;
+}
+
+// moves all elements that are not before elem into the empty list right (which must
+// store the same kind of elements, e.g. be initialized like u)
+// -> only the node holding elem is cut, the nodes after it move to right as they are:
+//    right holds the slabs of u as well (see _ull_pool_share()) and gets the index nodes
+//    right of the path to the cut (see _ull_index_cut()), O(log n + number of slabs)
+//    plus a walk over the index nodes of right to count its nodes
+// -> lists whose nodes can not move (see _ull_spliceable()) get copies of the elements
+//    in new nodes instead, O(log n) per moved node
+// -> not in concurrent mode
+int ull_split_at( ull * u, void * elem, ull * right )
+{
+  const void * key = 0;
+  ullappend a;
+  ullnode * n = 0, * b = 0;
+  size_t i = 0, rank = 0;
+  if( ! u || ! right || right->num_nodes > 0 || ! _ull_compatible( u, right ) ) {
+    return 0;
+  }
+  if( ! u->index_root ) {
+    return 1;
+  }
+  key = ULL_ELEM_KEY( u, elem );
+  n = _ull_index_descend_before( u, key, &rank );
+  i = _ull_node_lower_bound( u, n, key );
+  if( i == n->num_elements ) {
+    // key is not after the first element of the next node
+    n = n->next;
+    i = 0;
+  }
+  if( ! n ) {
+    return 1;
+  }
+  if( _ull_spliceable( u, right ) ) {
+    b = n;
+    if( i > 0 ) {
+      // cut n: its elements from i on go into a new node after it
+      if( ! _ull_insert_new_node( u, n, n->next, &b ) ) {
+        return 0;
+      }
+      _ull_node_write_begin( u, n );
+      _ull_node_move( u, b, 0, n, i, n->num_elements - i );
+      b->num_elements = n->num_elements - i;
+      n->num_elements = i;
+      _ull_node_write_end( u, n );
+      _ull_node_write_end( u, b );
+      _ull_index_add_count( u, n, -(ptrdiff_t)(b->num_elements) );
+      if( ! _ull_index_insert_after( u, n, b ) ) {
+        return 0;
+      }
+    }
+    // (after the last allocation from the pools of u)
+    if( ! _ull_pool_share( &(right->nodes), &(u->nodes) ) ||
+        ! _ull_pool_share( &(right->index_nodes), &(u->index_nodes) ) ) {
+      return 0;
+    }
+    if( ! b->prev ) {
+      // everything moves
+      right->index_root = u->index_root;
+      right->index_height = u->index_height;
+      u->index_root = 0;
+      u->index_height = 0;
+    }
+    else if( ! _ull_index_cut( u, b, right ) ) {
+      return 0;
+    }
+    right->root = b;
+    right->tail = u->tail;
+    right->num_elements = _ull_index_total( right->index_root );
+    right->num_nodes = _ull_index_num_nodes( right->index_root );
+    right->node_gen ++;
+    u->tail = b->prev;
+    if( b->prev ) {
+      b->prev->next = 0;
+      b->prev = 0;
+    }
+    else {
+      u->root = 0;
+    }
+    u->num_elements -= right->num_elements;
+    u->num_nodes -= right->num_nodes;
+    u->node_gen ++;
+    // refill the nodes on both sides of the cut
+    if( u->tail ) {
+      _ull_rebalance_node( u, u->tail );
+    }
+    _ull_rebalance_node( right, right->root );
+    return 1;
+  }
+  _ull_append_begin( &a, right );
+  {
+    ullnode * m = n;
+    size_t from = i;
+    for( ; m; m = m->next, from = 0 ) {
+      if( ! _ull_append_elements( &a, u, m, from, m->num_elements ) ) {
+        return 0;
+      }
+    }
+  }
+  if( ! _ull_append_end( &a ) ) {
+    return 0;
+  }
+  // drop the moved nodes from the end, then cut n
+  while( u->tail != n ) {
+    u->num_elements -= u->tail->num_elements;
+    _ull_remove_node( u, u->tail );
+  }
+  u->num_elements -= n->num_elements - i;
+  _ull_remove_node_elements( u, n, i, n->num_elements );
+  if( i > 0 ) {
+    _ull_rebalance_node( u, n );
+  }
+  return 1;
+}
+
+// joins the index of right to the index of left (whose nodes come first): the root of the
+// lower index becomes a child of the index node one level above it on the border of the
+// higher one (of a new root if both are equally high)
+// -> O(index height * index fanout), index nodes that get full are split as on inserts
+static int _ull_index_join( ull * left, ull * right )
+{
+  ullindex * lr = left->index_root, * rr = right->index_root, * p = 0;
+  size_t h = 0;
+  if( left->index_height == right->index_height ) {
+    // one level more, with the root of left as its only child so far
+    p = _ull_index_alloc( left );
+    if( ! p ) {
+      return 0;
+    }
+    p->parent = 0;
+    p->leaves = 0;
+    p->num_children = 1;
+    memcpy( ULL_INDEX_FIRST( left, p, 0 ), ULL_INDEX_FIRST( left, lr, 0 ), left->keysize );
+    (p->children)[ 0 ] = lr;
+    (p->counts)[ 0 ] = _ull_index_total( lr );
+    lr->parent = p;
+    left->index_root = p;
+    left->index_height ++;
+    lr = p;
+  }
+  if( left->index_height > right->index_height ) {
+    // the root of right becomes the last child
+    for( p = lr, h = left->index_height; h > right->index_height + 1; h-- ) {
+      p = (ullindex*)((p->children)[ p->num_children - 1 ]);
+    }
+    return _ull_index_insert_child( left, p, p->num_children, rr, ULL_INDEX_FIRST( left, rr, 0 ), _ull_index_total( rr ) );
+  }
+  // the root of left becomes the first child
+  for( p = rr, h = right->index_height; h > left->index_height + 1; h-- ) {
+    p = (ullindex*)((p->children)[ 0 ]);
+  }
+  left->index_root = rr;
+  left->index_height = right->index_height;
+  return _ull_index_insert_child( left, p, 0, lr, ULL_INDEX_FIRST( left, lr, 0 ), _ull_index_total( lr ) );
+}
+
+// appends all elements of list right to list left and empties right
+// -> the first element of right must not be before the last element of left
+//    (multisets add the count of an element that ends left and starts right)
+// -> the nodes of right are linked to the end of left as they are: left takes over the
+//    slabs of right (see _ull_pool_share()) and joins the index of right to its own
+//    (see _ull_index_join()), O(log n) plus O(number of slabs and free nodes of right)
+// -> lists whose nodes can not move (see _ull_spliceable()) get copies of the elements
+//    in new nodes instead, O(log n) per node of right
+int ull_concat( ull * left, ull * right )
+{
+  ullappend a;
+  ullnode * n = 0;
+  if( ! left || ! right || ! _ull_compatible( left, right ) ) {
+    return 0;
+  }
+  if( left->tail && right->root && _ull_cmp( left, ULL_NODE_KEY( right, right->root, 0 ),
+      ULL_NODE_KEY( left, left->tail, left->tail->num_elements - 1 ) ) < 0 ) {
+    return 0; // the ranges overlap
+  }
+  if( left->multiset && left->tail && right->root && _ull_cmp( left, ULL_NODE_KEY( right, right->root, 0 ),
+      ULL_NODE_KEY( left, left->tail, left->tail->num_elements - 1 ) ) == 0 ) {
+    // multisets store equal elements once: the count moves to the last element of left
+    n = left->tail;
+    _ull_node_write_begin( left, n );
+    *((uint64_t*)ULL_NODE_VALUE( left, n, n->num_elements - 1 )) += *((uint64_t*)ULL_NODE_VALUE( right, right->root, 0 ));
+    _ull_node_write_end( left, n );
+    right->num_elements --;
+    _ull_remove_node_elements( right, right->root, 0, 1 );
+  }
+  if( right->root && _ull_spliceable( left, right ) ) {
+    if( ! _ull_pool_share( &(left->nodes), &(right->nodes) ) ||
+        ! _ull_pool_share( &(left->index_nodes), &(right->index_nodes) ) ) {
+      return 0;
+    }
+    _ull_pool_absorb( &(left->nodes), &(right->nodes) );
+    _ull_pool_absorb( &(left->index_nodes), &(right->index_nodes) );
+    n = left->tail;
+    if( ! n ) {
+      left->root = right->root;
+      left->index_root = right->index_root;
+      left->index_height = right->index_height;
+    }
+    else {
+      n->next = right->root;
+      right->root->prev = n;
+      if( ! _ull_index_join( left, right ) ) {
+        return 0;
+      }
+    }
+    left->tail = right->tail;
+    left->num_elements += right->num_elements;
+    left->num_nodes += right->num_nodes;
+    if( n ) {
+      // refill the nodes at the border
+      _ull_rebalance_node( left, n );
+    }
+    return ull_remove_all( right );
+  }
+  _ull_append_begin( &a, left );
+  for( n = right->root; n; n = n->next ) {
+    if( ! _ull_append_elements( &a, right, n, 0, n->num_elements ) ) {
+      return 0;
+    }
+  }
+  if( ! _ull_append_end( &a ) ) {
+    return 0;
+  }
+  return ull_remove_all( right );
+}
+
+// merges the elements of lists a and b into the empty list out in one sorted pass over
+// both node chains (a and b are not changed)
+// -> equal elements of a come before the ones of b, multisets add their counts and
+//    map lists keep the value of b
+// -> O(n): runs of elements that come from the same list are copied at once
+int ull_merge( ull * a, ull * b, ull * out )
+{
+  ullappend w;
+  ullnode * na = 0, * nb = 0;
+  size_t ia = 0, ib = 0;
+  int unique = 0;
+  if( ! a || ! b || ! out || out->num_nodes > 0 || ! _ull_compatible( a, out ) || ! _ull_compatible( b, out ) ) {
+    return 0;
+  }
+  unique = ( out->valuesize > 0 );
+  na = a->root;
+  nb = b->root;
+  _ull_append_begin( &w, out );
+  while( na && nb ) {
+    const void * ka = ULL_NODE_KEY( a, na, ia );
+    const void * kb = ULL_NODE_KEY( b, nb, ib );
+    // the elements of a before (or not after) the current one of b, then the other way round
+    size_t ja = ia + _ull_search( out, ka, na->num_elements - ia, kb, ! unique );
+    size_t jb = ib;
+    int res = 1;
+    if( ja > ia ) {
+      res = _ull_append_elements( &w, a, na, ia, ja );
+      ia = ja;
+    }
+    else {
+      jb = ib + _ull_search( out, kb, nb->num_elements - ib, ka, 0 );
+      if( jb > ib ) {
+        res = _ull_append_elements( &w, b, nb, ib, jb );
+        ib = jb;
+      }
+      else if( out->multiset ) {
+        // equal elements of multisets -> one element with both counts
+        uint64_t count = *((uint64_t*)ULL_NODE_VALUE( a, na, ia )) + *((uint64_t*)ULL_NODE_VALUE( b, nb, ib ));
+        res = _ull_append_keys( &w, ka, (const unsigned char *)&count, 1 );
+        ia ++;
+        ib ++;
+      }
+      else {
+        // equal keys of map lists -> the value of b
+        res = _ull_append_keys( &w, ka, ULL_NODE_VALUE( b, nb, ib ), 1 );
+        ia ++;
+        ib ++;
+      }
+    }
+    if( ! res ) {
+      return 0;
+    }
+    if( ia == na->num_elements ) {
+      na = na->next;
+      ia = 0;
+    }
+    if( nb && ib == nb->num_elements ) {
+      nb = nb->next;
+      ib = 0;
+    }
+  }
+  for( ; na; na = na->next, ia = 0 ) {
+    if( ! _ull_append_elements( &w, a, na, ia, na->num_elements ) ) {
+      return 0;
+    }
+  }
+  for( ; nb; nb = nb->next, ib = 0 ) {
+    if( ! _ull_append_elements( &w, b, nb, ib, nb->num_elements ) ) {
+      return 0;
+    }
+  }
+  return _ull_append_end( &w );
+}
+
+
+// on-disk format of a list (see ull_save()): this header, the nodes in chain order and
+// the index nodes in level order, each at its in-memory size and with its links stored as
+// offsets into the file (0 for none), so the file can be mapped at any address
+// -> only files written by builds with the same node layout can be opened
+typedef struct _ullfileheader {
+  char magic[ 8 ];
+  uint32_t version;
+  // 0x01020304 as written (byte order)
+  uint32_t endian;
+  uint64_t pointer_size;
+  uint64_t keysize;
+  uint64_t capacity;
+  uint64_t node_size;
+  uint64_t node_keys_offset;
+  uint64_t index_size;
+  uint64_t index_firsts_offset;
+  uint64_t num_elements;
+  uint64_t num_nodes;
+  uint64_t num_index;
+  uint64_t index_height;
+  uint64_t nodes_offset;
+  uint64_t index_offset;
+  // total file size and FNV-1a hash of everything after the header
+  uint64_t size;
+  uint64_t checksum;
+}
+ullfileheader;
+
+#define ULL_FILE_MAGIC "ULLFILE"
+
+// FNV-1a (64 bit), continuing from given hash
+static uint64_t _ull_checksum( uint64_t h, const unsigned char * p, size_t n )
+{
+  size_t i = 0;
+  for( i = 0; i < n; i++ ) {
+    h = ( h ^ p[ i ] ) * 0x100000001b3ULL;
+  }
+  return h;
+}
+
+static int _ull_file_write( FILE * f, const void * p, size_t n, uint64_t * sum )
+{
+  *sum = _ull_checksum( *sum, (const unsigned char *)p, n );
+  return ( fwrite( p, 1, n, f ) == n );
+}
+
+// writes the list into a file that ull_open_mmap() maps without reading it
+// (lists storing keys by value without an aggregate only, see ull_init_keys())
+// -> the file is written next to path and renamed, so path always holds a complete file
+int ull_save( ull * u, const char * path )
+{
+  ullfileheader h;
+  ullindex * * order = 0;
+  size_t * parents = 0, * firsts = 0;
+  size_t num = 0, max = 0, k = 0, i = 0, node = 0;
+  unsigned char * buf = 0;
+  char * tmp = 0;
+  FILE * f = 0;
+  int res = 1;
+  if( ! u || ! path || ! u->byvalue || u->valuesize || u->aggregate || u->packed ) {
+    return 0;
+  }
+  // index nodes in level order with the position of their parent and first child
+  // (children of leaf index nodes are counted along the node chain)
+  max = 16;
+  order = malloc( max * sizeof(ullindex*) );
+  parents = malloc( max * sizeof(size_t) );
+  firsts = malloc( max * sizeof(size_t) );
+  res = ( order && parents && firsts );
+  if( res && u->index_root ) {
+    order[ 0 ] = u->index_root;
+    parents[ 0 ] = 0;
+    num = 1;
+  }
+  for( k = 0; res && k < num; k++ ) {
+    ullindex * p = order[ k ];
+    firsts[ k ] = ( p->leaves ? node : num );
+    if( p->leaves ) {
+      node += p->num_children;
+      continue;
+    }
+    while( res && num + p->num_children > max ) {
+      ullindex * * o = realloc( order, 2 * max * sizeof(ullindex*) );
+      size_t * pa = realloc( parents, 2 * max * sizeof(size_t) );
+      size_t * fi = realloc( firsts, 2 * max * sizeof(size_t) );
+      order = ( o ? o : order );
+      parents = ( pa ? pa : parents );
+      firsts = ( fi ? fi : firsts );
+      res = ( o && pa && fi );
+      max *= 2;
+    }
+    for( i = 0; res && i < p->num_children; i++ ) {
+      order[ num ] = ULL_CHILD( u, p, i );
+      parents[ num ] = k;
+      num ++;
+    }
+  }
+  memset( &h, 0, sizeof(ullfileheader) );
+  memcpy( h.magic, ULL_FILE_MAGIC, sizeof(ULL_FILE_MAGIC) );
+  h.version = ULL_FILE_VERSION;
+  h.endian = 0x01020304;
+  h.pointer_size = sizeof(void*);
+  h.keysize = u->keysize;
+  h.capacity = u->capacity;
+  h.node_size = u->node_size;
+  h.node_keys_offset = u->node_keys_offset;
+  h.index_size = u->index_size;
+  h.index_firsts_offset = u->index_firsts_offset;
+  h.num_elements = u->num_elements;
+  h.num_nodes = u->num_nodes;
+  h.num_index = num;
+  h.index_height = u->index_height;
+  h.nodes_offset = _ull_align( sizeof(ullfileheader) );
+  h.index_offset = h.nodes_offset + u->num_nodes * u->node_size;
+  h.size = h.index_offset + num * u->index_size;
+  h.checksum = 0xcbf29ce484222325ULL;
+  tmp = malloc( strlen( path ) + 5 );
+  buf = calloc( 1, ( u->node_size > u->index_size ? u->node_size : u->index_size ) );
+  if( res && tmp && buf ) {
+    sprintf( tmp, "%s.tmp", path );
+    f = fopen( tmp, "wb" );
+  }
+  res = ( res && f && fwrite( &h, 1, sizeof(ullfileheader), f ) == sizeof(ullfileheader) &&
+    _ull_file_write( f, buf, h.nodes_offset - sizeof(ullfileheader), &(h.checksum) ) );
+  // nodes (the children of the leaf index nodes, in chain order)
+  for( k = 0, node = 0; res && k < num; k++ ) {
+    ullindex * p = order[ k ];
+    for( i = 0; p->leaves && res && i < p->num_children; i++, node++ ) {
+      ullnode * n = ULL_CHILD( u, p, i );
+      ullnode * out = (ullnode*)buf;
+      memset( buf, 0, u->node_size );
+      out->prev = ( node > 0 ? (ullnode*)(uintptr_t)( h.nodes_offset + ( node - 1 ) * h.node_size ) : 0 );
+      out->next = ( node + 1 < h.num_nodes ? (ullnode*)(uintptr_t)( h.nodes_offset + ( node + 1 ) * h.node_size ) : 0 );
+      out->parent = (ullindex*)(uintptr_t)( h.index_offset + k * h.index_size );
+      out->num_elements = n->num_elements;
+      out->id = n->id;
+      memcpy( ULL_NODE_KEY( u, out, 0 ), ULL_NODE_KEY( u, n, 0 ), n->num_elements * u->keysize );
+      res = _ull_file_write( f, buf, u->node_size, &(h.checksum) );
+    }
+  }
+  // index nodes
+  for( k = 0; res && k < num; k++ ) {
+    ullindex * p = order[ k ];
+    ullindex * out = (ullindex*)buf;
+    memset( buf, 0, u->index_size );
+    out->parent = ( k > 0 ? (ullindex*)(uintptr_t)( h.index_offset + parents[ k ] * h.index_size ) : 0 );
+    out->num_children = p->num_children;
+    out->leaves = p->leaves;
+    for( i = 0; i < p->num_children; i++ ) {
+      (out->children)[ i ] = (void*)(uintptr_t)( p->leaves ?
+        h.nodes_offset + ( firsts[ k ] + i ) * h.node_size :
+        h.index_offset + ( firsts[ k ] + i ) * h.index_size );
+      (out->counts)[ i ] = (p->counts)[ i ];
+    }
+    memcpy( ULL_INDEX_FIRST( u, out, 0 ), ULL_INDEX_FIRST( u, p, 0 ), p->num_children * u->keysize );
+    res = _ull_file_write( f, buf, u->index_size, &(h.checksum) );
+  }
+  // header with the checksum
+  res = ( res && fseek( f, 0, SEEK_SET ) == 0 && fwrite( &h, 1, sizeof(ullfileheader), f ) == sizeof(ullfileheader) );
+  if( f ) {
+    res = ( fclose( f ) == 0 && res );
+    res = ( res && rename( tmp, path ) == 0 );
+    if( ! res ) {
+      remove( tmp );
+    }
+  }
+  if( res && f && u->checkpoint ) {
+    // the file is the base of the following checkpoints
+    _ull_checkpoint_clear( u );
+  }
+  free( order );
+  free( parents );
+  free( firsts );
+  free( buf );
+  free( tmp );
+  return ( res && f );
+}
+
+// opens a file written by ull_save() as read-only list: the file is mapped and lookups,
+// positional access and cursors read the nodes and the index straight from the mapping
+// (the links are offsets into the file, resolved on access, so no page is written)
+// -> ops must be the key operations of the saved list
+// -> the counts and offsets of the header are always checked against the file size,
+//    with verify set also the checksum, which reads the whole file
+// -> inserts and removals fail, ull_remove_all() unmaps the file (the list is empty then)
+int ull_open_mmap( ull * u, dynmem * m, const char * path, const ullkeyops * ops, int verify )
+{
+  ullfileheader h;
+  struct stat st;
+  unsigned char * map = 0;
+  int fd = -1;
+  if( ! u || ! path || ! ull_init_keys( u, m, ops ) ) {
+    return 0;
+  }
+  fd = open( path, O_RDONLY );
+  if( fd < 0 ) {
+    return 0;
+  }
+  if( fstat( fd, &st ) != 0 || read( fd, &h, sizeof(ullfileheader) ) != (ssize_t)sizeof(ullfileheader) ||
+      memcmp( h.magic, ULL_FILE_MAGIC, sizeof(ULL_FILE_MAGIC) ) != 0 || h.version != ULL_FILE_VERSION ||
+      h.endian != 0x01020304 || h.pointer_size != sizeof(void*) || h.keysize != u->keysize ||
+      h.size != (uint64_t)(st.st_size) || (size_t)(h.size) != h.size || h.capacity < 2 || h.capacity > h.size ) {
+    close( fd );
+    return 0;
+  }
+  u->capacity = h.capacity;
+  _ull_layout( u );
+  u->nodes.objsize = u->node_size;
+  u->index_nodes.objsize = u->index_size;
+  // the counts are bounded by the file size before they are multiplied
+  if( h.node_size != u->node_size || h.node_keys_offset != u->node_keys_offset ||
+      h.index_size != u->index_size || h.index_firsts_offset != u->index_firsts_offset ||
+      h.nodes_offset != _ull_align( sizeof(ullfileheader) ) || h.nodes_offset > h.size ||
+      h.num_nodes > ( h.size - h.nodes_offset ) / h.node_size ||
+      h.index_offset != h.nodes_offset + h.num_nodes * h.node_size ||
+      h.num_index > ( h.size - h.index_offset ) / h.index_size ||
+      h.size != h.index_offset + h.num_index * h.index_size ||
+      ( h.num_nodes == 0 ) != ( h.num_index == 0 ) || h.num_index > h.num_nodes ||
+      h.index_height > h.num_index || h.num_elements > h.num_nodes * h.capacity ) {
+    close( fd );
+    return 0;
+  }
+  map = mmap( 0, h.size, PROT_READ, MAP_PRIVATE, fd, 0 );
+  close( fd );
+  if( map == MAP_FAILED ) {
+    return 0;
+  }
+  if( verify && _ull_checksum( 0xcbf29ce484222325ULL, map + sizeof(ullfileheader), h.size - sizeof(ullfileheader) ) != h.checksum ) {
+    munmap( map, h.size );
+    return 0;
+  }
+  u->root = ( h.num_nodes ? (ullnode*)( map + h.nodes_offset ) : 0 );
+  u->tail = ( h.num_nodes ? (ullnode*)( map + h.nodes_offset + ( h.num_nodes - 1 ) * h.node_size ) : 0 );
+  u->index_root = ( h.num_index ? (ullindex*)( map + h.index_offset ) : 0 );
+  u->index_height = h.index_height;
+  u->num_elements = h.num_elements;
+  u->num_nodes = h.num_nodes;
+  u->mapping = map;
+  u->mapping_size = h.size;
+  return 1;
+}
+
+// switches the tracking of dirty nodes for ull_checkpoint() on or off
+// -> the first checkpoint after switching it on writes all nodes
+int ull_set_checkpointing( ull * u, int enable )
+{
+  ullnode * n = 0;
+  if( u && ! u->mapping && ! u->valuesize && ! u->packed ) {
+    if( enable && ! u->checkpoint ) {
+      u->checkpoint = calloc( 1, sizeof(ullcheckpoint) );
+      if( ! u->checkpoint ) {
+        return 0;
+      }
+      u->checkpoint->full = 1;
+      // the log names the nodes by id (nodes moved over by ull_concat() may repeat ids)
+      for( n = u->root; n; n = n->next ) {
+        n->id = u->next_node_id ++;
+      }
+    }
+    else if( ! enable && u->checkpoint ) {
+      _ull_checkpoint_clear( u );
+      free( u->checkpoint->dirty );
+      free( u->checkpoint->freed );
+      free( u->checkpoint );
+      u->checkpoint = 0;
+    }
+    return 1;
+  }
+  return 0;
+}
+
+// header of one checkpoint in a log: the ids of the removed nodes (uint64_t each)
+// and the dirty nodes (uint64_t id, uint64_t number of keys, the keys) follow
+typedef struct _ullcheckpointheader {
+  char magic[ 8 ];
+  uint32_t version;
+  // 1: the checkpoint holds all nodes of the list (older ones are obsolete)
+  uint32_t full;
+  uint64_t seq;
+  uint64_t keysize;
+  uint64_t capacity;
+  uint64_t num_nodes;
+  uint64_t num_freed;
+  uint64_t num_elements;
+  // size and FNV-1a hash of the rest of the checkpoint
+  uint64_t size;
+  uint64_t checksum;
+}
+ullcheckpointheader;
+
+#define ULL_CHECKPOINT_MAGIC "ULLCKPT"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+// writes all iovecs (continuing after partial writes)
+static int _ull_writev_all( int fd, struct iovec * iov, size_t cnt )
+{
+  while( cnt > 0 ) {
+    ssize_t w = writev( fd, iov, (int)( cnt > IOV_MAX ? IOV_MAX : cnt ) );
+    if( w < 0 ) {
+      return 0;
+    }
+    while( cnt > 0 && (size_t)w >= iov->iov_len ) {
+      w -= (ssize_t)(iov->iov_len);
+      iov ++;
+      cnt --;
+    }
+    if( cnt > 0 ) {
+      iov->iov_base = (unsigned char *)(iov->iov_base) + w;
+      iov->iov_len -= (size_t)w;
+    }
+  }
+  return 1;
+}
+
+// appends the nodes modified and the ids of the nodes removed since the last checkpoint
+// (or since ull_save()) to a log file (lists storing keys by value only)
+// -> the checkpoint is gathered into a few large writes (writev()) straight from the
+//    nodes, so its size follows the number of modified nodes, not the list size
+// -> a failed checkpoint is cut off the log again and its nodes stay dirty
+// -> fd should be opened with O_APPEND, syncing it is up to the caller
+int ull_checkpoint( ull * u, int fd )
+{
+  ullcheckpoint * c = ( u ? u->checkpoint : 0 );
+  ullcheckpointheader h;
+  struct iovec * iov = 0;
+  uint64_t * meta = 0;
+  size_t num = 0, cnt = 0, i = 0;
+  ullnode * n = 0;
+  off_t end = 0;
+  int res = 0;
+  if( ! c || ! u->byvalue ) {
+    return 0;
+  }
+  num = ( c->full ? u->num_nodes : c->num_dirty );
+  iov = malloc( ( 2 * num + 2 ) * sizeof(struct iovec) );
+  meta = malloc( ( 2 * num + 1 ) * sizeof(uint64_t) );
+  if( ! iov || ! meta ) {
+    free( iov );
+    free( meta );
+    return 0;
+  }
+  memset( &h, 0, sizeof(ullcheckpointheader) );
+  memcpy( h.magic, ULL_CHECKPOINT_MAGIC, sizeof(ULL_CHECKPOINT_MAGIC) );
+  h.version = ULL_FILE_VERSION;
+  h.full = (uint32_t)(c->full);
+  h.seq = c->seq;
+  h.keysize = u->keysize;
+  h.capacity = u->capacity;
+  h.num_nodes = num;
+  h.num_freed = ( c->full ? 0 : c->num_freed );
+  h.num_elements = u->num_elements;
+  iov[ cnt ].iov_base = &h;
+  iov[ cnt ].iov_len = sizeof(ullcheckpointheader);
+  cnt ++;
+  if( h.num_freed ) {
+    iov[ cnt ].iov_base = c->freed;
+    iov[ cnt ].iov_len = h.num_freed * sizeof(uint64_t);
+    cnt ++;
+  }
+  for( i = 0, n = u->root; i < num; i++ ) {
+    if( ! c->full ) {
+      n = (c->dirty)[ i ];
+    }
+    meta[ 2 * i ] = n->id;
+    meta[ 2 * i + 1 ] = n->num_elements;
+    iov[ cnt ].iov_base = &(meta[ 2 * i ]);
+    iov[ cnt ].iov_len = 2 * sizeof(uint64_t);
+    iov[ cnt + 1 ].iov_base = ULL_NODE_KEY( u, n, 0 );
+    iov[ cnt + 1 ].iov_len = n->num_elements * u->keysize;
+    cnt += 2;
+    n = n->next;
+  }
+  h.checksum = 0xcbf29ce484222325ULL;
+  for( i = 1; i < cnt; i++ ) {
+    h.checksum = _ull_checksum( h.checksum, iov[ i ].iov_base, iov[ i ].iov_len );
+    h.size += iov[ i ].iov_len;
+  }
+  end = lseek( fd, 0, SEEK_END );
+  res = ( end >= 0 && _ull_writev_all( fd, iov, cnt ) );
+  if( res ) {
+    _ull_checkpoint_clear( u );
+    c->seq ++;
+  }
+  else if( end >= 0 && ftruncate( fd, end ) != 0 ) {
+    // the log ends with a broken checkpoint (recovery stops there)
+  }
+  free( iov );
+  free( meta );
+  return res;
+}
+
+// a node read from a base file or a checkpoint
+typedef struct _ullrecovered {
+  uint64_t id;
+  // number of the checkpoint (0: base file), keys are 0 if the node was removed
+  uint64_t seq;
+  const unsigned char * keys;
+  size_t num;
+}
+ullrecovered;
+
+// whether a comes before b: by id and checkpoint, or (bykey) by the nodes' first and last keys
+static int _ull_recovered_before( ull * u, const ullrecovered * a, const ullrecovered * b, int bykey )
+{
+  if( bykey ) {
+    int c = _ull_cmp( u, a->keys, b->keys );
+    return ( c < 0 || ( c == 0 && _ull_cmp( u, a->keys + ( a->num - 1 ) * u->keysize,
+      b->keys + ( b->num - 1 ) * u->keysize ) < 0 ) );
+  }
+  return ( a->id < b->id || ( a->id == b->id && a->seq < b->seq ) );
+}
+
+// stable merge sort of recovered nodes
+static void _ull_sort_recovered( ull * u, ullrecovered * e, size_t n, ullrecovered * tmp, int bykey )
+{
+  size_t half = n / 2, i = 0, j = half, k = 0;
+  if( n < 2 ) {
+    return;
+  }
+  _ull_sort_recovered( u, e, half, tmp, bykey );
+  _ull_sort_recovered( u, e + half, n - half, tmp, bykey );
+  while( i < half && j < n ) {
+    tmp[ k++ ] = ( _ull_recovered_before( u, &(e[ j ]), &(e[ i ]), bykey ) ? e[ j++ ] : e[ i++ ] );
+  }
+  while( i < half ) {
+    tmp[ k++ ] = e[ i++ ];
+  }
+  while( j < n ) {
+    tmp[ k++ ] = e[ j++ ];
+  }
+  memcpy( e, tmp, n * sizeof(ullrecovered) );
+}
+
+static int _ull_recovered_add( ullrecovered * * e, size_t * num, size_t * max, uint64_t id, uint64_t seq, const unsigned char * keys, size_t cnt )
+{
+  if( *num == *max ) {
+    size_t m = ( *max ? 2 * *max : 1024 );
+    ullrecovered * r = realloc( *e, m * sizeof(ullrecovered) );
+    if( ! r ) {
+      return 0;
+    }
+    *e = r;
+    *max = m;
+  }
+  (*e)[ *num ].id = id;
+  (*e)[ *num ].seq = seq;
+  (*e)[ *num ].keys = keys;
+  (*e)[ *num ].num = cnt;
+  (*num) ++;
+  return 1;
+}
+
+// whether the removed ids and the nodes of a checkpoint fit into the h->size bytes at p
+// -> the counts are bounded by the bytes left before they are multiplied (the checksum
+//    does not protect against a crafted log)
+static int _ull_checkpoint_fits( const ullcheckpointheader * h, const unsigned char * p )
+{
+  const unsigned char * end = p + h->size;
+  uint64_t i = 0, meta[ 2 ];
+  if( h->keysize == 0 || h->num_freed > h->size / sizeof(uint64_t) ) {
+    return 0;
+  }
+  p += h->num_freed * sizeof(uint64_t);
+  if( h->num_nodes > (size_t)( end - p ) / sizeof(meta) ) {
+    return 0;
+  }
+  for( i = 0; i < h->num_nodes; i++ ) {
+    if( (size_t)( end - p ) < sizeof(meta) ) {
+      return 0;
+    }
+    memcpy( meta, p, sizeof(meta) );
+    if( meta[ 1 ] >= h->capacity || meta[ 1 ] > ( (size_t)( end - p ) - sizeof(meta) ) / h->keysize ) {
+      return 0;
+    }
+    p += sizeof(meta) + meta[ 1 ] * h->keysize;
+  }
+  return 1;
+}
+
+// rebuilds a list from a file written by ull_save() (base_path, may be 0) and the
+// checkpoints appended to a log by ull_checkpoint() after it (log_path, may be 0)
+// -> the list is initialized like with ull_init_keys(), nodes keep their ids so that
+//    later checkpoints can be appended to the same log
+// -> reading the log stops at the first incomplete or corrupted checkpoint, also at one
+//    whose counts do not fit its size
+int ull_recover( ull * u, dynmem * m, const ullkeyops * ops, const char * base_path, const char * log_path )
+{
+  ull b;
+  dynmem bm;
+  ullrecovered * e = 0, * tmp = 0;
+  size_t num = 0, max = 0, i = 0, k = 0, elements = 0;
+  size_t capacity = 0;
+  uint64_t seq = 0, cutoff = 0, next_id = 0;
+  unsigned char * log = 0;
+  size_t log_size = 0, pos = 0;
+  ullnode * prev = 0;
+  int res = 1, mapped = 0, inited = 0;
+  if( ! u || ! ops ) {
+    return 0;
+  }
+  // base file
+  if( base_path ) {
+    ullnode * n = 0;
+    dynmem_init( &bm, sizeof(void*) );
+    if( ! ull_open_mmap( &b, &bm, base_path, ops, 1 ) ) {
+      return 0;
+    }
+    mapped = 1;
+    capacity = b.capacity;
+    for( n = b.root; n && res; n = ULL_NEXT( &b, n ) ) {
+      res = _ull_recovered_add( &e, &num, &max, n->id, 0, ULL_NODE_KEY( &b, n, 0 ), n->num_elements );
+    }
+  }
+  // log file
+  if( res && log_path ) {
+    struct stat st;
+    int fd = open( log_path, O_RDONLY );
+    res = ( fd >= 0 && fstat( fd, &st ) == 0 );
+    if( res ) {
+      log_size = (size_t)(st.st_size);
+      log = malloc( log_size + 1 );
+      res = ( log != 0 );
+    }
+    while( res && pos < log_size ) {
+      ssize_t r = read( fd, log + pos, log_size - pos );
+      res = ( r > 0 );
+      pos += ( r > 0 ? (size_t)r : 0 );
+    }
+    if( fd >= 0 ) {
+      close( fd );
+    }
+    for( pos = 0; res && pos + sizeof(ullcheckpointheader) <= log_size; ) {
+      ullcheckpointheader h;
+      const unsigned char * p = log + pos + sizeof(ullcheckpointheader);
+      memcpy( &h, log + pos, sizeof(ullcheckpointheader) );
+      if( memcmp( h.magic, ULL_CHECKPOINT_MAGIC, sizeof(ULL_CHECKPOINT_MAGIC) ) != 0 ||
+          h.version != ULL_FILE_VERSION || h.keysize != ops->keysize || h.capacity < 2 ||
+          ( capacity && h.capacity != capacity ) ||
+          h.size > log_size - pos - sizeof(ullcheckpointheader) ||
+          _ull_checksum( 0xcbf29ce484222325ULL, p, h.size ) != h.checksum ||
+          ! _ull_checkpoint_fits( &h, p ) ) {
+        break; // end of the complete checkpoints
+      }
+      seq ++;
+      capacity = h.capacity;
+      if( h.full ) {
+        cutoff = seq;
+      }
+      for( i = 0; res && i < h.num_freed; i++, p += sizeof(uint64_t) ) {
+        uint64_t id = 0;
+        memcpy( &id, p, sizeof(uint64_t) );
+        res = _ull_recovered_add( &e, &num, &max, id, seq, 0, 0 );
+      }
+      for( i = 0; res && i < h.num_nodes; i++ ) {
+        uint64_t meta[ 2 ];
+        memcpy( meta, p, sizeof(meta) );
+        res = _ull_recovered_add( &e, &num, &max, meta[ 0 ], seq, p + sizeof(meta), (size_t)(meta[ 1 ]) );
+        p += sizeof(meta) + meta[ 1 ] * h.keysize;
+      }
+      pos += sizeof(ullcheckpointheader) + h.size;
+    }
+  }
+  inited = ( res && ull_init_keys( u, m, ops ) );
+  res = inited;
+  if( res && capacity ) {
+    u->capacity = capacity;
+    _ull_layout( u );
+    u->nodes.objsize = u->node_size;
+    u->index_nodes.objsize = u->index_size;
+  }
+  tmp = ( num ? malloc( num * sizeof(ullrecovered) ) : 0 );
+  res = ( res && ( tmp || num == 0 ) );
+  if( res ) {
+    // latest state of each node, then the nodes in list order
+    _ull_sort_recovered( u, e, num, tmp, 0 );
+    for( i = 0, k = 0; i < num; i++ ) {
+      next_id = ( e[ i ].id + 1 > next_id ? e[ i ].id + 1 : next_id );
+      if( ( i + 1 == num || e[ i + 1 ].id != e[ i ].id ) && e[ i ].seq >= cutoff && e[ i ].keys && e[ i ].num > 0 ) {
+        e[ k++ ] = e[ i ];
+      }
+    }
+    _ull_sort_recovered( u, e, k, tmp, 1 );
+    for( i = 0; res && i < k; i++ ) {
+      ullnode * new = 0;
+      res = _ull_insert_new_node( u, prev, 0, &new );
+      if( res ) {
+        memcpy( ULL_NODE_KEY( u, new, 0 ), e[ i ].keys, e[ i ].num * u->keysize );
+        new->num_elements = e[ i ].num;
+        new->id = e[ i ].id;
+        _ull_node_write_end( u, new );
+        elements += e[ i ].num;
+        if( ! prev ) {
+          u->root = new;
+        }
+        prev = new;
+      }
+    }
+    u->num_elements = elements;
+    u->next_node_id = next_id;
+    res = ( res && _ull_index_build( u, (double)_ull_max_fill( u ) / (double)(u->capacity) ) );
+  }
+  if( mapped ) {
+    // unmaps the base file and frees the slab tables of the base list
+    ull_remove_all( &b );
+    dynmem_free( &bm );
+    dynmem_free( &(b.index_memory) );
+  }
+  if( inited && ! res ) {
+    // the nodes recovered so far
+    ull_remove_all( u );
+  }
+  free( log );
+  free( e );
+  free( tmp );
+  return res;
+}
+
+// the bytes of the slabs of a pool and of its slab table
+// -> a slab that other pools hold as well (see _ull_pool_share()) is split evenly among them,
+//    so the memory of lists that share slabs adds up to the memory they hold together
+static size_t _ull_pool_memory( ullpool * p )
+{
+  size_t i = 0, num = 0, bytes = 0;
+  void * * slots = 0;
+  if( ! p->slabs ) {
+    return 0;
+  }
+  num = dynmem_length( p->slabs );
+  if( num > 0 && dynmem_get( p->slabs, 0, num, (void**)&slots ) ) {
+    for( i = 0; i < num; i++ ) {
+      bytes += _ull_pool_slab_bytes( p ) / *((size_t*)(slots[ i ]));
+    }
+  }
+  return bytes + p->slabs->reserved * p->slabs->elemsize;
+}
+
+// copies the operation statistics of the list to out and adds the current state:
+// the histogram of the node fill and the memory held (O(nodes + slabs), slabs shared
+// with other lists count in part, see _ull_pool_memory())
+// -> the counters are only counted if compiled with ULL_STATS (out->enabled is set then)
+// -> while readers of a list in concurrent mode are active, the counters are a
+//    snapshot of each counter (not of all of them at once)
+int ull_stats_get( ull * u, ullstats * out )
+{
+  if( u && out ) {
+    ullnode * n = u->root;
+    size_t i = 0;
+    memset( out, 0, sizeof(ullstats) );
+    out->lookups = __atomic_load_n( &(u->stats.lookups), __ATOMIC_RELAXED );
+    for( i = 0; i < ULL_STATS_BUCKETS; i++ ) {
+      (out->walks)[ i ] = __atomic_load_n( &((u->stats.walks)[ i ]), __ATOMIC_RELAXED );
+    }
+    out->searches = __atomic_load_n( &(u->stats.searches), __ATOMIC_RELAXED );
+    out->comparisons = __atomic_load_n( &(u->stats.comparisons), __ATOMIC_RELAXED );
+    out->splits = u->stats.splits;
+    out->append_splits = u->stats.append_splits;
+    out->merges = u->stats.merges;
+    out->borrows = u->stats.borrows;
+    out->node_allocs = u->stats.node_allocs;
+    out->node_frees = u->stats.node_frees;
+    out->index_allocs = u->stats.index_allocs;
+    out->slab_allocs = u->stats.slab_allocs;
+    out->slab_bytes = u->stats.slab_bytes;
+    out->table_grows = u->stats.table_grows;
+    out->table_bytes_moved = u->stats.table_bytes_moved;
+#ifdef ULL_STATS
+    out->enabled = 1;
+#else
+    out->enabled = 0;
+#endif
+    while( n ) {
+      size_t b = n->num_elements * ULL_STATS_FILL_BUCKETS / u->capacity;
+      (out->fill_hist)[ b < ULL_STATS_FILL_BUCKETS ? b : ULL_STATS_FILL_BUCKETS - 1 ] ++;
+      n = ULL_NEXT( u, n );
+    }
+    out->memory = _ull_pool_memory( &(u->nodes) ) + _ull_pool_memory( &(u->index_nodes) ) + u->mapping_size;
+    return 1;
+  }
+  return 0;
+}
+
+// sets all counters of the operation statistics to 0
+// -> not while readers of a list in concurrent mode are active
+void ull_stats_reset( ull * u )
+{
+  if( u ) {
+    memset( &(u->stats), 0, sizeof(ullstats) );
   }
-	return 0;
 }
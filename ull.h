@@ -31,47 +31,678 @@
 #ifndef ULL_H
 #define ULL_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
 #include "dynmem.h"
 
 typedef int (*ullcmpfunc)( void * a, void * b );
 typedef void (*ulldebugfunc)( void * a );
+// maps an element to an integer whose order agrees with the cmpfunc: if
+// abbrev( a ) < abbrev( b ) then a is before b (see ull_init_abbrev())
+typedef uint64_t (*ullabbrevfunc)( void * a );
+
+struct _ull;
+
+// key operations of a list: nodes store the keys by value (keysize bytes each)
+// -> cmp compares two stored keys (a and b point to the key bytes)
+// -> search returns how many of the n keys are before key (lower bound) or,
+//    if upper is set, how many are not after key (upper bound)
+// -> sort (optional) sorts n keys stably, tmp has room for n keys
+// -> usually generated by ULL_DEFINE_KEYOPS() so the comparison is inlined
+typedef struct _ullkeyops {
+  size_t keysize;
+  int (*cmp)( struct _ull * u, const void * a, const void * b );
+  size_t (*search)( struct _ull * u, const void * keys, size_t n, const void * key, int upper );
+  void (*sort)( struct _ull * u, void * keys, size_t n, void * tmp );
+}
+ullkeyops;
 
+// default number of elements per node (see ull_set_node_capacity())
 #define ULL_ELEMENTS_PER_NODE 32
+// keys of nodes and index nodes start at a cache line boundary
+#define ULL_CACHE_LINE 64
+// min number of nodes allocated at once by the node pool (slabs are filled up to the
+// granularity of the allocator backend, see _ull_pool_slab_bytes())
+#define ULL_NODES_PER_SLAB 256
+// max number of children of an index node
+#define ULL_INDEX_FANOUT 32
+// max number of reader threads of a list in concurrent mode
+#define ULL_MAX_READERS 64
+// default fill (fraction of the node capacity) below which a node borrows
+// elements from or is merged with a neighbour after removals
+#define ULL_MERGE_THRESHOLD 0.25
+// default split policy: nodes are split when fuller than 80%, into halves
+#define ULL_SPLIT_FILL 0.8
+#define ULL_SPLIT_RATIO 0.5
+// version of the file format written by ull_save()
+#define ULL_FILE_VERSION 3
+// packed lists (see ull_set_packed()): the deltas of a node take at most 1/ULL_PACKED_RATIO
+// of the bytes of capacity plain keys, nodes hold at most ULL_PACKED_MAX_CAPACITY keys
+#ifndef ULL_PACKED_RATIO
+#define ULL_PACKED_RATIO 4
+#endif
+#define ULL_PACKED_MAX_CAPACITY 1024
+// bit-packed deltas wider than that many bits are stored unpacked (64 bits)
+#define ULL_PACK_MAX_WIDTH 56
+// number of buckets of the histograms of ullstats
+#define ULL_STATS_BUCKETS 16
+#define ULL_STATS_FILL_BUCKETS 10
+// max size of the state of an aggregate (see ull_set_aggregate())
+#define ULL_AGGREGATE_MAX_STATE 64
+
+struct _ullindex;
 
 // unrolled linked list structure (stored byte chunks)
+// -> the node's keys (capacity keys, contiguous and cache line aligned) follow the header,
+//    see ULL_NODE_KEY()
 typedef struct _ullnode {
   struct _ullnode * prev;
   struct _ullnode * next;
-  void * elements [ ULL_ELEMENTS_PER_NODE ];
+  // index node that points to this node
+  struct _ullindex * parent;
   size_t num_elements;
+  // seqlock version (odd while the writer modifies the node) and
+  // removal mark for readers in concurrent mode
+  unsigned int version;
+  int dead;
+  // id of the node in checkpoints and its position + 1 in the list of dirty nodes
+  // (0 if not modified since the last checkpoint, see ull_checkpoint())
+  uint64_t id;
+  size_t dirty;
 }
 ullnode;
 
+// index node (B+-tree style inner level above the node chain):
+// children are either ullnodes (leaves == 1) or other index nodes and
+// are ordered like the node chain, each child is keyed by its first element
+// and counted by the number of elements in its subtree (order statistics)
+// -> the first key of each child's subtree follows the header, see ULL_INDEX_FIRST()
+typedef struct _ullindex {
+  struct _ullindex * parent;
+  size_t num_children;
+  int leaves;
+  // seqlock version and removal mark (see ullnode)
+  unsigned int version;
+  int dead;
+  void * children [ ULL_INDEX_FANOUT ];
+  size_t counts [ ULL_INDEX_FANOUT ];
+}
+ullindex;
+
+// operation statistics of a list (see ull_stats_get())
+// -> only counted if the library is compiled with ULL_STATS defined (make STATS=1),
+//    otherwise the counters stay 0 and cost nothing
+typedef struct _ullstats {
+  // lookups of a node by key and the number of nodes they visited (index nodes and nodes):
+  // walks[ i ] counts the lookups that visited 2^(i-1) .. 2^i - 1 nodes (the last bucket
+  // also counts all longer ones)
+  uint64_t lookups;
+  uint64_t walks [ ULL_STATS_BUCKETS ];
+  // binary searches over keys and the comparisons made by them and directly
+  // (the comparisons of a search are counted as its number of halving steps)
+  uint64_t searches;
+  uint64_t comparisons;
+  // node splits (append_splits of them started a new last node), merges of two nodes
+  // and elements moved between neighbours
+  uint64_t splits;
+  uint64_t append_splits;
+  uint64_t merges;
+  uint64_t borrows;
+  // nodes and index nodes taken from and returned to their pools
+  uint64_t node_allocs;
+  uint64_t node_frees;
+  uint64_t index_allocs;
+  // slabs added to the pools (and their bytes), growths of the slab tables
+  // (and the bytes moved by them)
+  uint64_t slab_allocs;
+  uint64_t slab_bytes;
+  uint64_t table_grows;
+  uint64_t table_bytes_moved;
+  // set by ull_stats_get(): whether counting is compiled in, the nodes by fill
+  // (fill_hist[ i ]: nodes holding i/10 .. (i+1)/10 of their capacity) and
+  // the bytes held by the pools (a slab shared by lists split evenly among them)
+  int enabled;
+  uint64_t fill_hist [ ULL_STATS_FILL_BUCKETS ];
+  uint64_t memory;
+}
+ullstats;
+
+// fixed-size object pool: objects are carved from slabs that are never moved
+// or reallocated (so pointers to them stay valid) and freed objects are kept
+// in an intrusive free list (the first pointer-sized bytes of a freed object
+// hold the pointer to the next free object)
+typedef struct _ullpool {
+  // table of slab pointers (only touched when a slab is added or released)
+  dynmem * slabs;
+  // size of one object in bytes
+  size_t objsize;
+  // last slab, number of objects carved from it so far and number of objects it holds
+  unsigned char * cur_slab;
+  size_t used_in_slab;
+  size_t slab_objects;
+  // first free object
+  void * free_list;
+  // statistics of the list the pool belongs to (or 0)
+  ullstats * stats;
+}
+ullpool;
+
+// a node found by an earlier call to start the next lookup or insert from
+// (see ull_get_nearest_hint())
+// -> it is only used while no node was removed from the list since (node_gen)
+typedef struct _ullfinger {
+  ullnode * node;
+  size_t gen;
+}
+ullfinger;
+
+// an aggregate over the elements of a list (e.g. count, sum, min or max) that every
+// node keeps for its elements and every index node for its subtree (see ull_set_aggregate())
+// -> lift sets state to the aggregate of one element: the key as stored in the nodes and its
+//    value (map lists and multisets, else 0)
+// -> combine sets state to the aggregate of the elements of state followed by the elements
+//    of next (it must be associative)
+typedef struct _ullaggregate {
+  size_t statesize;
+  void (*lift)( struct _ull * u, void * state, const void * key, const void * value );
+  void (*combine)( struct _ull * u, void * state, const void * next );
+}
+ullaggregate;
+
 typedef struct _ull {
 	// don't mess with this...
-  // a dynmem from which to allocate the nodes
+  // a dynmem that holds the slab table of the node pool
   dynmem * nodes_memory;
-  // root node
+  // node pool
+  ullpool nodes;
+  // root node and last node
   ullnode * root;
+  ullnode * tail;
+  // index over the node chain (O(log nodes) node lookup)
+  ullindex * index_root;
+  size_t index_height;
+  // index node pool (and its slab table)
+  ullpool index_nodes;
+  dynmem index_memory;
   // total size (for fast lookup)
-  //size_t num_elements;
+  size_t num_elements;
   // number of nodes (for fast lookup)
   size_t num_nodes;
-  // compare function
+  // compare function (lists created with ull_init())
   ullcmpfunc cmpfunc;
+  // abbreviation function (lists created with ull_init_abbrev()) or 0
+  ullabbrevfunc abbrev;
+  // key operations and size of a key
+  const ullkeyops * keyops;
+  size_t keysize;
+  // 0: elements are pointers (ull_init()), 1: elements are the keys themselves
+  int byvalue;
+  // size of the value stored with each key (map lists, see ull_init_map()) or 0
+  size_t valuesize;
+  // 1: equal elements are stored once with a count (the value, see ull_set_multiset())
+  int multiset;
+  // 1: nodes store their keys bit-packed (see ull_set_packed())
+  int packed;
+  // aggregate kept by the nodes and index nodes (see ull_set_aggregate()) or 0
+  const ullaggregate * aggregate;
+  // max number of elements per node
+  size_t capacity;
+  // nodes less filled than this (fraction of capacity) are refilled on removal
+  double merge_threshold;
+  // split policy (see ull_set_split_policy())
+  double split_fill;
+  double split_ratio;
+  int split_append;
+  // layout of nodes and index nodes
+  size_t node_size;
+  size_t node_keys_offset;
+  size_t node_values_offset;
+  size_t node_agg_offset;
+  size_t node_packed_offset;
+  size_t node_packed_bytes;
+  size_t index_size;
+  size_t index_firsts_offset;
+  size_t index_agg_offset;
+  // reader epochs and retired nodes (concurrent mode only, see ull_set_concurrent())
+  struct _ullepoch * epoch;
+  // counts the removals of nodes (invalidates fingers) and the automatic finger
+  size_t node_gen;
+  ullfinger finger;
+  // read-only mapping of a saved list (see ull_open_mmap())
+  void * mapping;
+  size_t mapping_size;
+  // id of the next new node and the dirty nodes (see ull_set_checkpointing())
+  uint64_t next_node_id;
+  struct _ullcheckpoint * checkpoint;
+  // operation statistics (see ull_stats_get())
+  ullstats stats;
 }
 ull;
 
+// a reader thread of a list in concurrent mode (see ull_reader_init())
+typedef struct _ullreader {
+  ull * u;
+  size_t slot;
+}
+ullreader;
+
+// position between two elements of a list (or before the first / after the last one)
+// -> a cursor is only valid as long as the list is not modified
+typedef struct _ullcursor {
+  ull * u;
+  // node and position inside the node of the element after the cursor
+  // (pos == num_elements: the cursor is at the end of the node)
+  ullnode * node;
+  size_t pos;
+}
+ullcursor;
+
+// address of the i-th key of a node (packed lists: only the first key is stored as is,
+// followed by the width of the deltas and the bit-packed deltas, see ull_set_packed())
+#define ULL_NODE_KEY( u, n, i ) \
+  ( (unsigned char*)(n) + (u)->node_keys_offset + (size_t)(i) * (u)->keysize )
+// address of the value of the i-th key of a node (map lists)
+#define ULL_NODE_VALUE( u, n, i ) \
+  ( (unsigned char*)(n) + (u)->node_values_offset + (size_t)(i) * (u)->valuesize )
+// address of the aggregate state of a node or index node (see ull_set_aggregate())
+#define ULL_NODE_AGG( u, n ) ( (unsigned char*)(n) + (u)->node_agg_offset )
+#define ULL_INDEX_AGG( u, p ) ( (unsigned char*)(p) + (u)->index_agg_offset )
+// key of lists created with ull_init_abbrev(): the element pointer (first, so the
+// key reads like the plain element pointer) and its abbreviation
+typedef struct _ullabbrevkey {
+  void * elem;
+  uint64_t abbrev;
+}
+ullabbrevkey;
+
+// the key to search for: the element pointer itself, the element pointer with its
+// abbreviation (a temporary that lives until the end of the enclosing block) or,
+// for lists storing the keys by value, the key the element points to
+#define ULL_ELEM_KEY( u, elem ) \
+  ( (u)->byvalue ? (const void*)(elem) : ( (u)->abbrev ? \
+    (const void*)&((ullabbrevkey){ (elem), ((u)->abbrev)( elem ) }) : (const void*)&(elem) ) )
+
+// address of the i-th first key of an index node
+#define ULL_INDEX_FIRST( u, p, i ) \
+  ( (unsigned char*)(p) + (u)->index_firsts_offset + (size_t)(i) * (u)->keysize )
+
+// the node or index node a link points to: the links of mapped lists (see ull_open_mmap())
+// are offsets into the file, which are resolved against the mapping
+#define ULL_LINK( u, l ) \
+  ( (u)->mapping && (l) ? (void*)( (unsigned char*)(u)->mapping + (uintptr_t)(l) ) : (void*)(l) )
+#define ULL_NEXT( u, n ) ( (ullnode*)ULL_LINK( u, (n)->next ) )
+#define ULL_PREV( u, n ) ( (ullnode*)ULL_LINK( u, (n)->prev ) )
+#define ULL_PARENT( u, n ) ( (ullindex*)ULL_LINK( u, (n)->parent ) )
+#define ULL_CHILD( u, p, i ) ULL_LINK( u, ((p)->children)[ i ] )
+
+int _ull_pool_init( ullpool * p, dynmem * slabs, size_t objsize );
+void * _ull_pool_alloc( ullpool * p );
+void _ull_pool_free( ullpool * p, void * obj );
+void _ull_pool_release( ullpool * p );
+
 int ull_init( ull * u, dynmem * m, ullcmpfunc f );
+int ull_init_abbrev( ull * u, dynmem * m, ullcmpfunc f, ullabbrevfunc abbrev );
+uint64_t ull_abbrev_str( void * s );
+int ull_init_keys( ull * u, dynmem * m, const ullkeyops * ops );
+int ull_init_map( ull * u, dynmem * m, const ullkeyops * ops, size_t valuesize );
+void * _ull_node_element( ull * u, ullnode * n, size_t i );
+void _ull_node_copy( ull * u, ullnode * n, size_t i, void * out );
+int ull_set_node_capacity( ull * u, size_t capacity );
+int ull_set_merge_threshold( ull * u, double fill );
+int ull_set_split_policy( ull * u, double fill, double ratio, int append );
+int ull_set_multiset( ull * u, int enable );
+int ull_set_packed( ull * u, int enable );
+int ull_set_aggregate( ull * u, const ullaggregate * agg );
+int ull_set_concurrent( ull * u, int enable );
+int ull_reader_init( ullreader * r, ull * u );
+void ull_reader_release( ullreader * r );
+const ullkeyops * ull_keyops_i32( void );
+const ullkeyops * ull_keyops_i64( void );
+const ullkeyops * ull_keyops_f64( void );
+const char * ull_keyops_kernel( void );
 void ull_debug( ull * u, ulldebugfunc f );
 int _ull_insert_new_node( ull * u, ullnode * prev, ullnode * next, ullnode * * new );
-int _ull_insert_node_element( ullnode * n, size_t insert_at_index, void * elem );
+void _ull_remove_node( ull * u, ullnode * n );
+size_t _ull_index_child_pos( ullindex * p, void * child );
+int _ull_index_insert_after( ull * u, ullnode * n, ullnode * new );
+void _ull_index_update_first( ull * u, ullnode * n );
+void _ull_index_add_count( ull * u, ullnode * n, ptrdiff_t delta );
+void _ull_index_remove( ull * u, ullnode * n );
+size_t _ull_node_lower_bound( ull * u, ullnode * n, const void * key );
+size_t _ull_node_upper_bound( ull * u, ullnode * n, const void * key );
+size_t _ull_max_fill( ull * u );
+size_t _ull_min_fill( ull * u );
+int _ull_insert_node_element( ull * u, ullnode * n, size_t insert_at_index, const void * key );
 int ull_insert( ull * u, void * elem );
+void ull_finger_init( ullfinger * f );
+int ull_insert_hint( ull * u, void * elem, ullfinger * f );
+int _ull_get_node_including_key( ull * u, const void * key, ullnode * * n );
+int _ull_get_node_including_key_from( ull * u, ullnode * from, const void * key, ullnode * * n );
 int _ull_get_node_including_elem( ull * u, void * elem, ullnode * * n );
 int ull_get_nearest( ull * u, void * elem, int exactly, void * * nearest );
+int ull_get_nearest_hint( ull * u, void * elem, int exactly, void * * nearest, ullfinger * f );
+int ull_get_nearest_key( ull * u, void * elem, int exactly, void * nearest );
+int ull_upsert( ull * u, const void * key, const void * value );
+int ull_find( ull * u, const void * key, void * * value );
+size_t ull_count( ull * u, void * elem );
+int ull_range_aggregate( ull * u, void * lo, void * hi, void * out );
+int ull_get_nearest_value( ull * u, const void * key, int exactly, void * * nearest, void * * value );
+int ull_read_nearest( ullreader * r, void * elem, int exactly, void * nearest );
+int ull_read_lower_bound( ullreader * r, void * elem, void * lower );
+int ull_read_last( ullreader * r, void * last );
 size_t ull_size( ull * u );
 int ull_get( ull * u, size_t pos, void * * value );
+int ull_get_key( ull * u, size_t pos, void * key );
+size_t ull_rank( ull * u, void * elem );
+int ull_cursor_init( ullcursor * c, ull * u );
+int ull_seek_first( ullcursor * c );
+int ull_seek_end( ullcursor * c );
+int ull_seek( ullcursor * c, void * elem );
+int ull_next( ullcursor * c, void * * elem );
+int ull_prev( ullcursor * c, void * * elem );
+int ull_next_key( ullcursor * c, void * key );
+int ull_prev_key( ullcursor * c, void * key );
+int ull_next_span( ullcursor * c, void * * span, size_t * len );
 int	ull_remove_all( ull * u );
+void _ull_remove_node_elements( ull * u, ullnode * n, size_t from, size_t to );
+void _ull_rebalance_node( ull * u, ullnode * n );
+int ull_remove( ull * u, void * elem );
+size_t ull_remove_range( ull * u, void * lo, void * hi );
+int _ull_index_build( ull * u, double fill_factor );
+int ull_build_from_sorted( ull * u, const void * elems, size_t n, double fill_factor );
+int _ull_sort_keys( ull * u, unsigned char * keys, size_t n, unsigned char * tmp );
+int ull_insert_batch( ull * u, const void * elems, size_t n );
+int ull_split_at( ull * u, void * elem, ull * right );
+int ull_concat( ull * left, ull * right );
+int ull_merge( ull * a, ull * b, ull * out );
+int ull_save( ull * u, const char * path );
+int ull_open_mmap( ull * u, dynmem * m, const char * path, const ullkeyops * ops, int verify );
+int ull_set_checkpointing( ull * u, int enable );
+int ull_checkpoint( ull * u, int fd );
+int ull_recover( ull * u, dynmem * m, const ullkeyops * ops, const char * base_path, const char * log_path );
+int ull_stats_get( ull * u, ullstats * out );
+void ull_stats_reset( ull * u );
+
+// generates the key operations for keys of given type: a function
+// name_keyops() returning the ullkeyops for the type
+// -> CMP_EXPR compares the two keys a and b (of type KeyType) like a ullcmpfunc,
+//    it may use the list u
+// -> the comparison is inlined into the binary searches over the node keys,
+//    so there is one indirect call per node instead of one per comparison
+#define ULL_DEFINE_KEYOPS( name, KeyType, CMP_EXPR ) \
+  typedef KeyType name##_keytype; \
+  static inline int name##_cmp( ull * u, const void * pa, const void * pb ) \
+  { \
+    name##_keytype a = *((const name##_keytype*)pa); \
+    name##_keytype b = *((const name##_keytype*)pb); \
+    (void)u; \
+    return (CMP_EXPR); \
+  } \
+  static inline size_t name##_search( ull * u, const void * keys, size_t n, const void * key, int upper ) \
+  { \
+    const name##_keytype * k = (const name##_keytype*)keys; \
+    name##_keytype b = *((const name##_keytype*)key); \
+    size_t lo = 0, hi = n; \
+    (void)u; \
+    while( lo < hi ) { \
+      size_t mid = lo + ( hi - lo ) / 2; \
+      name##_keytype a = k[ mid ]; \
+      int c = (CMP_EXPR); \
+      if( c < 0 || ( upper && c == 0 ) ) { \
+        lo = mid + 1; \
+      } \
+      else { \
+        hi = mid; \
+      } \
+    } \
+    return lo; \
+  } \
+  static inline void name##_sort( ull * u, void * keys, size_t n, void * tmp ) \
+  { \
+    name##_keytype * src = (name##_keytype*)keys; \
+    name##_keytype * dst = (name##_keytype*)tmp; \
+    size_t lo = 0, width = 0; \
+    (void)u; \
+    /* insertion sort runs of 16 keys, then merge runs bottom-up */ \
+    for( lo = 0; lo < n; lo += 16 ) { \
+      size_t hi = ( lo + 16 < n ? lo + 16 : n ), i = 0; \
+      for( i = lo + 1; i < hi; i++ ) { \
+        name##_keytype a = src[ i ]; \
+        size_t j = i; \
+        while( j > lo ) { \
+          name##_keytype b = src[ j - 1 ]; \
+          if( (CMP_EXPR) >= 0 ) { \
+            break; \
+          } \
+          src[ j ] = b; \
+          j--; \
+        } \
+        src[ j ] = a; \
+      } \
+    } \
+    for( width = 16; width < n; width *= 2 ) { \
+      name##_keytype * t = 0; \
+      for( lo = 0; lo < n; lo += 2 * width ) { \
+        size_t mid = ( lo + width < n ? lo + width : n ); \
+        size_t hi = ( lo + 2 * width < n ? lo + 2 * width : n ); \
+        size_t l = lo, r = mid, o = lo; \
+        while( l < mid && r < hi ) { \
+          name##_keytype a = src[ r ]; \
+          name##_keytype b = src[ l ]; \
+          if( (CMP_EXPR) < 0 ) { \
+            dst[ o++ ] = a; \
+            r++; \
+          } \
+          else { \
+            dst[ o++ ] = b; \
+            l++; \
+          } \
+        } \
+        while( l < mid ) { \
+          dst[ o++ ] = src[ l++ ]; \
+        } \
+        while( r < hi ) { \
+          dst[ o++ ] = src[ r++ ]; \
+        } \
+      } \
+      t = src; \
+      src = dst; \
+      dst = t; \
+    } \
+    if( src != (name##_keytype*)keys ) { \
+      memcpy( keys, src, n * sizeof(name##_keytype) ); \
+    } \
+  } \
+  static inline const ullkeyops * name##_keyops( void ) \
+  { \
+    static const ullkeyops ops = { sizeof(name##_keytype), name##_cmp, name##_search, name##_sort }; \
+    return &ops; \
+  }
+
+// generates a typed list "name" whose nodes store keys of type KeyType by value
+// (see ULL_DEFINE_KEYOPS() for CMP_EXPR), e.g.
+//
+//   ULL_DEFINE( ullint, int, ( a < b ? -1 : ( a > b ? 1 : 0 ) ) )
+//
+//   ullint l;
+//   dynmem d;
+//   int k = 0;
+//   dynmem_init( &d, sizeof(void*) );
+//   ullint_init( &l, &d );
+//   ullint_insert( &l, 42 );
+//   ullint_get_nearest( &l, 41, 0, &k );
+//
+// -> the void* API is the instantiation for pointer keys compared by the cmpfunc
+#define ULL_DEFINE( name, KeyType, CMP_EXPR ) \
+  ULL_DEFINE_KEYOPS( name, KeyType, CMP_EXPR ) \
+  ULL_DEFINE_LIST( name, KeyType, name##_keyops() )
+
+// generates a map type name from keys of type KeyType to values of type ValueType
+// (see ull_init_map()) with the functions name_init, name_upsert, name_find,
+// name_get_nearest, name_size, name_remove and name_remove_all
+#define ULL_DEFINE_MAP( name, KeyType, ValueType, CMP_EXPR ) \
+  ULL_DEFINE_KEYOPS( name, KeyType, CMP_EXPR ) \
+  typedef KeyType name##_key; \
+  typedef ValueType name##_value; \
+  typedef struct { ull u; } name; \
+  static inline int name##_init( name * l, dynmem * m ) \
+  { \
+    return ull_init_map( &(l->u), m, name##_keyops(), sizeof(name##_value) ); \
+  } \
+  static inline int name##_upsert( name * l, name##_key key, name##_value value ) \
+  { \
+    return ull_upsert( &(l->u), &key, &value ); \
+  } \
+  static inline int name##_find( name * l, name##_key key, name##_value * value ) \
+  { \
+    void * p = 0; \
+    if( ull_find( &(l->u), &key, &p ) ) { \
+      memcpy( value, p, sizeof(name##_value) ); \
+      return 1; \
+    } \
+    return 0; \
+  } \
+  static inline int name##_get_nearest( name * l, name##_key key, int exactly, name##_key * nearest, name##_value * value ) \
+  { \
+    void * pk = 0, * pv = 0; \
+    if( ull_get_nearest_value( &(l->u), &key, exactly, &pk, &pv ) ) { \
+      *nearest = *((name##_key*)pk); \
+      memcpy( value, pv, sizeof(name##_value) ); \
+      return 1; \
+    } \
+    return 0; \
+  } \
+  static inline size_t name##_size( name * l ) \
+  { \
+    return ull_size( &(l->u) ); \
+  } \
+  static inline int name##_remove( name * l, name##_key key ) \
+  { \
+    return ull_remove( &(l->u), (void*)&key ); \
+  } \
+  static inline int name##_remove_all( name * l ) \
+  { \
+    return ull_remove_all( &(l->u) ); \
+  }
+
+// typed lists of 32/64 bit integers and doubles that search the nodes with
+// SIMD kernels (AVX2 or SSE4.2, selected at runtime, or a scalar fallback)
+#define ULL_DEFINE_I32( name ) ULL_DEFINE_LIST( name, int32_t, ull_keyops_i32() )
+#define ULL_DEFINE_I64( name ) ULL_DEFINE_LIST( name, int64_t, ull_keyops_i64() )
+#define ULL_DEFINE_F64( name ) ULL_DEFINE_LIST( name, double, ull_keyops_f64() )
+
+// generates the typed list functions for keys of given type using given key operations
+#define ULL_DEFINE_LIST( name, KeyType, OPS ) \
+  typedef KeyType name##_key; \
+  typedef struct { ull u; } name; \
+  static inline int name##_init( name * l, dynmem * m ) \
+  { \
+    return ull_init_keys( &(l->u), m, (OPS) ); \
+  } \
+  static inline int name##_insert( name * l, name##_key key ) \
+  { \
+    return ull_insert( &(l->u), (void*)&key ); \
+  } \
+  static inline int name##_insert_hint( name * l, name##_key key, ullfinger * f ) \
+  { \
+    return ull_insert_hint( &(l->u), (void*)&key, f ); \
+  } \
+  static inline int name##_get_nearest( name * l, name##_key key, int exactly, name##_key * nearest ) \
+  { \
+    return ull_get_nearest_key( &(l->u), (void*)&key, exactly, (void*)nearest ); \
+  } \
+  static inline int name##_get_nearest_hint( name * l, name##_key key, int exactly, name##_key * nearest, ullfinger * f ) \
+  { \
+    void * p = 0; \
+    if( ull_get_nearest_hint( &(l->u), (void*)&key, exactly, &p, f ) ) { \
+      *nearest = *((name##_key*)p); \
+      return 1; \
+    } \
+    return 0; \
+  } \
+  static inline int name##_read_nearest( ullreader * r, name##_key key, int exactly, name##_key * nearest ) \
+  { \
+    return ull_read_nearest( r, (void*)&key, exactly, (void*)nearest ); \
+  } \
+  static inline size_t name##_size( name * l ) \
+  { \
+    return ull_size( &(l->u) ); \
+  } \
+  static inline int name##_get( name * l, size_t pos, name##_key * value ) \
+  { \
+    return ull_get_key( &(l->u), pos, (void*)value ); \
+  } \
+  static inline size_t name##_rank( name * l, name##_key key ) \
+  { \
+    return ull_rank( &(l->u), (void*)&key ); \
+  } \
+  static inline size_t name##_count( name * l, name##_key key ) \
+  { \
+    return ull_count( &(l->u), (void*)&key ); \
+  } \
+  static inline int name##_cursor_init( ullcursor * c, name * l ) \
+  { \
+    return ull_cursor_init( c, &(l->u) ); \
+  } \
+  static inline int name##_seek( ullcursor * c, name##_key key ) \
+  { \
+    return ull_seek( c, (void*)&key ); \
+  } \
+  static inline int name##_next( ullcursor * c, name##_key * key ) \
+  { \
+    return ull_next_key( c, (void*)key ); \
+  } \
+  static inline int name##_prev( ullcursor * c, name##_key * key ) \
+  { \
+    return ull_prev_key( c, (void*)key ); \
+  } \
+  static inline int name##_next_span( ullcursor * c, const name##_key * * keys, size_t * len ) \
+  { \
+    void * p = 0; \
+    if( ull_next_span( c, &p, len ) ) { \
+      *keys = (const name##_key*)p; \
+      return 1; \
+    } \
+    return 0; \
+  } \
+  static inline int name##_remove_all( name * l ) \
+  { \
+    return ull_remove_all( &(l->u) ); \
+  } \
+  static inline int name##_remove( name * l, name##_key key ) \
+  { \
+    return ull_remove( &(l->u), (void*)&key ); \
+  } \
+  static inline size_t name##_remove_range( name * l, name##_key lo, name##_key hi ) \
+  { \
+    return ull_remove_range( &(l->u), (void*)&lo, (void*)&hi ); \
+  } \
+  static inline int name##_range_aggregate( name * l, name##_key lo, name##_key hi, void * out ) \
+  { \
+    return ull_range_aggregate( &(l->u), (void*)&lo, (void*)&hi, out ); \
+  } \
+  static inline int name##_insert_batch( name * l, const name##_key * keys, size_t n ) \
+  { \
+    return ull_insert_batch( &(l->u), keys, n ); \
+  } \
+  static inline int name##_build_from_sorted( name * l, const name##_key * keys, size_t n, double fill_factor ) \
+  { \
+    return ull_build_from_sorted( &(l->u), keys, n, fill_factor ); \
+  } \
+  static inline int name##_split_at( name * l, name##_key key, name * right ) \
+  { \
+    return ull_split_at( &(l->u), (void*)&key, &(right->u) ); \
+  } \
+  static inline int name##_concat( name * left, name * right ) \
+  { \
+    return ull_concat( &(left->u), &(right->u) ); \
+  } \
+  static inline int name##_merge( name * a, name * b, name * out ) \
+  { \
+    return ull_merge( &(a->u), &(b->u), &(out->u) ); \
+  }
 
 #endif
 
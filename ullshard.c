@@ -0,0 +1,358 @@
+// sched_yield() and posix_memalign()
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include "ullshard.h"
+
+// the element as passed to the ull_* functions for a key as stored in the nodes
+static void * _ull_shards_elem( ull * u, unsigned char * key )
+{
+  return ( u->byvalue ? (void*)key : *((void**)key) );
+}
+
+// seqlock of the splitters (see ullshards)
+static unsigned int _ull_shards_read_begin( ullshards * s )
+{
+  unsigned int v = 0;
+  while( ( v = __atomic_load_n( &(s->version), __ATOMIC_ACQUIRE ) ) & 1 ) {
+    sched_yield(); // a rebalance is storing a splitter
+  }
+  return v;
+}
+
+static int _ull_shards_read_validate( ullshards * s, unsigned int v )
+{
+  __atomic_thread_fence( __ATOMIC_ACQUIRE );
+  return ( __atomic_load_n( &(s->version), __ATOMIC_RELAXED ) == v );
+}
+
+// the shard whose range includes given key
+static size_t _ull_shards_route( ullshards * s, const void * key )
+{
+  ull * u = &(s->shards[ 0 ]->u);
+  return (u->keyops->search)( u, s->splitters, s->num_shards - 1, key, 1 );
+}
+
+// inits the shards as lists in concurrent mode, either compared by f or by ops
+static int _ull_shards_init( ullshards * s, ullcmpfunc f, const ullkeyops * ops, size_t num_shards, const void * splitters )
+{
+  size_t i = 0;
+  if( ! s || num_shards < 1 || num_shards > ULL_SHARDS_MAX || ( num_shards > 1 && ! splitters ) ) {
+    return 0;
+  }
+  memset( s, 0, sizeof(ullshards) );
+  for( i = 0; i < num_shards; i++ ) {
+    void * mem = 0;
+    ullshard * sh = 0;
+    if( posix_memalign( &mem, ULL_CACHE_LINE, sizeof(ullshard) ) != 0 ) {
+      ull_shards_free( s );
+      return 0;
+    }
+    sh = mem;
+    s->shards[ i ] = sh;
+    s->num_shards ++;
+    sh->inserts = 0;
+    pthread_mutex_init( &(sh->lock), 0 );
+    dynmem_init( &(sh->memory), sizeof(void*) );
+    if( ! ( f ? ull_init( &(sh->u), &(sh->memory), f ) : ull_init_keys( &(sh->u), &(sh->memory), ops ) ) ||
+        ! ull_set_concurrent( &(sh->u), 1 ) ) {
+      ull_shards_free( s );
+      return 0;
+    }
+  }
+  s->keysize = s->shards[ 0 ]->u.keysize;
+  s->splitters = malloc( num_shards * s->keysize );
+  if( ! s->splitters ) {
+    ull_shards_free( s );
+    return 0;
+  }
+  if( num_shards > 1 ) {
+    memcpy( s->splitters, splitters, ( num_shards - 1 ) * s->keysize );
+  }
+  pthread_mutex_init( &(s->balance_lock), 0 );
+  return 1;
+}
+
+// inits a container of num_shards lists of element pointers ordered by f
+// -> splitters are the num_shards - 1 sorted element pointers that separate the shards
+int ull_shards_init( ullshards * s, ullcmpfunc f, size_t num_shards, const void * splitters )
+{
+  return ( f ? _ull_shards_init( s, f, 0, num_shards, splitters ) : 0 );
+}
+
+// inits a container of num_shards lists storing keys by value (see ull_init_keys())
+// -> splitters are the num_shards - 1 sorted keys that separate the shards
+int ull_shards_init_keys( ullshards * s, const ullkeyops * ops, size_t num_shards, const void * splitters )
+{
+  return ( ops ? _ull_shards_init( s, 0, ops, num_shards, splitters ) : 0 );
+}
+
+// releases all shards (no other thread may use the container anymore)
+void ull_shards_free( ullshards * s )
+{
+  size_t i = 0;
+  if( s ) {
+    for( i = 0; i < s->num_shards; i++ ) {
+      ull_set_concurrent( &(s->shards[ i ]->u), 0 );
+      ull_remove_all( &(s->shards[ i ]->u) );
+      pthread_mutex_destroy( &(s->shards[ i ]->lock) );
+      free( s->shards[ i ] );
+      s->shards[ i ] = 0;
+    }
+    if( s->splitters ) {
+      pthread_mutex_destroy( &(s->balance_lock) );
+      free( s->splitters );
+      s->splitters = 0;
+    }
+    s->num_shards = 0;
+  }
+}
+
+// inserts the element into its shard (any number of threads at once)
+// -> the shard checks every ULL_SHARDS_CHECK_EVERY inserts whether it became hot
+//    and moves elements to a neighbour then
+int ull_shards_insert( ullshards * s, void * elem )
+{
+  const void * key = ULL_ELEM_KEY( &(s->shards[ 0 ]->u), elem );
+  while( 1 ) {
+    unsigned int v = _ull_shards_read_begin( s );
+    size_t i = _ull_shards_route( s, key );
+    ullshard * sh = s->shards[ i ];
+    pthread_mutex_lock( &(sh->lock) );
+    if( _ull_shards_read_validate( s, v ) ) {
+      // (the splitters can not change while the shard is locked)
+      int res = ull_insert( &(sh->u), elem );
+      int check = ( ++ (sh->inserts) % ULL_SHARDS_CHECK_EVERY == 0 );
+      pthread_mutex_unlock( &(sh->lock) );
+      if( res && check ) {
+        _ull_shards_balance( s, i );
+      }
+      return res;
+    }
+    pthread_mutex_unlock( &(sh->lock) );
+  }
+}
+
+// removes one element that compares equal to elem (see ull_remove())
+int ull_shards_remove( ullshards * s, void * elem )
+{
+  const void * key = ULL_ELEM_KEY( &(s->shards[ 0 ]->u), elem );
+  while( 1 ) {
+    unsigned int v = _ull_shards_read_begin( s );
+    ullshard * sh = s->shards[ _ull_shards_route( s, key ) ];
+    pthread_mutex_lock( &(sh->lock) );
+    if( _ull_shards_read_validate( s, v ) ) {
+      int res = ull_remove( &(sh->u), elem );
+      pthread_mutex_unlock( &(sh->lock) );
+      return res;
+    }
+    pthread_mutex_unlock( &(sh->lock) );
+  }
+}
+
+size_t ull_shards_size( ullshards * s )
+{
+  size_t i = 0, total = 0;
+  for( i = 0; i < s->num_shards; i++ ) {
+    total += ull_size( &(s->shards[ i ]->u) );
+  }
+  return total;
+}
+
+// registers the calling thread as reader of all shards
+int ull_shards_reader_init( ullshardsreader * r, ullshards * s )
+{
+  size_t i = 0;
+  if( r && s ) {
+    r->s = s;
+    for( i = 0; i < s->num_shards; i++ ) {
+      if( ! ull_reader_init( &((r->readers)[ i ]), &(s->shards[ i ]->u) ) ) {
+        while( i > 0 ) {
+          i--;
+          ull_reader_release( &((r->readers)[ i ]) );
+        }
+        return 0;
+      }
+    }
+    return 1;
+  }
+  return 0;
+}
+
+void ull_shards_reader_release( ullshardsreader * r )
+{
+  size_t i = 0;
+  if( r && r->s ) {
+    for( i = 0; i < r->s->num_shards; i++ ) {
+      ull_reader_release( &((r->readers)[ i ]) );
+    }
+    r->s = 0;
+  }
+}
+
+// copies the nearest element into *nearest as stored in the nodes (see ull_read_nearest()):
+// the first element of all shards that is not before elem or, if all are before it,
+// the last element
+// -> lock-free, shards after elem's shard are only visited if elem's shard has
+//    no element that is not before elem
+int ull_shards_get_nearest( ullshardsreader * r, void * elem, int exactly, void * nearest )
+{
+  ullshards * s = r->s;
+  const void * key = ULL_ELEM_KEY( &(s->shards[ 0 ]->u), elem );
+  while( 1 ) {
+    unsigned int v = _ull_shards_read_begin( s );
+    size_t i = _ull_shards_route( s, key ), j = 0;
+    int res = 0;
+    if( exactly ) {
+      res = ull_read_nearest( &((r->readers)[ i ]), elem, 1, nearest );
+    }
+    else {
+      for( j = i; j < s->num_shards && ! res; j++ ) {
+        res = ull_read_lower_bound( &((r->readers)[ j ]), elem, nearest );
+      }
+      // (shards after i hold no elements then)
+      for( j = i + 1; j > 0 && ! res; j-- ) {
+        res = ull_read_last( &((r->readers)[ j - 1 ]), nearest );
+      }
+    }
+    if( _ull_shards_read_validate( s, v ) ) {
+      return res;
+    }
+  }
+}
+
+// sets splitter i to given key: the only moment readers wait for a rebalance
+// -> the elements it moves are in both shards meanwhile, so readers that route by the
+//    old or the new splitter find them
+static void _ull_shards_set_splitter( ullshards * s, size_t i, const void * key )
+{
+  __atomic_store_n( &(s->version), s->version + 1, __ATOMIC_RELAXED );
+  __atomic_thread_fence( __ATOMIC_RELEASE );
+  memcpy( s->splitters + i * s->keysize, key, s->keysize );
+  __atomic_store_n( &(s->version), s->version + 1, __ATOMIC_RELEASE );
+}
+
+// copies the elements of shard i from given one on (the stored keys) into keys
+static size_t _ull_shards_copy_from( ull * u, void * elem, unsigned char * keys, size_t max )
+{
+  ullcursor c;
+  void * span = 0;
+  size_t len = 0, num = 0;
+  ull_cursor_init( &c, u );
+  if( elem ) {
+    ull_seek( &c, elem );
+  }
+  while( num < max && ull_next_span( &c, &span, &len ) ) {
+    len = ( num + len > max ? max - num : len );
+    memcpy( keys + num * u->keysize, span, len * u->keysize );
+    num += len;
+  }
+  return num;
+}
+
+// moves the last k elements of shard i (and all elements equal to the first of them)
+// to shard i + 1
+static int _ull_shards_move_up( ullshards * s, size_t i, size_t k )
+{
+  ull * from = &(s->shards[ i ]->u);
+  ull * to = &(s->shards[ i + 1 ]->u);
+  size_t ks = s->keysize, m = 0;
+  unsigned char * keys = 0;
+  void * e = 0;
+  int res = 0;
+  if( ! ull_get( from, ull_size( from ) - k, &e ) ) {
+    return 0;
+  }
+  m = ull_size( from ) - ull_rank( from, e );
+  keys = malloc( m * ks );
+  if( ! keys ) {
+    return 0;
+  }
+  m = _ull_shards_copy_from( from, e, keys, m );
+  // publish the elements in shard i + 1 before they leave shard i
+  res = ull_insert_batch( to, keys, m );
+  if( res ) {
+    _ull_shards_set_splitter( s, i, keys );
+    ull_remove_range( from, _ull_shards_elem( from, keys ), _ull_shards_elem( from, keys + ( m - 1 ) * ks ) );
+  }
+  free( keys );
+  return res;
+}
+
+// moves the first k elements of shard i (without the ones equal to the k-th element)
+// to shard i - 1
+static int _ull_shards_move_down( ullshards * s, size_t i, size_t k )
+{
+  ull * from = &(s->shards[ i ]->u);
+  ull * to = &(s->shards[ i - 1 ]->u);
+  size_t ks = s->keysize, m = 0;
+  unsigned char * keys = 0;
+  void * e = 0;
+  int res = 0;
+  if( ! ull_get( from, k, &e ) ) {
+    return 0;
+  }
+  m = ull_rank( from, e );
+  if( m == 0 ) {
+    return 1; // all first elements are equal
+  }
+  keys = malloc( ( m + 1 ) * ks );
+  if( ! keys ) {
+    return 0;
+  }
+  // the first element that stays is the new splitter
+  memcpy( keys + m * ks, ULL_ELEM_KEY( from, e ), ks );
+  m = _ull_shards_copy_from( from, 0, keys, m );
+  // publish the elements in shard i - 1 before they leave shard i
+  res = ull_insert_batch( to, keys, m );
+  if( res ) {
+    _ull_shards_set_splitter( s, i - 1, keys + m * ks );
+    ull_remove_range( from, _ull_shards_elem( from, keys ), _ull_shards_elem( from, keys + ( m - 1 ) * ks ) );
+  }
+  free( keys );
+  return res;
+}
+
+// moves elements from shard i to its smaller neighbour if shard i is hot, so that
+// both hold about the same number of elements (and moves the splitter between them)
+// -> returns 0 if nothing was moved
+int _ull_shards_balance( ullshards * s, size_t i )
+{
+  size_t j = 0, lo = 0, hi = 0, ni = 0, nj = 0;
+  int res = 0;
+  if( s->num_shards < 2 ) {
+    return 0;
+  }
+  ni = ull_size( &(s->shards[ i ]->u) );
+  if( ni < ULL_SHARDS_MIN_HOT ||
+      (double)ni <= ULL_SHARDS_HOT * (double)ull_shards_size( s ) / (double)(s->num_shards) ) {
+    return 0;
+  }
+  if( pthread_mutex_trylock( &(s->balance_lock) ) != 0 ) {
+    return 0; // another shard is rebalanced
+  }
+  if( i == 0 || ( i + 1 < s->num_shards &&
+      ull_size( &(s->shards[ i + 1 ]->u) ) < ull_size( &(s->shards[ i - 1 ]->u) ) ) ) {
+    j = i + 1;
+  }
+  else {
+    j = i - 1;
+  }
+  lo = ( i < j ? i : j );
+  hi = ( i < j ? j : i );
+  pthread_mutex_lock( &(s->shards[ lo ]->lock) );
+  pthread_mutex_lock( &(s->shards[ hi ]->lock) );
+  ni = ull_size( &(s->shards[ i ]->u) );
+  nj = ull_size( &(s->shards[ j ]->u) );
+  if( ni > nj + 1 ) {
+    res = ( j > i ? _ull_shards_move_up( s, i, ( ni - nj ) / 2 ) : _ull_shards_move_down( s, i, ( ni - nj ) / 2 ) );
+  }
+  pthread_mutex_unlock( &(s->shards[ hi ]->lock) );
+  pthread_mutex_unlock( &(s->shards[ lo ]->lock) );
+  pthread_mutex_unlock( &(s->balance_lock) );
+  return res;
+}
@@ -0,0 +1,93 @@
+// This file is part of Ull.
+// vim: set expandtab tabstop=2 shiftwidth=2 softtabstop=2:
+/*
+    Range-sharded unrolled linked list.
+
+		A container of several ull lists (shards) that each hold a range of the
+		key space, so that several threads can insert at once.
+
+		@category   C99 library
+		@author     Tom Kirchner <tom@tkirchner.com>
+		@copyright  2017 Tom Kirchner
+		@version    0.1 (2017/11/23)
+		@link       https://www.github.com/kitomer/ull
+
+		@license
+
+			Ull is free software: you can redistribute it and/or modify it under
+			the terms of the GNU General Public License as published by the
+			Free Software Foundation, either version 3 of the License, or
+			(at your option) any later version.
+
+			Ull is distributed in the hope that it will be useful, but
+			WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+			or FITNESS FOR A PARTICULAR PURPOSE.
+			See the GNU General Public License for more details.
+
+			You should have received a copy of the GNU General Public License
+			along with Dynmem. If not, see http://www.gnu.org/licenses/.
+
+*/
+#ifndef ULLSHARD_H
+#define ULLSHARD_H
+
+#include <pthread.h>
+
+#include "ull.h"
+
+// max number of shards of a container
+#define ULL_SHARDS_MAX 64
+// a shard checks whether it became hot every that many inserts
+#define ULL_SHARDS_CHECK_EVERY 1024
+// a shard is hot if it holds more than that many times the average number of elements
+// (and at least ULL_SHARDS_MIN_HOT elements)
+#define ULL_SHARDS_HOT 2.0
+#define ULL_SHARDS_MIN_HOT 4096
+
+// one shard: a list in concurrent mode whose writers are serialized by the lock
+// (one per cache line group, so writers of different shards do not share lines)
+typedef struct _ullshard {
+  ull u;
+  dynmem memory;
+  pthread_mutex_t lock;
+  // number of inserts (for the hot check)
+  size_t inserts;
+}
+ullshard;
+
+// shard i holds the elements that are not before splitter i - 1 and before splitter i
+// -> the splitters are a seqlock: they only change while two neighbouring shards
+//    are rebalanced, lookups and inserts that saw them change retry
+// -> a rebalance copies the moved elements into the receiving shard first, then stores
+//    the splitter (readers only wait for that) and then removes them from the other shard
+typedef struct _ullshards {
+  ullshard * shards [ ULL_SHARDS_MAX ];
+  size_t num_shards;
+  // num_shards - 1 keys (keysize bytes each)
+  unsigned char * splitters;
+  size_t keysize;
+  unsigned int version;
+  // one rebalance at a time
+  pthread_mutex_t balance_lock;
+}
+ullshards;
+
+// a reader thread of a sharded container (one ullreader per shard)
+typedef struct _ullshardsreader {
+  ullshards * s;
+  ullreader readers [ ULL_SHARDS_MAX ];
+}
+ullshardsreader;
+
+int ull_shards_init( ullshards * s, ullcmpfunc f, size_t num_shards, const void * splitters );
+int ull_shards_init_keys( ullshards * s, const ullkeyops * ops, size_t num_shards, const void * splitters );
+void ull_shards_free( ullshards * s );
+int ull_shards_insert( ullshards * s, void * elem );
+int ull_shards_remove( ullshards * s, void * elem );
+size_t ull_shards_size( ullshards * s );
+int ull_shards_reader_init( ullshardsreader * r, ullshards * s );
+void ull_shards_reader_release( ullshardsreader * r );
+int ull_shards_get_nearest( ullshardsreader * r, void * elem, int exactly, void * nearest );
+int _ull_shards_balance( ullshards * s, size_t i );
+
+#endif